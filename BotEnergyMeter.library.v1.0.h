@@ -0,0 +1,119 @@
+/*
+ * Energy Meter, time spent in each phase of the bot, turned into an estimated mAh per hour.
+ * The meter is always in exactly one phase, switching charges the elapsed time to the old one:
+ *   EnergyPhase previous = energyEnterPhase(ENERGY_DHT22);
+ *   ...read the sensor...
+ *   energyEnterPhase(previous);
+ * Totals live in RTC memory so DeepSleep cycles add up. When they get large all phases are
+ * halved, the estimate follows recent behaviour instead of the whole uptime.
+ *
+ * Currents are per phase on the whole board (regulator and USB chip included). ACTIVE, DEEPSLEEP
+ * and the radio phases come from the measurements in README.md, the rest are estimates.
+ */
+
+#define ENERGY_ACTIVE_UA     80000 //CPU and radio awake, anything not in another phase
+#define ENERGY_WIFI_UA       80000 //WiFi association, WifiManager portal
+#define ENERGY_MQTT_UA       80000 //Broker connect and subscribe
+#define ENERGY_PUBLISH_UA    80000
+#define ENERGY_DHT22_UA      81500 //Awake plus the DHT22 conversion
+#define ENERGY_IR_UA         81000 //Awake plus the IR receiver
+#define ENERGY_LED_UA        90000 //Awake plus one LED lit
+#define ENERGY_IDLE_UA       20000 //delay() in Light Sleep, modem waking for DTIM beacons
+#define ENERGY_DEEPSLEEP_UA  8000
+#define ENERGY_MAGIC         0x48454D31UL // "HEM1"
+#define ENERGY_HALVE_AFTER_MS 0x80000000UL //~24 days in one phase
+#define ENERGY_DATAMAP_BYTES  240 //Worst case of writeEnergyDataMap() in JSON
+
+enum EnergyPhase {
+  ENERGY_ACTIVE,
+  ENERGY_WIFI,
+  ENERGY_MQTT,
+  ENERGY_PUBLISH,
+  ENERGY_DHT22,
+  ENERGY_IR,
+  ENERGY_LED,
+  ENERGY_IDLE,
+  ENERGY_DEEPSLEEP,
+  ENERGY_PHASE_COUNT
+};
+static const uint32_t energyPhaseMicroAmps[ENERGY_PHASE_COUNT] = {
+  ENERGY_ACTIVE_UA, ENERGY_WIFI_UA, ENERGY_MQTT_UA, ENERGY_PUBLISH_UA, ENERGY_DHT22_UA,
+  ENERGY_IR_UA, ENERGY_LED_UA, ENERGY_IDLE_UA, ENERGY_DEEPSLEEP_UA
+};
+//Reported as seconds, in EnergyPhase order.
+static const HiveField energyPhaseFields[ENERGY_PHASE_COUNT] = {
+  HF_EnergyActiveSecs, HF_EnergyWifiSecs, HF_EnergyMqttSecs, HF_EnergyPublishSecs, HF_EnergyDht22Secs,
+  HF_EnergyIrSecs, HF_EnergyLedSecs, HF_EnergyIdleSecs, HF_EnergyDeepSleepSecs
+};
+
+struct EnergyLedger {
+  uint32_t crc;         //Over everything after this field
+  uint32_t magic;
+  uint32_t phaseMs[ENERGY_PHASE_COUNT];
+};
+static_assert(sizeof(EnergyLedger) % 4 == 0, "RTC memory is read and written in 4 byte blocks");
+
+EnergyLedger energyLedger;
+EnergyPhase _energyPhase = ENERGY_ACTIVE;
+unsigned long _energyPhaseStartMs = 0;
+
+uint32_t _energyLedgerCrc(){
+  return hiveCrc32((const uint8_t*)&energyLedger + sizeof(energyLedger.crc), sizeof(energyLedger) - sizeof(energyLedger.crc));
+}
+
+void _energyCharge(EnergyPhase phase, uint32_t ms){
+  energyLedger.phaseMs[phase] += ms;
+  if(energyLedger.phaseMs[phase] < ENERGY_HALVE_AFTER_MS) return;
+  for(int i=0;i<ENERGY_PHASE_COUNT;i++) energyLedger.phaseMs[i] /= 2;
+}
+
+//Boot so far is charged as ACTIVE. Starts over when RTC memory was lost.
+void setupEnergyMeter(){
+  ESP.rtcUserMemoryRead(RTC_ENERGY_LEDGER_ADDRESS, (uint32_t*)&energyLedger, sizeof(energyLedger));
+  if(energyLedger.magic != ENERGY_MAGIC || energyLedger.crc != _energyLedgerCrc()){
+    memset(&energyLedger, 0, sizeof(energyLedger));
+    energyLedger.magic = ENERGY_MAGIC;
+  }
+  _energyPhase = ENERGY_ACTIVE;
+  _energyPhaseStartMs = 0;
+}
+
+//Returns the phase left, to go back to it when this one ends.
+EnergyPhase energyEnterPhase(EnergyPhase phase){
+  unsigned long nowMs = millis();
+  _energyCharge(_energyPhase, nowMs - _energyPhaseStartMs);
+  _energyPhaseStartMs = nowMs;
+  EnergyPhase previous = _energyPhase;
+  _energyPhase = phase;
+  return previous;
+}
+
+//Charges the coming sleep up front and saves the ledger, call right before ESP.deepSleep().
+void energyDeepSleep(uint32_t sleepSecs){
+  energyEnterPhase(ENERGY_ACTIVE);
+  _energyCharge(ENERGY_DEEPSLEEP, sleepSecs * 1000UL);
+  energyLedger.crc = _energyLedgerCrc();
+  ESP.rtcUserMemoryWrite(RTC_ENERGY_LEDGER_ADDRESS, (uint32_t*)&energyLedger, sizeof(energyLedger));
+}
+
+float energyMilliAmpHoursPerHour(){
+  energyEnterPhase(_energyPhase); //Bring the current phase up to date.
+  uint64_t totalMs = 0;
+  uint64_t microAmpMs = 0;
+  for(int i=0;i<ENERGY_PHASE_COUNT;i++){
+    totalMs += energyLedger.phaseMs[i];
+    microAmpMs += (uint64_t)energyLedger.phaseMs[i] * energyPhaseMicroAmps[i];
+  }
+  if(totalMs == 0) return 0;
+  return (float)microAmpMs / totalMs / 1000.0f;
+}
+
+//Adds "energy":{"mAhPerHour":"12.34","activeSecs":..,..,"deepSleepSecs":..}
+void writeEnergyDataMap(HivePayloadWriter& dataMap){
+  dataMap.beginObject(HF_Energy);
+  dataMap.addFixed(HF_EnergyMahPerHour, energyMilliAmpHoursPerHour(), 2);
+  for(int i=0;i<ENERGY_PHASE_COUNT;i++){
+    dataMap.addLong(energyPhaseFields[i], energyLedger.phaseMs[i] / 1000);
+  }
+  dataMap.endObject();
+}
@@ -8,6 +8,16 @@
 #define HIVE_BOT_ACCESSKEY "1b4b882772c"
 #define HIVE_BOT_MQTTCLIENT_ID "miclim_esp8266_v3"
 
+/* RTC User Memory, 128 blocks of 4 bytes that survive DeepSleep.
+ * Block 0 is used by the DoubleResetDetector (DRD_ADDRESS).
+ */
+#define RTC_SAMPLE_STORE_ADDRESS 1  //22 blocks
+#define RTC_FAST_WAKE_ADDRESS    23 //47 blocks
+#define RTC_PUBLISH_SEQ_ADDRESS  70 //2 blocks
+#define RTC_ENERGY_LEDGER_ADDRESS 72 //11 blocks
+#define RTC_INSTRUCTION_CACHE_ADDRESS 83 //19 blocks
+#define RTC_AIRCON_SENT_ADDRESS  102 //5 blocks
+
 /* Config Settings from the WifiManager @ Wifi Setup.*/
 char config_mqtt_server[50] = "";
 char config_mqtt_server_port[5] = "1883";
@@ -21,8 +31,19 @@ const char* mqtt_microclima_id = HIVE_BOT_MQTTCLIENT_ID;
 int         mqtt_subscribe_qos = 1;
 
 const char* mqtt_controller_notify_topic =                "hivecentral/controller/microclimate";
+const char* mqtt_controller_notify_msgpack_topic =        "hivecentral/controller/microclimate/msgpack";
 const char* mqtt_botcli_recieve_topic =                   "hivecentral/botclients/microclimate";
 const char* mqtt_botcli_recieve_retained_will_topic =     "hivecentral/botclients/retainedwill/microclimate";
+const char* mqtt_botcli_broadcast_topic =                 "hivecentral/botclients/microclimate/broadcast";
+
+/* Bots subscribe to the shared recieve topics, plus the broadcast topic.
+ * HIVE_SHARED_TOPICS false scopes them to the bot, <topic>/<bot_id>, once HiveCentral publishes per bot.
+ * Only then does a bot stop waking for every other bot's messages.
+ */
+#ifndef HIVE_SHARED_TOPICS
+#define HIVE_SHARED_TOPICS true
+#endif
+#define HIVE_BROADCAST_TOPIC true //Fleet wide commands, no hiveBotId needed
 
 /* BOT Details --------------- */
 const char* bot_accessPointName  = HIVE_BOT_ID;
@@ -37,13 +58,13 @@ String hive_accesskey = HIVE_BOT_ACCESSKEY;
 bool loadConfigFromFile() {
   File configFile = SPIFFS.open(SPIFFS_CONFIG_JSONFILE, "r");
   if (!configFile) {
-    Serial.println("ERRO : [HIVEBOT] Unable to load config File. ");
+    HIVE_LOG_ERROR("HIVEBOT", "Unable to load config File.");
     return false;
   }
 
   size_t size = configFile.size();
   if (size > 1024) {
-    Serial.println("ERRO : [HIVEBOT] Config file size overflow.");
+    HIVE_LOG_ERROR("HIVEBOT", "Config file size overflow.");
     return false;
   }
 
@@ -56,7 +77,7 @@ bool loadConfigFromFile() {
   JsonObject& json = jsonBuffer.parseObject(buf.get());
 
   if (!json.success()) {
-    Serial.println("ERRO : [HIVEBOT] Unable to parse config json.");
+    HIVE_LOG_ERROR("HIVEBOT", "Unable to parse config json.");
     return false;
   }
 
@@ -65,15 +86,26 @@ bool loadConfigFromFile() {
   strcpy(config_mqtt_user, json["config_mqtt_user"]);
   strcpy(config_mqtt_pswd, json["config_mqtt_pswd"]);
 
-  Serial.print("DEBUG: [CONFIG] Loaded from Json[");
-  Serial.print(config_mqtt_server);Serial.print(", ");
-  Serial.print(config_mqtt_user);Serial.print(", ");
-  Serial.print(config_mqtt_pswd);Serial.print(" ");
-  Serial.println("] ");
+  HIVE_LOG_DEBUG("CONFIG", "Loaded from Json[%s, %s, ****]", config_mqtt_server, config_mqtt_user);
   
   return true;
 }
 
+// Config.json is only rewritten when WifiManager returned something different.
+char _loaded_mqtt_config[4][50];
+void rememberLoadedConfig(){
+  strcpy(_loaded_mqtt_config[0], config_mqtt_server);
+  strcpy(_loaded_mqtt_config[1], config_mqtt_server_port);
+  strcpy(_loaded_mqtt_config[2], config_mqtt_user);
+  strcpy(_loaded_mqtt_config[3], config_mqtt_pswd);
+}
+bool isConfigChangedSinceLoad(){
+  return strcmp(_loaded_mqtt_config[0], config_mqtt_server) != 0
+      || strcmp(_loaded_mqtt_config[1], config_mqtt_server_port) != 0
+      || strcmp(_loaded_mqtt_config[2], config_mqtt_user) != 0
+      || strcmp(_loaded_mqtt_config[3], config_mqtt_pswd) != 0;
+}
+
 bool saveConfigToFile() {
   StaticJsonBuffer<200> jsonBuffer;
   JsonObject& json = jsonBuffer.createObject();
@@ -82,16 +114,12 @@ bool saveConfigToFile() {
   json["config_mqtt_user"] = config_mqtt_user;
   json["config_mqtt_pswd"] = config_mqtt_pswd;
 
-  Serial.print("DEBUG: [CONFIG] Saving to Json[");
-  Serial.print(config_mqtt_server);Serial.print(", ");
-  Serial.print(config_mqtt_user);Serial.print(", ");
-  Serial.print(config_mqtt_pswd);Serial.print(" ");
-  Serial.println("] ");
+  HIVE_LOG_DEBUG("CONFIG", "Saving to Json[%s, %s, ****]", config_mqtt_server, config_mqtt_user);
   
 
   File configFile = SPIFFS.open(SPIFFS_CONFIG_JSONFILE, "w");
   if (!configFile) {
-    Serial.println("ERRO : [HIVEBOT] Unable to save config file");
+    HIVE_LOG_ERROR("HIVEBOT", "Unable to save config file");
     return false;
   }
   json.printTo(configFile);
@@ -0,0 +1,97 @@
+/*
+ * Report Policy, decides when a sensor reading is worth publishing.
+ * A metric is reported when it moved past its deadband since the last report, or when it is
+ * changing faster than its rate trigger between two readings. Otherwise the bot stays quiet
+ * until max silence expires, that report doubles as the HeartBeat.
+ *
+ * Thresholds come from HiveCentral in UpdateFunctions, all optional:
+ *   "settings":{"tempDeadband":"0.30","humidityDeadband":"2.00","tempRate":"0.25","humidityRate":"0","maxSilenceSecs":900}
+ * Rates are per minute, 0 turns the trigger off.
+ */
+
+#define REPORT_TEMP_DEADBAND_CENTI      30   // 0.30 C away from last reported, above the DHT22 0.1 C flicker
+#define REPORT_HUMIDITY_DEADBAND_CENTI  200  // 2.00 % away from last reported
+#define REPORT_TEMP_RATE_CENTI          25   // 0.25 C per minute
+#define REPORT_HUMIDITY_RATE_CENTI      0    // Off, DHT22 humidity is too noisy for it
+#define REPORT_MAX_SILENCE_SECS         900
+
+struct ReportMetric {
+  long deadbandCenti;
+  long rateCentiPerMin;
+  long lastReportedCenti;
+  long previousCenti;          //Reading before this one, for the rate trigger
+  unsigned long previousAtMs;
+  boolean havePrevious;
+};
+
+ReportMetric reportTemperature = {REPORT_TEMP_DEADBAND_CENTI, REPORT_TEMP_RATE_CENTI, 0, 0, 0, false};
+ReportMetric reportHumidity = {REPORT_HUMIDITY_DEADBAND_CENTI, REPORT_HUMIDITY_RATE_CENTI, 0, 0, 0, false};
+unsigned long reportMaxSilenceSecs = REPORT_MAX_SILENCE_SECS;
+
+boolean _reportHaveLast = false;      //Nothing reported since boot
+boolean _reportLastSensorOk = false;
+unsigned long _reportLastAtMs = 0;
+
+//Checks the deadband against the last report and the rate against the previous reading.
+boolean _reportMetricChanged(ReportMetric& metric, float value, unsigned long nowMs){
+  long valueCenti = lroundf(value * 100);
+  boolean changed = labs(valueCenti - metric.lastReportedCenti) >= metric.deadbandCenti;
+  if(metric.rateCentiPerMin > 0 && metric.havePrevious && nowMs != metric.previousAtMs){
+    //Rate scaled to per minute, compared without dividing.
+    unsigned long elapsedMs = nowMs - metric.previousAtMs;
+    changed = changed || (unsigned long)labs(valueCenti - metric.previousCenti) * 60000UL
+                          >= (unsigned long)metric.rateCentiPerMin * elapsedMs;
+  }
+  metric.previousCenti = valueCenti;
+  metric.previousAtMs = nowMs;
+  metric.havePrevious = true;
+  return changed;
+}
+
+boolean reportMaxSilenceExpired(){
+  return !_reportHaveLast || millis() - _reportLastAtMs >= reportMaxSilenceSecs * 1000UL;
+}
+
+//True when this reading should be published, call once per reading.
+boolean reportShouldPublish(boolean sensorOk, float temp, float humidity){
+  unsigned long nowMs = millis();
+  boolean publish = !_reportHaveLast || sensorOk != _reportLastSensorOk || reportMaxSilenceExpired();
+  if(sensorOk){
+    //Both metrics are evaluated, so rate tracking stays current.
+    boolean tempChanged = _reportMetricChanged(reportTemperature, temp, nowMs);
+    boolean humidityChanged = _reportMetricChanged(reportHumidity, humidity, nowMs);
+    publish = publish || tempChanged || humidityChanged;
+  }
+  return publish;
+}
+
+//Call once the report is out, the deadband is measured from here.
+void reportMarkPublished(boolean sensorOk, float temp, float humidity){
+  _reportHaveLast = true;
+  _reportLastSensorOk = sensorOk;
+  _reportLastAtMs = millis();
+  if(sensorOk){
+    reportTemperature.lastReportedCenti = lroundf(temp * 100);
+    reportHumidity.lastReportedCenti = lroundf(humidity * 100);
+  }
+}
+
+void _reportSettingCenti(JsonObject& settings, const char* key, long& target){
+  if(!settings.containsKey(key)) return;
+  target = lroundf(settings[key].as<float>() * 100);
+  if(target < 0) target = 0;
+}
+
+void updateReportSettings(JsonObject& settings){
+  _reportSettingCenti(settings, "tempDeadband", reportTemperature.deadbandCenti);
+  _reportSettingCenti(settings, "humidityDeadband", reportHumidity.deadbandCenti);
+  _reportSettingCenti(settings, "tempRate", reportTemperature.rateCentiPerMin);
+  _reportSettingCenti(settings, "humidityRate", reportHumidity.rateCentiPerMin);
+  if(settings.containsKey("maxSilenceSecs")){
+    long maxSilenceSecs = settings["maxSilenceSecs"].as<long>();
+    if(maxSilenceSecs > 0) reportMaxSilenceSecs = maxSilenceSecs;
+  }
+  HIVE_LOG_DEBUG("REPORT", "Deadband T:%ld H:%ld Rate T:%ld H:%ld (centi) MaxSilence:%lus",
+    reportTemperature.deadbandCenti, reportHumidity.deadbandCenti,
+    reportTemperature.rateCentiPerMin, reportHumidity.rateCentiPerMin, reportMaxSilenceSecs);
+}
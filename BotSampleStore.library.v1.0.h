@@ -0,0 +1,149 @@
+/*
+ * Sample Store, DHT22 readings kept in RTC user memory across DeepSleep.
+ * With DeepSleep on, most wakeups only read the sensor and go back to sleep with the radio off.
+ * The radio comes up every SAMPLE_STORE_PUBLISH_EVERY_WAKEUPS wakeups, or when a reading moves
+ * past the threshold, and the whole batch goes out in one SensorData message.
+ *
+ * millis() restarts on every wake, so the store keeps its own clock (seconds) advanced by
+ * the awake time and the sleep duration. Samples are published with their age in seconds.
+ */
+
+#define SAMPLE_STORE_CAPACITY                 8
+#define SAMPLE_STORE_PUBLISH_EVERY_WAKEUPS    5
+#define SAMPLE_STORE_TEMP_THRESHOLD_CENTI     50   // 0.50 C away from last published
+#define SAMPLE_STORE_HUMIDITY_THRESHOLD_CENTI 300  // 3.00 % away from last published
+#define SAMPLE_STORE_MAGIC                    0x48535331UL // "HSS1"
+
+#define SAMPLE_STORE_DEEPSLEEP  0x01 //DeepSleep function enabled by HiveCentral
+#define SAMPLE_STORE_DHT22      0x02 //DHT22 function enabled by HiveCentral
+#define SAMPLE_STORE_RADIO_OFF  0x04 //This wake has the radio disabled
+#define SAMPLE_STORE_PUBLISHED  0x08 //lastPublished values are valid
+
+struct StoredSample {
+  uint32_t atSecs;
+  int16_t tempCenti;
+  uint16_t humidityCenti;
+};
+
+struct SampleStore {
+  uint32_t crc;         //Over everything after this field
+  uint32_t magic;
+  uint32_t clockSecs;
+  uint16_t wakeups;     //Since the last publish
+  uint8_t head;         //Next slot to write
+  uint8_t count;
+  uint8_t flags;
+  uint8_t reserved[3];
+  int16_t lastPublishedTempCenti;
+  uint16_t lastPublishedHumidityCenti;
+  StoredSample samples[SAMPLE_STORE_CAPACITY];
+};
+static_assert(sizeof(SampleStore) % 4 == 0, "RTC memory is read and written in 4 byte blocks");
+
+SampleStore sampleStore;
+
+void flushInstructionCache(); //HiveInstructions, its flash copy before the power can go
+void saveHiveSchedule();      //HiveSchedule, the wheel is RAM
+uint32_t scheduleDeepSleepSecs(uint32_t sleepSecs, boolean& radioOnNextWake);
+void saveAirconSent(uint32_t sleepSecs); //IRAirconRemote, the A/C stays as it was
+
+uint32_t _sampleStoreCrc(){
+  return hiveCrc32((const uint8_t*)&sampleStore + sizeof(sampleStore.crc), sizeof(sampleStore) - sizeof(sampleStore.crc));
+}
+
+void resetSampleStore(){
+  memset(&sampleStore, 0, sizeof(sampleStore));
+  sampleStore.magic = SAMPLE_STORE_MAGIC;
+}
+
+//False when RTC memory was lost (power on) or corrupt, the store is reset.
+boolean loadSampleStore(){
+  ESP.rtcUserMemoryRead(RTC_SAMPLE_STORE_ADDRESS, (uint32_t*)&sampleStore, sizeof(sampleStore));
+  if(sampleStore.magic != SAMPLE_STORE_MAGIC || sampleStore.crc != _sampleStoreCrc()
+      || sampleStore.head >= SAMPLE_STORE_CAPACITY || sampleStore.count > SAMPLE_STORE_CAPACITY){
+    HIVE_LOG_DEBUG("SAMPLES", "No valid Sample Store in RTC memory, starting fresh.");
+    resetSampleStore();
+    return false;
+  }
+  return true;
+}
+
+void saveSampleStore(){
+  sampleStore.crc = _sampleStoreCrc();
+  ESP.rtcUserMemoryWrite(RTC_SAMPLE_STORE_ADDRESS, (uint32_t*)&sampleStore, sizeof(sampleStore));
+}
+
+uint32_t sampleStoreNowSecs(){
+  return sampleStore.clockSecs + millis() / 1000;
+}
+
+void sampleStoreSetFlag(uint8_t flag, boolean on){
+  if(on) sampleStore.flags |= flag;
+  else sampleStore.flags &= ~flag;
+}
+
+//Oldest sample is overwritten when full.
+void sampleStorePush(float temp, float humidity){
+  StoredSample& sample = sampleStore.samples[sampleStore.head];
+  sample.atSecs = sampleStoreNowSecs();
+  sample.tempCenti = (int16_t)lroundf(temp * 100);
+  sample.humidityCenti = (uint16_t)lroundf(humidity * 100);
+  sampleStore.head = (sampleStore.head + 1) % SAMPLE_STORE_CAPACITY;
+  if(sampleStore.count < SAMPLE_STORE_CAPACITY) sampleStore.count++;
+}
+
+//Time to bring the radio up, batch is due or the newest reading moved past the threshold.
+boolean sampleStoreNeedsPublish(){
+  if(sampleStore.wakeups >= SAMPLE_STORE_PUBLISH_EVERY_WAKEUPS) return true;
+  if(sampleStore.count >= SAMPLE_STORE_CAPACITY) return true;
+  if(sampleStore.count == 0 || !(sampleStore.flags & SAMPLE_STORE_PUBLISHED)) return false;
+  const StoredSample& newest = sampleStore.samples[(sampleStore.head + SAMPLE_STORE_CAPACITY - 1) % SAMPLE_STORE_CAPACITY];
+  return abs(newest.tempCenti - sampleStore.lastPublishedTempCenti) >= SAMPLE_STORE_TEMP_THRESHOLD_CENTI
+      || abs((int)newest.humidityCenti - (int)sampleStore.lastPublishedHumidityCenti) >= SAMPLE_STORE_HUMIDITY_THRESHOLD_CENTI;
+}
+
+//Adds "Samples":[{"ageSecs":..,"t":"23.40","h":"55.10"},..] oldest first.
+void writeSampleStoreDataMap(HivePayloadWriter& dataMap){
+  if(sampleStore.count == 0) return;
+  uint32_t nowSecs = sampleStoreNowSecs();
+  dataMap.beginArray(HF_Samples);
+  for(uint8_t i=0;i<sampleStore.count;i++){
+    const StoredSample& sample = sampleStore.samples[(sampleStore.head + SAMPLE_STORE_CAPACITY - sampleStore.count + i) % SAMPLE_STORE_CAPACITY];
+    dataMap.beginObject();
+    dataMap.addLong(HF_SampleAgeSecs, nowSecs - sample.atSecs);
+    dataMap.addFixed(HF_SampleTemperature, sample.tempCenti / 100.0f, 2);
+    dataMap.addFixed(HF_SampleHumidity, sample.humidityCenti / 100.0f, 2);
+    dataMap.endObject();
+  }
+  dataMap.endArray();
+}
+
+void sampleStoreMarkPublished(){
+  sampleStore.count = 0;
+  sampleStore.wakeups = 0;
+}
+
+//Reference for the threshold check on the following radio-off wakes.
+void sampleStoreSetLastPublished(float temp, float humidity){
+  sampleStore.lastPublishedTempCenti = (int16_t)lroundf(temp * 100);
+  sampleStore.lastPublishedHumidityCenti = (uint16_t)lroundf(humidity * 100);
+  sampleStoreSetFlag(SAMPLE_STORE_PUBLISHED, true);
+}
+
+/*
+ * Saves the store and sleeps. Radio for the next wake is decided here,
+ * the ESP8266 can only enable it again through another DeepSleep.
+ * A scheduled instruction pending cuts the sleep short and keeps the radio on.
+ */
+void sampleStoreDeepSleep(uint32_t sleepSecs, boolean radioOnNextWake){
+  sleepSecs = scheduleDeepSleepSecs(sleepSecs, radioOnNextWake);
+  sampleStore.clockSecs = sampleStoreNowSecs() + sleepSecs;
+  sampleStoreSetFlag(SAMPLE_STORE_RADIO_OFF, !radioOnNextWake);
+  saveSampleStore();
+  energyDeepSleep(sleepSecs);
+  saveAirconSent(sleepSecs);
+  flushInstructionCache();
+  saveHiveSchedule();
+  flushHiveLog();
+  ESP.deepSleep(sleepSecs > 0 ? sleepSecs * 1000000ULL : 1, radioOnNextWake ? WAKE_RF_DEFAULT : WAKE_RF_DISABLED);
+}
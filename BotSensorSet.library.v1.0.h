@@ -0,0 +1,76 @@
+/*
+ * Sensor Set, the sensors of this bot as a compile-time list of drivers.
+ *   typedef SensorSet<Dht22Driver, Co2Driver> BotSensorSet;
+ *   if(BotSensorSet::sample()){ BotSensorSet::writeDataMap(dataMap); .. BotSensorSet::markPublished(); }
+ * Every call walks the list in one pass, resolved at compile time. No virtuals, no heap.
+ *
+ * A driver is a type with static functions:
+ *   static void poll();                                     //Background sampling, cheap when nothing is due
+ *   static boolean sample();                                //Takes the reading to report, true when it is worth publishing
+ *   static void writeDataMap(HivePayloadWriter& dataMap);   //Its fields, or its error status
+ *   static void markPublished();                            //The report is out
+ * Add the driver's fields to HIVE_PAYLOAD_FIELDS and the driver to BotSensorSet.
+ */
+
+#define SENSOR_POLL_MS DHT22_MIN_INTERVAL_MS //Shortest interval any driver needs
+
+template<typename... Drivers> struct SensorSet;
+
+template<> struct SensorSet<> {
+  static void poll(){}
+  static boolean sample(){ return false; }
+  static void writeDataMap(HivePayloadWriter& dataMap){}
+  static void markPublished(){}
+};
+
+template<typename Driver, typename... Rest> struct SensorSet<Driver, Rest...> {
+  static void poll(){
+    Driver::poll();
+    SensorSet<Rest...>::poll();
+  }
+  //Every driver samples, even once one already wants to publish.
+  static boolean sample(){
+    boolean publish = Driver::sample();
+    return SensorSet<Rest...>::sample() || publish;
+  }
+  static void writeDataMap(HivePayloadWriter& dataMap){
+    Driver::writeDataMap(dataMap);
+    SensorSet<Rest...>::writeDataMap(dataMap);
+  }
+  static void markPublished(){
+    Driver::markPublished();
+    SensorSet<Rest...>::markPublished();
+  }
+};
+
+/*
+ * DHT22 on D5, with the readings batched in the Sample Store while the radio was off.
+ */
+struct Dht22Driver {
+  static void poll(){
+    pollDht22Sampler();
+  }
+  static boolean sample(){
+    boolean sensorOk = readSensors();
+    //Nothing to report while the sampler retries, unless a batch is waiting (it always goes out).
+    if(!sensorOk && isDht22Retrying()) return sampleStore.count > 0;
+    return reportShouldPublish(sensorOk, dht22_temp_f, dht22_humidity) || sampleStore.count > 0;
+  }
+  static void writeDataMap(HivePayloadWriter& dataMap){
+    if(dht22_active){
+      dataMap.addFixed(HF_Temperature, dht22_temp_f, 2);
+      dataMap.addFixed(HF_HumidityPercent, dht22_humidity, 2);
+      dataMap.addString(HF_DHT22SensorStatus, "OK");
+    }else if(!isDht22Retrying()){
+      dataMap.addFixed(HF_Temperature, -1, 0);
+      dataMap.addFixed(HF_HumidityPercent, -1, 0);
+      dataMap.addString(HF_DHT22SensorStatus, "Error Reading DHT22.");
+    }
+    writeSampleStoreDataMap(dataMap); //Readings batched while the radio was off, if any.
+  }
+  static void markPublished(){
+    if(dht22_active || !isDht22Retrying()) reportMarkPublished(dht22_active, dht22_temp_f, dht22_humidity);
+    sampleStoreMarkPublished();
+    if(dht22_active) sampleStoreSetLastPublished(dht22_temp_f, dht22_humidity);
+  }
+};
@@ -1,33 +1,175 @@
 /*  DHT22 , Sensor 1
  *  Library Required 'Adafruit_Unified_Sensor'
- *  
+ *
+ *  Sampled by a state machine polled from the Sensor Set, readSensors() reports the filtered value:
+ *  -- One conversion per sample, never two within the DHT22 2 second minimum, a read inside
+ *     that window is served from the last samples.
+ *  -- Median of the last DHT22_FILTER_SAMPLES good samples, a sample far from the median is
+ *     rejected unless the next ones agree with it (a real step, AC switched on).
+ *  -- A failed read is retried after 2, 4 and 8s (DHT22_MAX_RETRIES), the sensor is only
+ *     reported as failed once the last retry fails too.
+ *  -- The filter costs conversions: 5 per Sensor report at the default cadence, where a plain read
+ *     at report time is 1. -DDHT22_SAMPLE_EVERY_MS=60000 brings it back to 1 per report, the median
+ *     then spans the last 5 reports and a real step shows up one report later.
+ *  The conversion goes through dht22Reader, point it at a scripted reader to drive the filter.
  */
-#include <DHT.h>      
-#define DHTTYPE DHT22       
+#include <DHT.h>
+#define DHTTYPE DHT22
 #define DHTPIN  2
 
 /* DHT 22 Sensor Information ------------------------- */
 DHT dht(D5, DHTTYPE);
 
+#define DHT22_MIN_INTERVAL_MS        2000  //Datasheet, sooner returns the previous conversion
+#ifndef DHT22_SAMPLE_EVERY_MS
+#define DHT22_SAMPLE_EVERY_MS        12000 //5 samples per Sensor report
+#endif
+#define DHT22_FILTER_SAMPLES         5
+#define DHT22_SAMPLE_MAX_AGE_MS      (DHT22_SAMPLE_EVERY_MS * (DHT22_FILTER_SAMPLES + 1))
+#define DHT22_MAX_RETRIES            3     //After the failed read, backoff doubles from DHT22_MIN_INTERVAL_MS
+#define DHT22_OUTLIER_TEMP_CENTI     200   //2.00 C away from the median
+#define DHT22_OUTLIER_HUMIDITY_CENTI 1000  //10.00 % away from the median
+#define DHT22_OUTLIER_PERSIST        2     //Outliers in a row taken as a real step
+
+typedef boolean (*Dht22Reader)(float& temp, float& humidity);
+
+struct Dht22Sample {
+  int16_t tempCenti;
+  int16_t humidityCenti;
+  unsigned long atMs;
+};
+
+enum Dht22SamplerState {
+  DHT22_SAMPLING,   //Next sample on the DHT22_SAMPLE_EVERY_MS cadence
+  DHT22_RETRYING,   //Last read failed, retrying with backoff
+  DHT22_FAILED      //Read and DHT22_MAX_RETRIES retries failed, reported as failed until a read succeeds
+};
 
 // Values read from sensor
 boolean dht22_active =false;
-float dht22_humidity, dht22_temp_f;  
-boolean _readDht22Sensors(){
-  dht22_humidity = dht.readHumidity();          // Read humidity (percent)
-  dht22_temp_f = dht.readTemperature();     
-  //Serial.println("DEBUG: [DHT22] Sensor Out H." + String((float)dht22_humidity) + "   T."  + String((float)dht22_temp_f));
-  if (isnan(dht22_humidity) || isnan(dht22_temp_f)) {
-    Serial.println("DEBUG: [DHT22] Failed to read from DHT sensor!");
-    dht22_active=false;
+float dht22_humidity, dht22_temp_f;
+
+Dht22Sample _dht22Samples[DHT22_FILTER_SAMPLES];
+uint8_t _dht22SampleCount = 0;
+uint8_t _dht22SampleNext = 0;
+uint8_t _dht22Outliers = 0;          //Rejected in a row
+uint8_t _dht22Failures = 0;          //Failed reads in a row
+Dht22SamplerState _dht22State = DHT22_SAMPLING;
+boolean _dht22HaveRead = false;      //Nothing read since boot, the first read is due now
+unsigned long _dht22ReadAtMs = 0;
+
+boolean _readDht22Hardware(float& temp, float& humidity){
+  EnergyPhase previousPhase = energyEnterPhase(ENERGY_DHT22);
+  //One conversion, the two reads after it are served from the library cache.
+  boolean converted = dht.read(true);
+  temp = dht.readTemperature();
+  humidity = dht.readHumidity();
+  energyEnterPhase(previousPhase);
+  return converted && !isnan(temp) && !isnan(humidity);
+}
+Dht22Reader dht22Reader = _readDht22Hardware;
+
+void _dht22SortCenti(int16_t* values, uint8_t count){
+  for(int i=1;i<count;i++){
+    int16_t value = values[i];
+    int j = i - 1;
+    while(j>=0 && values[j] > value){
+      values[j+1] = values[j];
+      j--;
+    }
+    values[j+1] = value;
+  }
+}
+
+//Median of the samples younger than DHT22_SAMPLE_MAX_AGE_MS, false when there are none.
+boolean dht22Median(int16_t& tempCenti, int16_t& humidityCenti){
+  int16_t temps[DHT22_FILTER_SAMPLES];
+  int16_t humidities[DHT22_FILTER_SAMPLES];
+  uint8_t count = 0;
+  unsigned long nowMs = millis();
+  for(int i=0;i<_dht22SampleCount;i++){
+    if(nowMs - _dht22Samples[i].atMs > DHT22_SAMPLE_MAX_AGE_MS) continue;
+    temps[count] = _dht22Samples[i].tempCenti;
+    humidities[count] = _dht22Samples[i].humidityCenti;
+    count++;
+  }
+  if(count == 0) return false;
+  _dht22SortCenti(temps, count);
+  _dht22SortCenti(humidities, count);
+  //Even count, mean of the two in the middle.
+  tempCenti = (temps[(count - 1) / 2] + temps[count / 2]) / 2;
+  humidityCenti = (humidities[(count - 1) / 2] + humidities[count / 2]) / 2;
+  return true;
+}
+
+//Adds a good read to the window, unless it is an outlier against the median of three or more.
+boolean dht22AddSample(float temp, float humidity){
+  Dht22Sample sample = {(int16_t)lroundf(temp * 100), (int16_t)lroundf(humidity * 100), millis()};
+  int16_t medianTempCenti, medianHumidityCenti;
+  if(_dht22SampleCount >= 3 && dht22Median(medianTempCenti, medianHumidityCenti)
+      && (abs(sample.tempCenti - medianTempCenti) > DHT22_OUTLIER_TEMP_CENTI
+          || abs(sample.humidityCenti - medianHumidityCenti) > DHT22_OUTLIER_HUMIDITY_CENTI)){
+    _dht22Outliers++;
+    if(_dht22Outliers < DHT22_OUTLIER_PERSIST){
+      HIVE_LOG_DEBUG("DHT22", "Outlier rejected T:%d H:%d (centi)", sample.tempCenti, sample.humidityCenti);
+      return false;
+    }
+    HIVE_LOG_DEBUG("DHT22", "Step change, filter restarted.");
+    _dht22SampleCount = 0;
+    _dht22SampleNext = 0;
+  }
+  _dht22Outliers = 0;
+  _dht22Samples[_dht22SampleNext] = sample;
+  _dht22SampleNext = (_dht22SampleNext + 1) % DHT22_FILTER_SAMPLES;
+  if(_dht22SampleCount < DHT22_FILTER_SAMPLES) _dht22SampleCount++;
+  return true;
+}
+
+unsigned long _dht22NextReadInMs(){
+  if(_dht22State == DHT22_SAMPLING || _dht22State == DHT22_FAILED) return DHT22_SAMPLE_EVERY_MS;
+  unsigned long backoffMs = (unsigned long)DHT22_MIN_INTERVAL_MS << (_dht22Failures - 1);
+  return backoffMs < DHT22_SAMPLE_EVERY_MS ? backoffMs : DHT22_SAMPLE_EVERY_MS;
+}
+
+//Takes one sample when due, cheap to call as often as needed.
+void pollDht22Sampler(){
+  unsigned long nowMs = millis();
+  if(_dht22HaveRead && nowMs - _dht22ReadAtMs < _dht22NextReadInMs()) return;
+  _dht22HaveRead = true;
+  _dht22ReadAtMs = nowMs;
+  float temp, humidity;
+  boolean readOk = dht22Reader(temp, humidity)
+    && temp >= -40 && temp <= 80 && humidity >= 0 && humidity <= 100; //DHT22 range, anything else is a bad frame
+  if(readOk){
+    dht22AddSample(temp, humidity);
+    _dht22Failures = 0;
+    _dht22State = DHT22_SAMPLING;
+    return;
+  }
+  if(_dht22Failures < 255) _dht22Failures++;
+  if(_dht22State == DHT22_FAILED) return;
+  if(_dht22Failures > DHT22_MAX_RETRIES){
+    HIVE_LOG_WARN("DHT22", "Failed to read from DHT sensor, %d tries.", _dht22Failures);
+    _dht22State = DHT22_FAILED;
   }else{
-    dht22_active = true;
+    HIVE_LOG_DEBUG("DHT22", "Failed to read from DHT sensor, retry in %lus.", _dht22NextReadInMs() / 1000);
+    _dht22State = DHT22_RETRYING;
   }
 }
 
-boolean readSensors(){
-  _readDht22Sensors();
+//No good sample yet, but retries are left. Worth waiting instead of reporting an error.
+boolean isDht22Retrying(){
+  int16_t tempCenti, humidityCenti;
+  return _dht22State == DHT22_RETRYING && !dht22Median(tempCenti, humidityCenti);
+}
 
+boolean readSensors(){
+  pollDht22Sampler(); //First read after boot or DeepSleep happens right here.
+  int16_t tempCenti, humidityCenti;
+  dht22_active = _dht22State != DHT22_FAILED && dht22Median(tempCenti, humidityCenti);
+  if(dht22_active){
+    dht22_temp_f = tempCenti / 100.0f;
+    dht22_humidity = humidityCenti / 100.0f;
+  }
   return dht22_active;
 }
-
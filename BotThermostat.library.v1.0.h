@@ -0,0 +1,176 @@
+/*
+ * Thermostat, the bot drives the AC from its own DHT22 readings, no round trip to HiveCentral.
+ * Switched on with THERMOSTAT in UpdateFunctions, settings come with it, all optional:
+ *   "settings":{"thermostatSetpoint":"24.00","thermostatHysteresis":"0.50","thermostatMinOnSecs":300,
+ *               "thermostatMinOffSecs":180,"thermostatOnProfile":1,"thermostatOffProfile":0}
+ * Cools: on at setpoint + hysteresis, off at setpoint - hysteresis. Heats instead when the
+ * on profile is in HEAT mode. A switch waits out the compressor minimum on / off time, counted
+ * from the last power switch whoever made it (applyAirconProfile() records it, in RTC memory
+ * too, so after a DeepSleep or a REBOOT the thermostat still knows what the A/C was sent).
+ * The sensor failed (not retrying) turns the AC off.
+ *
+ * Runs from loop() whether connected or not, every switch is published with the reading that
+ * caused it, queued while offline. Settings and the THERMOSTAT switch are kept on SPIFFS, so
+ * after a reboot without the broker the thermostat carries on. They are read on first use, the
+ * first check or UpdateFunctions, so a Fast Wake boot publishes before SPIFFS is mounted.
+ * thermostatDecide() is the whole control law, test/BotThermostatTest.cpp drives it from a thermal model.
+ */
+
+#define THERMOSTAT_CHECK_MS             (1000 * 30)
+#define THERMOSTAT_SETPOINT_CENTI       2400
+#define THERMOSTAT_HYSTERESIS_CENTI     50   // 0.50 C either side of the setpoint
+#define THERMOSTAT_MIN_ON_SECS          300
+#define THERMOSTAT_MIN_OFF_SECS         180  //Compressor pressures equalise
+#define THERMOSTAT_ON_PROFILE           1
+#define THERMOSTAT_OFF_PROFILE          0
+#define THERMOSTAT_SETTINGS_FILE        "/thermostat"
+#define THERMOSTAT_SETTINGS_MAGIC       0x48545331UL // "HTS1"
+
+struct ThermostatSettings {
+  uint32_t magic;
+  uint8_t enabled;
+  uint8_t onProfile;
+  uint8_t offProfile;
+  uint8_t reserved;
+  int32_t setpointCenti;
+  int32_t hysteresisCenti;
+  uint32_t minOnSecs;
+  uint32_t minOffSecs;
+};
+
+enum ThermostatAction {
+  THERMOSTAT_HOLD,
+  THERMOSTAT_SWITCH_ON,
+  THERMOSTAT_SWITCH_OFF
+};
+
+ThermostatSettings thermostatSettings = {THERMOSTAT_SETTINGS_MAGIC, false, THERMOSTAT_ON_PROFILE, THERMOSTAT_OFF_PROFILE, 0,
+  THERMOSTAT_SETPOINT_CENTI, THERMOSTAT_HYSTERESIS_CENTI, THERMOSTAT_MIN_ON_SECS, THERMOSTAT_MIN_OFF_SECS};
+EventTimer thermostatTimer("Thermostat", THERMOSTAT_CHECK_MS, false, true);
+
+boolean _thermostatOn = false;
+boolean _thermostatSettingsLoaded = false;
+
+boolean _isThermostatHeating(){
+  _loadAirconProfiles();
+  return thermostatSettings.onProfile < AIRCON_PROFILE_SLOTS
+      && airconProfiles[thermostatSettings.onProfile].settings.mode == AIRCON_MODE_HEAT;
+}
+
+//The control law, no side effects. sinceSwitchMs is ignored when haveSwitched is false.
+ThermostatAction thermostatDecide(const ThermostatSettings& settings, boolean heating, boolean isOn,
+    boolean sensorOk, long tempCenti, boolean haveSwitched, unsigned long sinceSwitchMs){
+  ThermostatAction action = THERMOSTAT_HOLD;
+  if(!sensorOk){
+    if(isOn) action = THERMOSTAT_SWITCH_OFF;
+  }else{
+    long error = heating ? settings.setpointCenti - tempCenti : tempCenti - settings.setpointCenti;
+    if(!isOn && error >= settings.hysteresisCenti) action = THERMOSTAT_SWITCH_ON;
+    if(isOn && error <= -settings.hysteresisCenti) action = THERMOSTAT_SWITCH_OFF;
+  }
+  if(action == THERMOSTAT_HOLD || !haveSwitched) return action;
+  unsigned long minMs = (isOn ? settings.minOnSecs : settings.minOffSecs) * 1000UL;
+  return sinceSwitchMs >= minMs ? action : THERMOSTAT_HOLD;
+}
+
+void _saveThermostatSettings(){
+  File settingsFile;
+  if(SPIFFS.begin()) settingsFile = SPIFFS.open(THERMOSTAT_SETTINGS_FILE, "w");
+  if(!settingsFile){
+    HIVE_LOG_ERROR("THERMOSTAT", "Unable to save settings.");
+    return;
+  }
+  settingsFile.write((const uint8_t*)&thermostatSettings, sizeof(thermostatSettings));
+  settingsFile.close();
+}
+
+//Last settings from SPIFFS, the thermostat runs from boot when it was on.
+void _loadThermostatSettings(){
+  if(_thermostatSettingsLoaded) return;
+  _thermostatSettingsLoaded = true;
+  File settingsFile;
+  if(SPIFFS.begin()) settingsFile = SPIFFS.open(THERMOSTAT_SETTINGS_FILE, "r");
+  if(settingsFile){
+    ThermostatSettings saved;
+    if(settingsFile.read((uint8_t*)&saved, sizeof(saved)) == sizeof(saved) && saved.magic == THERMOSTAT_SETTINGS_MAGIC){
+      thermostatSettings = saved;
+    }
+    settingsFile.close();
+  }
+  thermostatTimer.enabled(thermostatSettings.enabled);
+  if(thermostatSettings.enabled) HIVE_LOG_INFO("THERMOSTAT", "Resumed, setpoint %ld (centi)", (long)thermostatSettings.setpointCenti);
+}
+
+//The first check loads the settings, and stops the timer again when the thermostat was off.
+void setupThermostat(){
+  _thermostatSettingsLoaded = false;
+  thermostatTimer.enabled(true);
+}
+
+//From UpdateFunctions, saved when anything changed.
+boolean enableThermostat(boolean enabled){
+  _loadThermostatSettings();
+  thermostatTimer.enabled(enabled);
+  if(thermostatSettings.enabled != enabled){
+    thermostatSettings.enabled = enabled;
+    _saveThermostatSettings();
+  }
+  return enabled;
+}
+
+void updateThermostatSettings(JsonObject& settings){
+  _loadThermostatSettings();
+  ThermostatSettings updated = thermostatSettings;
+  if(settings.containsKey("thermostatSetpoint")) updated.setpointCenti = lroundf(settings["thermostatSetpoint"].as<float>() * 100);
+  if(settings.containsKey("thermostatHysteresis")) updated.hysteresisCenti = lroundf(settings["thermostatHysteresis"].as<float>() * 100);
+  if(settings.containsKey("thermostatMinOnSecs")) updated.minOnSecs = settings["thermostatMinOnSecs"].as<long>();
+  if(settings.containsKey("thermostatMinOffSecs")) updated.minOffSecs = settings["thermostatMinOffSecs"].as<long>();
+  if(settings.containsKey("thermostatOnProfile")) updated.onProfile = settings["thermostatOnProfile"].as<long>();
+  if(settings.containsKey("thermostatOffProfile")) updated.offProfile = settings["thermostatOffProfile"].as<long>();
+  if(updated.hysteresisCenti < 0) updated.hysteresisCenti = 0;
+  if(updated.onProfile >= AIRCON_PROFILE_SLOTS || updated.offProfile >= AIRCON_PROFILE_SLOTS){
+    HIVE_LOG_ERROR("THERMOSTAT", "Invalid profiles On:%d Off:%d, settings kept.", updated.onProfile, updated.offProfile);
+    return;
+  }
+  if(memcmp(&updated, &thermostatSettings, sizeof(updated)) == 0) return;
+  thermostatSettings = updated;
+  _saveThermostatSettings();
+  HIVE_LOG_DEBUG("THERMOSTAT", "Setpoint:%ld Hysteresis:%ld (centi) MinOn:%lus MinOff:%lus Profiles On:%d Off:%d",
+    (long)thermostatSettings.setpointCenti, (long)thermostatSettings.hysteresisCenti,
+    (unsigned long)thermostatSettings.minOnSecs, (unsigned long)thermostatSettings.minOffSecs,
+    thermostatSettings.onProfile, thermostatSettings.offProfile);
+}
+
+//The switch and the reading behind it.
+void _publishThermostatSwitch(boolean sensorOk){
+  HivePayloadWriter& dataMap = beginHivePayload(DATATYPE_SENSOR_DATA);
+  writeAirconProfileDataMap(dataMap);
+  dataMap.addString(HF_Thermostat, sensorOk ? (_thermostatOn ? "ON" : "OFF") : "SENSOR_FAILED");
+  dataMap.addFixed(HF_ThermostatSetpoint, thermostatSettings.setpointCenti / 100.0f, 2);
+  if(sensorOk) dataMap.addFixed(HF_Temperature, dht22_temp_f, 2);
+  publishHivePayload();
+}
+
+//Call every pass of loop(), connected or not. Cheap until a check is due.
+void pollThermostat(){
+  if(!thermostatTimer.isEnabled()) return;
+  if(!_thermostatSettingsLoaded){
+    if(thermostatTimer.isDueForRun()) _loadThermostatSettings();
+    return;
+  }
+  pollDht22Sampler(); //The Sensor task only samples while connected.
+  if(!thermostatTimer.isDueForRun()) return;
+  boolean sensorOk = readSensors();
+  if(!sensorOk && isDht22Retrying()) return;
+  //Follows what was sent last, an IRAC_ instruction in between counts, its switch time too.
+  _thermostatOn = _airconSent.power;
+  ThermostatAction action = thermostatDecide(thermostatSettings, _isThermostatHeating(), _thermostatOn,
+    sensorOk, lroundf(dht22_temp_f * 100), airconHaveSwitched, millis() - airconSwitchedAtMs);
+  if(action == THERMOSTAT_HOLD) return;
+  uint8_t profile = action == THERMOSTAT_SWITCH_ON ? thermostatSettings.onProfile : thermostatSettings.offProfile;
+  if(!applyAirconProfile(profile)) return;
+  _thermostatOn = action == THERMOSTAT_SWITCH_ON;
+  HIVE_LOG_INFO("THERMOSTAT", "AC %s at %ld (centi), profile %d", _thermostatOn ? "ON" : "OFF",
+    sensorOk ? lroundf(dht22_temp_f * 100) : -1L, profile);
+  _publishThermostatSwitch(sensorOk);
+}
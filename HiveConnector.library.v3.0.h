@@ -37,29 +37,131 @@ DoubleResetDetector drd(DRD_TIMEOUT, DRD_ADDRESS);
 
 bool _shouldSaveConfigToFile = false;
 void _saveConfigCallback () {
-  Serial.println("INFO : [HIVEBOT] Recieved Config from AP (Soft Access Point Mode)");
+  HIVE_LOG_INFO("HIVEBOT", "Recieved Config from AP (Soft Access Point Mode)");
   _shouldSaveConfigToFile = true;
 }
 
 void _configModeCallback (WiFiManager *myWiFiManager) {
-  Serial.println("INFO : [HIVEBOT] Entering ConfigMode: AP (Soft Access Point Mode)");
-  Serial.print  ("INFO : [HIVEBOT]    > Connect to Soft Wifi AccessPoint: " );
-  Serial.println(bot_accessPointName);
-  Serial.print  ("INFO : [HIVEBOT]    > Configure at http://");
-  Serial.println(WiFi.softAPIP() );
+  HIVE_LOG_INFO("HIVEBOT", "Entering ConfigMode: AP (Soft Access Point Mode)");
+  HIVE_LOG_INFO("HIVEBOT", "   > Connect to Soft Wifi AccessPoint: %s", bot_accessPointName);
+  HIVE_LOG_INFO("HIVEBOT", "   > Configure at http://%s", WiFi.softAPIP().toString().c_str());
   
   drd.stop(); //Reset , so next boot does not go into SoftAP Config Mode.
 }
 
 
+/*
+ * Boot Phases, millis() at which each phase was first reached this boot.
+ * Time from wake to first publish is what a DeepSleep sample costs in energy.
+ */
+enum BootPhase { BOOT_PHASE_WIFI_CONNECTED, BOOT_PHASE_MQTT_CONNECTED, BOOT_PHASE_FIRST_PUBLISH, BOOT_PHASE_COUNT };
+unsigned long bootPhaseAtMs[BOOT_PHASE_COUNT];
+boolean bootFastWake = false;
+void markBootPhase(BootPhase phase){
+  if(bootPhaseAtMs[phase] != 0) return;
+  bootPhaseAtMs[phase] = millis();
+  if(phase == BOOT_PHASE_FIRST_PUBLISH){
+    HIVE_LOG_INFO("HIVEBOT", "Boot (%s) wifi:%lums mqtt:%lums firstPublish:%lums", bootFastWake ? "FAST" : "FULL",
+      bootPhaseAtMs[BOOT_PHASE_WIFI_CONNECTED], bootPhaseAtMs[BOOT_PHASE_MQTT_CONNECTED], bootPhaseAtMs[BOOT_PHASE_FIRST_PUBLISH]);
+  }
+}
+
+/*
+ * Fast Wake, after DeepSleep reconnect straight to the last AccessPoint with the last IP lease
+ * and MQTT settings kept in RTC memory. Skips SPIFFS, config.json and WifiManager.
+ * Any failure falls back to the full WifiManager flow.
+ */
+#define FAST_WAKE_MAGIC 0x48465731UL // "HFW1"
+#define FAST_WAKE_WIFI_TIMEOUT_MS 3000
+struct FastWakeState {
+  uint32_t crc;         //Over everything after this field
+  uint32_t magic;
+  uint8_t bssid[6];
+  uint8_t channel;
+  uint8_t reserved;
+  uint32_t localIp;
+  uint32_t gatewayIp;
+  uint32_t subnetMask;
+  uint32_t dnsIp;
+  char mqttServer[sizeof(config_mqtt_server)];
+  char mqttServerPort[sizeof(config_mqtt_server_port)];
+  char mqttUser[sizeof(config_mqtt_user)];
+  char mqttPswd[sizeof(config_mqtt_pswd)];
+  uint8_t padding[1];
+};
+static_assert(sizeof(FastWakeState) % 4 == 0, "RTC memory is read and written in 4 byte blocks");
+static_assert(sizeof(FastWakeState) <= 47 * 4, "FastWakeState overflows its RTC blocks");
+FastWakeState fastWakeState;
+
+uint32_t _fastWakeCrc(){
+  return hiveCrc32((const uint8_t*)&fastWakeState + sizeof(fastWakeState.crc), sizeof(fastWakeState) - sizeof(fastWakeState.crc));
+}
+
+void _saveFastWakeState(){
+  memset(&fastWakeState, 0, sizeof(fastWakeState));
+  fastWakeState.magic = FAST_WAKE_MAGIC;
+  memcpy(fastWakeState.bssid, WiFi.BSSID(), sizeof(fastWakeState.bssid));
+  fastWakeState.channel = WiFi.channel();
+  fastWakeState.localIp = (uint32_t)WiFi.localIP();
+  fastWakeState.gatewayIp = (uint32_t)WiFi.gatewayIP();
+  fastWakeState.subnetMask = (uint32_t)WiFi.subnetMask();
+  fastWakeState.dnsIp = (uint32_t)WiFi.dnsIP();
+  strcpy(fastWakeState.mqttServer, config_mqtt_server);
+  strcpy(fastWakeState.mqttServerPort, config_mqtt_server_port);
+  strcpy(fastWakeState.mqttUser, config_mqtt_user);
+  strcpy(fastWakeState.mqttPswd, config_mqtt_pswd);
+  fastWakeState.crc = _fastWakeCrc();
+  ESP.rtcUserMemoryWrite(RTC_FAST_WAKE_ADDRESS, (uint32_t*)&fastWakeState, sizeof(fastWakeState));
+}
+
+void _invalidateFastWakeState(){
+  memset(&fastWakeState, 0, sizeof(fastWakeState));
+  ESP.rtcUserMemoryWrite(RTC_FAST_WAKE_ADDRESS, (uint32_t*)&fastWakeState, sizeof(fastWakeState));
+}
+
+boolean _fastWakeReconnect(){
+  if(ESP.getResetInfoPtr()->reason != REASON_DEEP_SLEEP_AWAKE) return false;
+  ESP.rtcUserMemoryRead(RTC_FAST_WAKE_ADDRESS, (uint32_t*)&fastWakeState, sizeof(fastWakeState));
+  if(fastWakeState.magic != FAST_WAKE_MAGIC || fastWakeState.crc != _fastWakeCrc()) return false;
+
+  WiFi.mode(WIFI_STA);
+  WiFi.config(IPAddress(fastWakeState.localIp), IPAddress(fastWakeState.gatewayIp),
+              IPAddress(fastWakeState.subnetMask), IPAddress(fastWakeState.dnsIp));
+  //SSID and Password are kept by the SDK in flash from the last WifiManager connect.
+  WiFi.begin(WiFi.SSID().c_str(), WiFi.psk().c_str(), fastWakeState.channel, fastWakeState.bssid, true);
+  unsigned long startMs = millis();
+  while(WiFi.status() != WL_CONNECTED){
+    if(millis() - startMs > FAST_WAKE_WIFI_TIMEOUT_MS){
+      HIVE_LOG_INFO("HIVEBOT", "Fast Wake failed, falling back to WifiManager.");
+      _invalidateFastWakeState();
+      WiFi.disconnect();
+      return false;
+    }
+    delay(10);
+  }
+  strcpy(config_mqtt_server, fastWakeState.mqttServer);
+  strcpy(config_mqtt_server_port, fastWakeState.mqttServerPort);
+  strcpy(config_mqtt_user, fastWakeState.mqttUser);
+  strcpy(config_mqtt_pswd, fastWakeState.mqttPswd);
+  return true;
+}
+
 void setupHiveConnector() {
+  if(_fastWakeReconnect()){
+    bootFastWake = true;
+    markBootPhase(BOOT_PHASE_WIFI_CONNECTED);
+    HIVE_LOG_INFO("HIVEBOT", "Fast Wake, Connected to Wifi. My IP: %s", WiFi.localIP().toString().c_str());
+    return;
+  }
+
   if (!SPIFFS.begin()) {
-    Serial.println("ERRO : [HIVEBOT] Unable to mount FS. ");
+    HIVE_LOG_ERROR("HIVEBOT", "Unable to mount FS.");
     return;
   }
 
 
-  loadConfigFromFile(); //Load any Previous Config.
+  boolean configLoaded = loadConfigFromFile(); //Load any Previous Config.
+  rememberLoadedConfig();
   
   WiFiManager wifiManager;
   wifiManager.setAPCallback(_configModeCallback);
@@ -76,10 +178,10 @@ void setupHiveConnector() {
   wifiManager.addParameter(&mqtt_pswdWiFiConfig);
   
    if (drd.detectDoubleReset()) {
-    Serial.println("INFO : [HIVEBOT] Hard Reset Detected. Forcing to ConfigMode: AP (Soft Access Point Mode)");
+    HIVE_LOG_INFO("HIVEBOT", "Hard Reset Detected. Forcing to ConfigMode: AP (Soft Access Point Mode)");
     wifiManager.startConfigPortal(bot_accessPointName, "");
    }else{
-    Serial.println("INFO : [HIVEBOT] AutoConnect [ AP (Soft Access Point Mode) _or_ ST (Station Mode as WifiClient) ]" );
+    HIVE_LOG_INFO("HIVEBOT", "AutoConnect [ AP (Soft Access Point Mode) _or_ ST (Station Mode as WifiClient) ]");
     wifiManager.autoConnect(bot_accessPointName, "");
    }
     //if(true) return;
@@ -88,16 +190,17 @@ void setupHiveConnector() {
    strcpy(config_mqtt_user, mqtt_userWiFiConfig.getValue());
    strcpy(config_mqtt_pswd, mqtt_pswdWiFiConfig.getValue());
 
-   //if (_shouldSaveConfigToFile) {  , Value not being set, callback not working. Skipping.
+   //if (_shouldSaveConfigToFile) {  , Value not being set, callback not working. Comparing instead.
+   if (!configLoaded || isConfigChangedSinceLoad()) {
     saveConfigToFile();
-  //}
+   }
   drd.stop();
+  markBootPhase(BOOT_PHASE_WIFI_CONNECTED);
+  if(WiFi.status() == WL_CONNECTED) _saveFastWakeState();
 
-  Serial.println("INFO : [HIVEBOT] Ready running ST (Station Mode as WifiClient) ]");
-  Serial.print  ("INFO : [HIVEBOT]    > Connected to Wifi: ");
-  Serial.println(WiFi.SSID() );
-  Serial.print  ("INFO : [HIVEBOT]    > My IP: ");
-  Serial.println(WiFi.localIP() );
+  HIVE_LOG_INFO("HIVEBOT", "Ready running ST (Station Mode as WifiClient) ]");
+  HIVE_LOG_INFO("HIVEBOT", "   > Connected to Wifi: %s", WiFi.SSID().c_str());
+  HIVE_LOG_INFO("HIVEBOT", "   > My IP: %s", WiFi.localIP().toString().c_str());
 }
 
 
@@ -105,7 +208,7 @@ void setupHiveConnector() {
 
 
 void forceHardResetToConfigMode() {
-  Serial.println("INFO : [HIVEBOT] HardReset Initiated, will start ConfigMode: AP (Soft Access Point Mode)");
+  HIVE_LOG_INFO("HIVEBOT", "HardReset Initiated, will start ConfigMode: AP (Soft Access Point Mode)");
   WiFi.disconnect();
   delay(500);
   ESP.restart();
@@ -115,51 +218,112 @@ void forceHardResetToConfigMode() {
 /* MQTT Connectivity Setup */
 
 
+//UTC unix seconds from here on are a wall time, the schedule of an instruction or NTP synced.
+#define SCHEDULE_CLOCK_VALID 1500000000UL
+
 /* Callback Methods , you can overide in client Implementation */
 void callbackMqttConnected();
 void callbackMqttNotConnected();
 void callbackUpdateFunctions(String enabledFunctions);
-void callbackInstructionRecieved(long instrId,String command, String params);
+void callbackUpdateSettings(JsonObject& settings);
+void callbackInstructionRecieved(long instrId,const char* command, const char* params);
+void callbackInstructionScheduled(long instrId,const char* command, const char* params, uint32_t dueAt);
+
 
+/*
+ * With HIVE_SHARED_TOPICS every bot shares the recieve topic, so find hiveBotId in the raw payload first
+ * and drop other bots' messages before building any json object tree.
+ * On the bot's own topics it only catches a message HiveCentral routed wrong.
+ */
+#define HIVE_DEBUG_PAYLOADS false
+boolean _isPayloadForThisBot(const byte* payload, unsigned int length){
+  static const char hiveBotIdKey[] = "\"hiveBotId\"";
+  const unsigned int keyLength = sizeof(hiveBotIdKey) - 1;
+  const char* botId = bot_id.c_str();
+  const unsigned int botIdLength = bot_id.length();
+  int depth = 0;
+  boolean inString = false;
+  for(unsigned int i=0; i < length; i++){
+    char c = (char)payload[i];
+    if(inString){
+      if(c == '\\') i++;            //skip escaped char
+      else if(c == '"') inString = false;
+      continue;
+    }
+    if(c == '{' || c == '[') depth++;
+    else if(c == '}' || c == ']') depth--;
+    else if(c == '"'){
+      //Only a top level key counts, not one nested in instructions or params.
+      if(depth == 1 && i + keyLength <= length && memcmp(payload + i, hiveBotIdKey, keyLength) == 0){
+        unsigned int pos = i + keyLength;
+        while(pos < length && (payload[pos] == ' ' || payload[pos] == ':' || payload[pos] == '\t')) pos++;
+        if(pos >= length || payload[pos] != '"') return false;
+        pos++;
+        return pos + botIdLength < length
+            && memcmp(payload + pos, botId, botIdLength) == 0
+            && payload[pos + botIdLength] == '"';
+      }
+      inString = true;
+    }
+  }
+  return false;
+}
 
+char hiveInboundMessage[MQTT_MAX_PACKET_SIZE];
+//Off the callback stack, instruction handlers run on top of the callback. Cleared per message.
+StaticJsonBuffer<1000> hiveInboundJson;
 void callbackMqttMessage(char* topic, byte* payload, unsigned int length) {
-  Serial.print("DEBUG: [MQTT] Message Recieved[  < < < ]:");
-  String strPayload = "";
-  for (int i=0;i<length;i++) {
-    char receivedChar = (char)payload[i];
-    strPayload +=receivedChar;
+  //Broadcast is for every bot, anything else must name this one.
+  boolean broadcast = HIVE_BROADCAST_TOPIC && strcmp(topic, mqtt_botcli_broadcast_topic) == 0;
+  if(!broadcast && !_isPayloadForThisBot(payload, length)){
+    return ;
+  }
+  unsigned long startUs = micros();
+  if(HIVE_DEBUG_PAYLOADS){
+    HIVE_LOG_DEBUG("MQTT", "Message Recieved[  < < < ]:%.*s", (int)length, (const char*)payload);
   }
-  Serial.println(strPayload);
-  StaticJsonBuffer<1000> JSONBuffer;   //Memory pool
-  JsonObject& parsed = JSONBuffer.parseObject(payload); //Parse message
+  // PubSubClient does not terminate the payload, and a message filling its packet buffer
+  // ends on the last byte, so it is terminated in a copy. Parsed in place there.
+  if(length >= sizeof(hiveInboundMessage)){
+    HIVE_LOG_ERROR("RECV", "Message too long, Ignoring. Bytes:%u", length);
+    return ;
+  }
+  memcpy(hiveInboundMessage, payload, length);
+  hiveInboundMessage[length] = '\0';
+  hiveInboundJson.clear();
+  JsonObject& parsed = hiveInboundJson.parseObject(hiveInboundMessage); //Parse message
   if (!parsed.success()) {   //Check for errors in parsing
-    Serial.println("ERROR: [RECV] JSON Parsing failed");
+    HIVE_LOG_ERROR("RECV", "JSON Parsing failed");
   }else{
-    const char* hiveBotId    = parsed["hiveBotId"];
-    if(String(hiveBotId) != bot_id){
-      Serial.println("INFO : [RECV] Ignoring, not a Message for me.");
-      return ;
-    }
     boolean dataTypeNotUnderstood = true;
     const char* dataType    = parsed["dataType"];
-    if (String(dataType) == "UpdateFunctions" || String(dataType) == "CatchupPostBootup") {
+    if(dataType == NULL) dataType = "";
+    if (strcmp(dataType,"UpdateFunctions")==0 || strcmp(dataType,"CatchupPostBootup")==0) {
       const char* enabledFunctions    = parsed["enabledFunctions"];
       callbackUpdateFunctions(String(enabledFunctions));
+      if(parsed.containsKey("settings")){
+        JsonObject& settings = parsed["settings"];
+        callbackUpdateSettings(settings);
+      }
       dataTypeNotUnderstood=false;
     }
     
-    if(String(dataType) == "ExecuteInstruction" || String(dataType) == "CatchupPostBootup"){
+    if(strcmp(dataType,"ExecuteInstruction")==0 || strcmp(dataType,"CatchupPostBootup")==0){
       JsonArray& instructions = parsed["instructions"];
       for(unsigned  int iCount=0;iCount<instructions.size();iCount++){
           JsonVariant instJsonVariant = instructions.get<JsonVariant>(iCount);
           JsonObject &instJsonO = instJsonVariant.as<JsonObject>();
           long instrId = instJsonO["instrId"];
           const char* command = instJsonO["command"];
-          const char* schedule = instJsonO["schedule"];
+          uint32_t schedule = instJsonO["schedule"].as<unsigned long>(); //UTC unix seconds, string or number
           const char* params = instJsonO["params"];
           const char* executenow = instJsonO["execute"];
-          if (strcasecmp(executenow,"true")==0) {
-            callbackInstructionRecieved(instrId,String(command),String(params));
+          if (executenow != NULL && command != NULL && strcasecmp(executenow,"true")==0) {
+            callbackInstructionRecieved(instrId,command,(params == NULL) ? "" : params);
+          }else if(command != NULL && schedule >= SCHEDULE_CLOCK_VALID){
+            //Wire change, see HiveSchedule. Below it is not a wall time and ignored as it always was.
+
+            callbackInstructionScheduled(instrId,command,(params == NULL) ? "" : params, schedule);
           }
       } 
       dataTypeNotUnderstood=false;
@@ -168,17 +332,34 @@ void callbackMqttMessage(char* topic, byte* payload, unsigned int length) {
       const char* enabledFunctions    = parsed["enabledFunctions"];
       callbackUpdateFunctions(String(enabledFunctions));*/
     if(dataTypeNotUnderstood) {
-      Serial.print("ERROR: [RECV] Unknown DataType Ignoring.");
-      Serial.println(dataType);
+      HIVE_LOG_ERROR("RECV", "Unknown DataType Ignoring.%s", dataType);
     }
   }
-  
-
+  latencyRecord(LATENCY_MQTT_CALLBACK, micros() - startUs);
 }
 WiFiClient wifiClient;
 PubSubClient client(config_mqtt_server, mqtt_server_port, callbackMqttMessage, wifiClient);
 boolean mqttConnected =false;
-EventTimer mqttReconnectOnFailTimer("MQTTReconnect#",1000 * 2, true, false); //every x seconds
+EventTimer mqttReconnectOnFailTimer("MQTTReconnect#",1000 * 2, true, true); //every x seconds, first attempt right away
+//<topic>/<bot_id>, or the shared topic itself with HIVE_SHARED_TOPICS.
+#define HIVE_TOPIC_MAX 96
+void _hiveBotTopic(char* topic, const char* sharedTopic){
+  if(HIVE_SHARED_TOPICS) snprintf(topic, HIVE_TOPIC_MAX, "%s", sharedTopic);
+  else snprintf(topic, HIVE_TOPIC_MAX, "%s/%s", sharedTopic, bot_id.c_str());
+}
+void _subscribeHiveTopics(){
+  char topic[HIVE_TOPIC_MAX];
+  _hiveBotTopic(topic, mqtt_botcli_recieve_topic);
+  HIVE_LOG_DEBUG("MQTT", "Subscribing to : %s", topic);
+  client.subscribe(topic,mqtt_subscribe_qos);
+  _hiveBotTopic(topic, mqtt_botcli_recieve_retained_will_topic);
+  HIVE_LOG_DEBUG("MQTT", "Subscribing to : %s", topic);
+  client.subscribe(topic);
+  if(HIVE_BROADCAST_TOPIC){
+    HIVE_LOG_DEBUG("MQTT", "Subscribing to : %s", mqtt_botcli_broadcast_topic);
+    client.subscribe(mqtt_botcli_broadcast_topic,mqtt_subscribe_qos);
+  }
+}
 boolean _isMQTTConnected(){
   mqttConnected = client.connected();
   if(mqttConnected){
@@ -188,35 +369,30 @@ boolean _isMQTTConnected(){
   if(!mqttReconnectOnFailTimer.isDueForRun()) 
     return false;
 
-  Serial.print("DEBUG: [MQTT] settings:[");
-  Serial.print(config_mqtt_server);Serial.print(", ");
-  Serial.print(config_mqtt_user);Serial.print(", ");
-  Serial.print(config_mqtt_pswd);Serial.print(", ");
-  Serial.println("] ");
+  HIVE_LOG_DEBUG("MQTT", "settings:[%s, %s, ****]", config_mqtt_server, config_mqtt_user);
   
+  EnergyPhase previousPhase = energyEnterPhase(ENERGY_MQTT);
   if (client.connect(mqtt_microclima_id,config_mqtt_user,config_mqtt_pswd)) {
-    Serial.println("DEBUG: [MQTT] Connected to Broker"); 
-    Serial.print("DEBUG: [MQTT] Subscribing to : ");
-    Serial.println(mqtt_botcli_recieve_topic);
-    Serial.print("DEBUG: [MQTT] Subscribing to : ");
-    Serial.println(mqtt_botcli_recieve_retained_will_topic);
-    client.subscribe(mqtt_botcli_recieve_topic,mqtt_subscribe_qos);
-    client.subscribe(mqtt_botcli_recieve_retained_will_topic);
+    HIVE_LOG_DEBUG("MQTT", "Connected to Broker");
+    _subscribeHiveTopics();
     mqttConnected = client.connected();
+    energyEnterPhase(previousPhase);
     if(mqttConnected){
-      Serial.println("DEBUG: [MQTT] Connected.");
+      HIVE_LOG_DEBUG("MQTT", "Connected.");
+      markBootPhase(BOOT_PHASE_MQTT_CONNECTED);
       callbackMqttConnected(); 
     }else{
-      Serial.println("DEBUG: [MQTT] Connection Failure.");
+      HIVE_LOG_DEBUG("MQTT", "Connection Failure.");
     }
   }
   else {
-    Serial.println("DEBUG: [MQTT] Broker Connection Failed. (username, password)");
+    energyEnterPhase(previousPhase);
+    HIVE_LOG_DEBUG("MQTT", "Broker Connection Failed. (username, password)");
     callbackMqttNotConnected();
     mqttConnected=false;
     //abort();
   }
-
+  return mqttConnected;
 }
 
 boolean isHiveConnected(){
@@ -224,6 +400,12 @@ boolean isHiveConnected(){
   return true;
 }
 
+//Time until the next reconnect attempt, what an offline loop can idle for.
+unsigned long msUntilHiveReconnect(){
+  if(mqttConnected) return 0;
+  return mqttReconnectOnFailTimer.msUntilDue();
+}
+
 void loopHiveConnector(){
   if(!isHiveConnected()) return ;
   client.loop();
@@ -233,7 +415,7 @@ void disconnectFromHive(){
   if(isHiveConnected()){
     client.disconnect();
     mqttReconnectOnFailTimer.enabled(false);
-    Serial.println("DEBUG: [MQTT] Disconnected from Broker and turning off AutoReconnect");
+    HIVE_LOG_DEBUG("MQTT", "Disconnected from Broker and turning off AutoReconnect");
   }
 }
 
@@ -242,52 +424,172 @@ const static int DATATYPE_BOOTUP_NOTIFY=2;
 const static int DATATYPE_SENSOR_DATA=200;
 const static int DATATYPE_INSTRUCTION_COMPLETED=201;
 const static int DATATYPE_INSTRUCTION_EXEFAILED=501;
-//SensorData
-boolean publishToHive(int dataTypeFor, String messageSetJson){
-  
-  if(!isHiveConnected()) return false;
-  else {
-    
-    String requestPayload = "{";
-    if(dataTypeFor == DATATYPE_SENSOR_DATA){
-      requestPayload += "\"dataType\": \"SensorData\"";
-      requestPayload += ",\"dataMap\": {";
-      requestPayload += messageSetJson;
-      requestPayload += "}";
-    }else if(dataTypeFor == DATATYPE_INSTRUCTION_COMPLETED){
-      requestPayload += "\"dataType\": \"InstructionCompleted\"";
-      requestPayload += ",\"instructions\": [";
-      requestPayload += messageSetJson;
-      requestPayload += "]";
-    }else if(dataTypeFor == DATATYPE_INSTRUCTION_EXEFAILED){
-      requestPayload += "\"dataType\": \"InstructionFailed\"";
-      requestPayload += ",\"instructions\": [";
-      requestPayload += messageSetJson;
-      requestPayload += "]";
-    }else if(dataTypeFor == DATATYPE_BOOTUP_NOTIFY){
-      requestPayload += "\"dataType\": \"BootupHivebot\"";
-    }else {
-      requestPayload += "\"dataType\": \"HeartBeat\"";
-    }
-    requestPayload += ",\"hiveBotId\": \"";
-    requestPayload += bot_id;
-    requestPayload += "\",\"accessKey\": \"";
-    requestPayload += hive_accesskey;
-    requestPayload += "\"";
-    requestPayload += "}";
+/*
+ * Outgoing payloads are streamed into one static buffer, sized to what PubSubClient can send.
+ *   HivePayloadWriter& dataMap = beginHivePayload(DATATYPE_SENSOR_DATA);
+ *   dataMap.addFixed(HF_Temperature, 23.4, 2);
+ *   publishHivePayload();
+ */
+#define HIVE_PAYLOAD_BUFFER_SIZE 512
+char hivePayloadBuffer[HIVE_PAYLOAD_BUFFER_SIZE];
+HivePayloadWriter hivePayload(hivePayloadBuffer, HIVE_PAYLOAD_BUFFER_SIZE);
+int _hivePayloadDataType = DATATYPE_NOTHING_SPECIAL_BUT_LET_THEM_KNOW_I_AM_ALIVE;
+unsigned long hiveLastPublishAtMs = 0; //Any payload reaching the broker, lets a HeartBeat be skipped.
 
-    
-    if(client.publish(mqtt_controller_notify_topic,(char*) requestPayload.c_str())){
-    //if(client.publish("AAAA",)){
-      Serial.print("DEBUG: [MQTT] Message Published[ > > > ]:");
-      Serial.println(requestPayload);
-    }else{
-      Serial.println("DEBUG: [MQTT] Error Publishing Message");
-    }
+/*
+ * Encoding is negotiated, the bot lists what it can send in BootupHivebot ("encodings")
+ * and HiveCentral switches it to MSGPACK with the MSGPACK function in UpdateFunctions.
+ * MSGPACK payloads go to their own topic, HiveCentral decodes field ids with the HIVE_PAYLOAD_FIELDS order.
+ */
+#define HIVE_PAYLOAD_ENCODINGS "JSON,MSGPACK"
+void setHivePayloadBinary(boolean binary){
+  if(binary != hivePayload.isBinary()){
+    HIVE_LOG_INFO("MQTT", "Payload encoding:%s", binary ? "MSGPACK" : "JSON");
+  }
+  hivePayload.setBinary(binary);
+}
+//Queued payloads keep the encoding they were written in, a JSON envelope always starts with '{'.
+const char* _hivePayloadTopic(const char* payload){
+  return payload[0] == '{' ? mqtt_controller_notify_topic : mqtt_controller_notify_msgpack_topic;
+}
+
+//Opens the envelope, returns the writer positioned inside dataMap or the instruction entry.
+HivePayloadWriter& beginHivePayload(int dataTypeFor){
+  _hivePayloadDataType = dataTypeFor;
+  hivePayload.reset();
+  hivePayload.beginObject();
+  if(dataTypeFor == DATATYPE_SENSOR_DATA){
+    hivePayload.addSymbol(HF_DataType, dataTypeFor, "SensorData");
+    hivePayload.beginObject(HF_DataMap);
+  }else if(dataTypeFor == DATATYPE_INSTRUCTION_COMPLETED){
+    hivePayload.addSymbol(HF_DataType, dataTypeFor, "InstructionCompleted");
+    hivePayload.beginArray(HF_Instructions);
+    hivePayload.beginObject();
+  }else if(dataTypeFor == DATATYPE_INSTRUCTION_EXEFAILED){
+    hivePayload.addSymbol(HF_DataType, dataTypeFor, "InstructionFailed");
+    hivePayload.beginArray(HF_Instructions);
+    hivePayload.beginObject();
+  }else if(dataTypeFor == DATATYPE_BOOTUP_NOTIFY){
+    hivePayload.addSymbol(HF_DataType, dataTypeFor, "BootupHivebot");
+    hivePayload.beginObject(HF_DataMap);
+    hivePayload.addString(HF_BootMode, bootFastWake ? "FAST" : "FULL");
+    hivePayload.addLong(HF_BootWifiMs, bootPhaseAtMs[BOOT_PHASE_WIFI_CONNECTED]);
+    hivePayload.addLong(HF_BootMqttMs, bootPhaseAtMs[BOOT_PHASE_MQTT_CONNECTED]);
+    hivePayload.addString(HF_Encodings, HIVE_PAYLOAD_ENCODINGS);
+    writeEnergyDataMap(hivePayload);
+  }else {
+    hivePayload.addSymbol(HF_DataType, dataTypeFor, "HeartBeat");
+    hivePayload.beginObject(HF_DataMap);
+    writeEnergyDataMap(hivePayload);
   }
+  return hivePayload;
 }
 
+/*
+ * Every payload carries a sequence number so HiveCentral can spot gaps.
+ * Kept in RTC memory, so it keeps counting across DeepSleep.
+ */
+uint32_t _publishSeq[2]; //seq, ~seq as check
+boolean _publishSeqLoaded = false;
+uint32_t _nextPublishSeq(){
+  if(!_publishSeqLoaded){
+    ESP.rtcUserMemoryRead(RTC_PUBLISH_SEQ_ADDRESS, _publishSeq, sizeof(_publishSeq));
+    if(_publishSeq[1] != ~_publishSeq[0]) _publishSeq[0] = 0;
+    _publishSeqLoaded = true;
+  }
+  return _publishSeq[0] + 1;
+}
+//Only once the payload is published or queued, a dropped payload leaves no gap.
+void _takePublishSeq(){
+  _publishSeq[0]++;
+  _publishSeq[1] = ~_publishSeq[0];
+  ESP.rtcUserMemoryWrite(RTC_PUBLISH_SEQ_ADDRESS, _publishSeq, sizeof(_publishSeq));
+}
 
+//Bytes left for dataMap content, keeping room for the envelope tail and the MQTT packet header.
+size_t hivePayloadRoom(){
+  size_t limit = MQTT_MAX_PACKET_SIZE - 5 - 2 - strlen(_hivePayloadTopic(hivePayload.c_str()));
+  if(limit > HIVE_PAYLOAD_BUFFER_SIZE - 1) limit = HIVE_PAYLOAD_BUFFER_SIZE - 1;
+  size_t used = hivePayload.length() + 48 + bot_id.length() + hive_accesskey.length();
+  return used < limit ? limit - used : 0;
+}
 
+//Closes the envelope and publishes it. Queued to flash when the broker is not reachable.
+boolean publishHivePayload(){
+  if(_hivePayloadDataType == DATATYPE_INSTRUCTION_COMPLETED 
+        || _hivePayloadDataType == DATATYPE_INSTRUCTION_EXEFAILED){
+    hivePayload.endObject();
+    hivePayload.endArray();
+  }else{
+    hivePayload.endObject(); //dataMap
+  }
+  hivePayload.addLong(HF_Seq, _nextPublishSeq());
+  hivePayload.addString(HF_HiveBotId, bot_id.c_str());
+  hivePayload.addString(HF_AccessKey, hive_accesskey.c_str());
+  hivePayload.endObject();
+
+  // MQTT fixed header(5) + topic length(2) + topic, must fit in one PubSubClient packet.
+  const char* topic = _hivePayloadTopic(hivePayload.c_str());
+  size_t packetLength = 5 + 2 + strlen(topic) + hivePayload.length();
+  if(hivePayload.overflowed() || packetLength > MQTT_MAX_PACKET_SIZE){
+    HIVE_LOG_ERROR("MQTT", "Payload exceeds packet limit, not Published. Bytes:%u", (unsigned)packetLength);
+    return false;
+  }
+  //A HeartBeat is only worth sending live.
+  boolean queueIfNotPublished = _hivePayloadDataType != DATATYPE_NOTHING_SPECIAL_BUT_LET_THEM_KNOW_I_AM_ALIVE;
+  //Keep order, nothing goes live while older payloads are still queued.
+  //No reconnect from here, callbackMqttConnected() would write its BootupHivebot over this payload.
+  boolean published = false;
+  if(client.connected() && !isPublishQueuePending()){
+    EnergyPhase previousPhase = energyEnterPhase(ENERGY_PUBLISH);
+    unsigned long startUs = micros();
+    published = client.publish(topic, (const uint8_t*)hivePayload.c_str(), hivePayload.length());
+    latencyRecord(LATENCY_PUBLISH, micros() - startUs);
+    energyEnterPhase(previousPhase);
+  }
+  if(published){
+    _takePublishSeq();
+    markBootPhase(BOOT_PHASE_FIRST_PUBLISH);
+    hiveLastPublishAtMs = millis();
+    if(HIVE_DEBUG_PAYLOADS && !hivePayload.isBinary()){
+      HIVE_LOG_DEBUG("MQTT", "Message Published[ > > > ]:%s", hivePayload.c_str());
+    }else{
+      HIVE_LOG_DEBUG("MQTT", "Message Published[ > > > ] Bytes:%u", (unsigned)hivePayload.length());
+    }
+    return true;
+  }
+  if(queueIfNotPublished && publishQueueAppend(hivePayload.c_str(), hivePayload.length())){
+    _takePublishSeq();
+    HIVE_LOG_DEBUG("MQTT", "Not Published, Queued for later.");
+  }else{
+    HIVE_LOG_DEBUG("MQTT", "Error Publishing Message");
+  }
+  return false;
+}
 
+/*
+ * Drains queued payloads at a controlled rate once connected, run by the scheduler.
+ */
+#define PUBLISH_QUEUE_DRAIN_PER_RUN 2
+EventTimer publishQueueDrainTimer("PublishQueue#", 1000 * 1, true, true);
+boolean _publishQueuedPayload(const char* payload, unsigned int length){
+  EnergyPhase previousPhase = energyEnterPhase(ENERGY_PUBLISH);
+  unsigned long startUs = micros();
+  boolean published = client.publish(_hivePayloadTopic(payload), (const uint8_t*)payload, length);
+  latencyRecord(LATENCY_PUBLISH, micros() - startUs);
+  energyEnterPhase(previousPhase);
+  if(published) hiveLastPublishAtMs = millis();
+  return published;
+}
+void drainPublishQueue(){
+  int sent = publishQueueDrain(hivePayloadBuffer, HIVE_PAYLOAD_BUFFER_SIZE, _publishQueuedPayload, PUBLISH_QUEUE_DRAIN_PER_RUN);
+  if(sent > 0){
+    HIVE_LOG_DEBUG("QUEUE", "Published %d queued payloads.", sent);
+  }
+}
 
+//No data of its own, HeartBeat and BootupHivebot.
+boolean publishToHive(int dataTypeFor){
+  beginHivePayload(dataTypeFor);
+  return publishHivePayload();
+}
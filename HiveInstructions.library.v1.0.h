@@ -0,0 +1,219 @@
+/*
+ * HiveInstructions, Registry of Instruction handlers.
+ * Handlers are registered against a compile-time hash of the command, so a lookup is one
+ * hash of the incoming command and a probe, no matter how many commands are registered.
+ * Every handler returns a result code and the ack back to HiveCentral is built in one place.
+ *
+ *   int instructionLedDance(long instrId, const char* params){ doLEDDance(); return INSTRUCTION_OK; }
+ *   REGISTER_INSTRUCTION("LEDDANCE", instructionLedDance);
+ */
+
+#define INSTRUCTION_OK              0 //Ack InstructionCompleted
+#define INSTRUCTION_FAILED          1 //Ack InstructionFailed
+#define INSTRUCTION_OK_THEN_REBOOT  2 //Ack InstructionCompleted, caller reboots after.
+#define INSTRUCTION_UNKNOWN         3 //No handler, nothing reported.
+
+#define INSTRUCTION_REGISTRY_SIZE 32 //Power of two, keep at least twice the registered commands.
+
+typedef int (*InstructionHandler)(long instrId, const char* params);
+
+// FNV-1a, constexpr so the key of a command literal is folded at compile time.
+constexpr uint32_t hiveCommandHash(const char* command, uint32_t hash = 2166136261UL){
+  return *command == '\0' ? hash
+    : hiveCommandHash(command + 1, (uint32_t)((hash ^ (uint8_t)*command) * 16777619UL));
+}
+template<uint32_t commandHash> struct HiveCommandKey { static const uint32_t value = commandHash; };
+#define REGISTER_INSTRUCTION(command, handler) \
+  registerInstruction(HiveCommandKey<hiveCommandHash(command)>::value, command, handler)
+
+struct InstructionEntry {
+  uint32_t commandHash;
+  const char* command;
+  InstructionHandler handler;
+};
+InstructionEntry _instructionRegistry[INSTRUCTION_REGISTRY_SIZE];
+int _instructionRegistryCount = 0;
+
+boolean registerInstruction(uint32_t commandHash, const char* command, InstructionHandler handler){
+  if(_instructionRegistryCount >= INSTRUCTION_REGISTRY_SIZE / 2){
+    HIVE_LOG_ERROR("INSTR", "Registry full, not registered:%s", command);
+    return false;
+  }
+  //Open addressing, linear probe.
+  uint32_t slot = commandHash & (INSTRUCTION_REGISTRY_SIZE - 1);
+  while(_instructionRegistry[slot].handler != NULL){
+    slot = (slot + 1) & (INSTRUCTION_REGISTRY_SIZE - 1);
+  }
+  _instructionRegistry[slot].commandHash = commandHash;
+  _instructionRegistry[slot].command = command;
+  _instructionRegistry[slot].handler = handler;
+  _instructionRegistryCount++;
+  return true;
+}
+
+InstructionHandler findInstructionHandler(const char* command){
+  uint32_t commandHash = hiveCommandHash(command);
+  uint32_t slot = commandHash & (INSTRUCTION_REGISTRY_SIZE - 1);
+  while(_instructionRegistry[slot].handler != NULL){
+    if(_instructionRegistry[slot].commandHash == commandHash
+        && strcmp(_instructionRegistry[slot].command, command) == 0){
+      return _instructionRegistry[slot].handler;
+    }
+    slot = (slot + 1) & (INSTRUCTION_REGISTRY_SIZE - 1);
+  }
+  return NULL;
+}
+
+/*
+ * Instruction params are "key=value,key=value", e.g. "id=4,temp=22,mode=COOL".
+ * Returns the value of key, pointing into params and ending at ',' or the end. NULL when missing.
+ */
+const char* findInstructionParam(const char* params, const char* key){
+  size_t keyLength = strlen(key);
+  const char* at = params;
+  while(at != NULL && *at != '\0'){
+    if(strncmp(at, key, keyLength) == 0 && at[keyLength] == '=') return at + keyLength + 1;
+    at = strchr(at, ',');
+    if(at != NULL) at++;
+  }
+  return NULL;
+}
+long instructionParamLong(const char* params, const char* key, long defaultValue){
+  const char* value = findInstructionParam(params, key);
+  return value == NULL ? defaultValue : strtol(value, NULL, 10);
+}
+
+/*
+ * Executed Instruction Cache, the last instrIds run on this bot.
+ * CatchupPostBootup replays pending instructions on every connect, an instrId found here is
+ * acked again without running the handler (no second IR blast, no LED dance, no reboot loop).
+ * Kept in RTC memory for DeepSleep, with a copy on SPIFFS for power loss. Oldest is evicted.
+ * RTC memory is written on every instruction, flash only by flushInstructionCache(): from loop()
+ * once the oldest unsaved instrId is INSTRUCTION_CACHE_FLUSH_MS old, so a CatchupPostBootup
+ * burst is one write, and before every DeepSleep or REBOOT. Power lost inside that window runs
+ * the instructions since the last flush again on their replay.
+ */
+#define INSTRUCTION_CACHE_SIZE  16
+#define INSTRUCTION_CACHE_FILE  "/instrcache"
+#ifndef INSTRUCTION_CACHE_FLUSH_MS
+#define INSTRUCTION_CACHE_FLUSH_MS (60 * 1000UL)
+#endif
+#define INSTRUCTION_CACHE_MAGIC 0x48494331UL // "HIC1"
+
+struct InstructionCache {
+  uint32_t crc;         //Over everything after this field
+  uint32_t magic;
+  uint8_t head;         //Next slot to write
+  uint8_t count;
+  uint8_t reserved[2];
+  int32_t instrIds[INSTRUCTION_CACHE_SIZE];
+};
+static_assert(sizeof(InstructionCache) % 4 == 0, "RTC memory is read and written in 4 byte blocks");
+
+InstructionCache instructionCache;
+boolean _instructionCacheLoaded = false;
+boolean _instructionCacheDirty = false;      //Flash copy behind RTC memory
+unsigned long _instructionCacheDirtyAtMs = 0;
+
+uint32_t _instructionCacheCrc(){
+  return hiveCrc32((const uint8_t*)&instructionCache + sizeof(instructionCache.crc), sizeof(instructionCache) - sizeof(instructionCache.crc));
+}
+
+boolean _isInstructionCacheValid(){
+  return instructionCache.magic == INSTRUCTION_CACHE_MAGIC && instructionCache.crc == _instructionCacheCrc()
+      && instructionCache.head < INSTRUCTION_CACHE_SIZE && instructionCache.count <= INSTRUCTION_CACHE_SIZE;
+}
+
+//RTC memory first, flash when it was lost (power on), empty when neither is valid.
+void _loadInstructionCache(){
+  if(_instructionCacheLoaded) return;
+  _instructionCacheLoaded = true;
+  ESP.rtcUserMemoryRead(RTC_INSTRUCTION_CACHE_ADDRESS, (uint32_t*)&instructionCache, sizeof(instructionCache));
+  if(_isInstructionCacheValid()) return;
+  if(SPIFFS.begin()){
+    File cacheFile = SPIFFS.open(INSTRUCTION_CACHE_FILE, "r");
+    if(cacheFile){
+      cacheFile.read((uint8_t*)&instructionCache, sizeof(instructionCache));
+      cacheFile.close();
+      if(_isInstructionCacheValid()){
+        HIVE_LOG_DEBUG("INSTR", "Executed instructions restored from flash:%d", instructionCache.count);
+        return;
+      }
+    }
+  }
+  memset(&instructionCache, 0, sizeof(instructionCache));
+  instructionCache.magic = INSTRUCTION_CACHE_MAGIC;
+}
+
+boolean isInstructionExecuted(long instrId){
+  _loadInstructionCache();
+  for(int i=0;i<instructionCache.count;i++){
+    if(instructionCache.instrIds[i] == instrId) return true;
+  }
+  return false;
+}
+
+void markInstructionExecuted(long instrId){
+  if(instrId <= 0) return; //No instrId in the message, nothing to match a replay on.
+  _loadInstructionCache();
+  instructionCache.instrIds[instructionCache.head] = instrId;
+  instructionCache.head = (instructionCache.head + 1) % INSTRUCTION_CACHE_SIZE;
+  if(instructionCache.count < INSTRUCTION_CACHE_SIZE) instructionCache.count++;
+  instructionCache.crc = _instructionCacheCrc();
+  ESP.rtcUserMemoryWrite(RTC_INSTRUCTION_CACHE_ADDRESS, (uint32_t*)&instructionCache, sizeof(instructionCache));
+  if(!_instructionCacheDirty) _instructionCacheDirtyAtMs = millis();
+  _instructionCacheDirty = true;
+}
+
+//Saves the flash copy when it is behind, call right before ESP.deepSleep().
+void flushInstructionCache(){
+  if(!_instructionCacheDirty) return;
+  _instructionCacheDirty = false;
+  File cacheFile;
+  if(SPIFFS.begin()) cacheFile = SPIFFS.open(INSTRUCTION_CACHE_FILE, "w");
+  if(!cacheFile){
+    HIVE_LOG_ERROR("INSTR", "Unable to save executed instructions.");
+    return;
+  }
+  cacheFile.write((const uint8_t*)&instructionCache, sizeof(instructionCache));
+  cacheFile.close();
+}
+
+void pollInstructionCache(){
+  if(_instructionCacheDirty && millis() - _instructionCacheDirtyAtMs >= INSTRUCTION_CACHE_FLUSH_MS) flushInstructionCache();
+}
+
+void publishInstructionResult(int dataTypeFor, long instrId, const char* command){
+  HivePayloadWriter& instruction = beginHivePayload(dataTypeFor);
+  instruction.addLong(HF_InstrId, instrId);
+  instruction.addString(HF_Command, command);
+  publishHivePayload();
+}
+
+//A replay of an executed instrId is acked again, true when it was. Nothing may run for it.
+boolean ackIfInstructionExecuted(long instrId, const char* command){
+  if(instrId <= 0 || !isInstructionExecuted(instrId)) return false;
+  HIVE_LOG_DEBUG("INSTR", "Already executed %s. InstructionId:%ld, acked only.", command, instrId);
+  publishInstructionResult(DATATYPE_INSTRUCTION_COMPLETED, instrId, command);
+  return true;
+}
+
+//Runs the handler and reports the result to HiveCentral.
+int dispatchInstruction(long instrId, const char* command, const char* params){
+  InstructionHandler handler = findInstructionHandler(command);
+  if(handler == NULL){
+    HIVE_LOG_DEBUG("UNKINSR", "Unknown Instruction no action taken:%ld %s", instrId, command);
+    return INSTRUCTION_UNKNOWN;
+  }
+  if(ackIfInstructionExecuted(instrId, command)) return INSTRUCTION_OK;
+  HIVE_LOG_DEBUG("INSTR", "Executing %s. InstructionId:%ld", command, instrId);
+
+  int result = handler(instrId, params);
+  if(result == INSTRUCTION_FAILED){
+    publishInstructionResult(DATATYPE_INSTRUCTION_EXEFAILED, instrId, command);
+  }else{
+    markInstructionExecuted(instrId); //Before a REBOOT goes through.
+    publishInstructionResult(DATATYPE_INSTRUCTION_COMPLETED, instrId, command);
+  }
+  return result;
+}
@@ -0,0 +1,94 @@
+/*
+ * HiveLatency, fixed memory latency histograms for the paths that can stall the MQTT keepalive.
+ *   unsigned long startUs = micros();
+ *   ...client.publish()...
+ *   latencyRecord(LATENCY_PUBLISH, micros() - startUs);
+ *
+ * Log-linear buckets: exact below 4us, then 4 buckets per power of two, so a bucket is
+ * never more than 25% wide. Recording is a count leading zeros and one increment.
+ * Anything from 2^26us (67s) up lands in the last bucket, the max is kept exactly.
+ * When a bucket is about to overflow the whole histogram is halved, percentiles still hold.
+ * Reported on request (LATENCY instruction) as p50/p99/max and reset after.
+ */
+
+#define LATENCY_SUB_BUCKET_BITS 2  //4 buckets per power of two
+#define LATENCY_MAX_BITS        26 //Up to 2^26us, 67s
+#define LATENCY_BUCKETS         ((LATENCY_MAX_BITS - LATENCY_SUB_BUCKET_BITS + 1) << LATENCY_SUB_BUCKET_BITS)
+#define LATENCY_ENTRY_BYTES     96 //Worst case of writeLatencyEntry() in JSON
+
+enum LatencyPath {
+  LATENCY_LOOP,          //One loop() pass, without the scheduler idle
+  LATENCY_MQTT_CALLBACK, //callbackMqttMessage() for this bot
+  LATENCY_INSTRUCTION,   //callbackInstructionRecieved(), handler and ack
+  LATENCY_PUBLISH,       //client.publish(), live and queued
+  LATENCY_PATH_COUNT
+};
+static const HiveField latencyPathFields[LATENCY_PATH_COUNT] = {
+  HF_LatencyLoop, HF_LatencyMqttCallback, HF_LatencyInstruction, HF_LatencyPublish
+};
+
+struct LatencyHistogram {
+  uint16_t buckets[LATENCY_BUCKETS];
+  uint32_t count;   //Recorded since reset, not halved
+  uint32_t maxUs;
+};
+LatencyHistogram latencyHistograms[LATENCY_PATH_COUNT];
+
+uint8_t _latencyBucket(uint32_t us){
+  if(us < (1UL << LATENCY_SUB_BUCKET_BITS)) return us;
+  if(us >= (1UL << LATENCY_MAX_BITS)) return LATENCY_BUCKETS - 1;
+  uint8_t msb = 31 - __builtin_clz(us);
+  uint8_t shift = msb - LATENCY_SUB_BUCKET_BITS;
+  return ((shift + 1) << LATENCY_SUB_BUCKET_BITS) + ((us >> shift) & ((1 << LATENCY_SUB_BUCKET_BITS) - 1));
+}
+
+//Largest value that lands in the bucket.
+uint32_t _latencyBucketUpperUs(uint8_t bucket){
+  if(bucket < (1 << LATENCY_SUB_BUCKET_BITS)) return bucket;
+  uint8_t shift = (bucket >> LATENCY_SUB_BUCKET_BITS) - 1;
+  uint32_t lower = (uint32_t)((1 << LATENCY_SUB_BUCKET_BITS) + (bucket & ((1 << LATENCY_SUB_BUCKET_BITS) - 1))) << shift;
+  return lower + (1UL << shift) - 1;
+}
+
+void latencyRecord(LatencyPath path, uint32_t us){
+  LatencyHistogram& histogram = latencyHistograms[path];
+  uint8_t bucket = _latencyBucket(us);
+  if(histogram.buckets[bucket] == UINT16_MAX){
+    for(int i=0;i<LATENCY_BUCKETS;i++) histogram.buckets[i] /= 2;
+  }
+  histogram.buckets[bucket]++;
+  histogram.count++;
+  if(us > histogram.maxUs) histogram.maxUs = us;
+}
+
+//Upper bound of the bucket holding the percentile, never above the max seen.
+uint32_t latencyPercentileUs(LatencyPath path, uint8_t percentile){
+  LatencyHistogram& histogram = latencyHistograms[path];
+  uint32_t total = 0;
+  for(int i=0;i<LATENCY_BUCKETS;i++) total += histogram.buckets[i];
+  if(total == 0) return 0;
+  uint32_t rank = (total * percentile + 99) / 100;
+  uint32_t seen = 0;
+  for(int i=0;i<LATENCY_BUCKETS;i++){
+    seen += histogram.buckets[i];
+    if(seen >= rank){
+      uint32_t upperUs = _latencyBucketUpperUs(i);
+      return upperUs < histogram.maxUs ? upperUs : histogram.maxUs;
+    }
+  }
+  return histogram.maxUs;
+}
+
+void resetLatencyHistograms(){
+  memset(latencyHistograms, 0, sizeof(latencyHistograms));
+}
+
+//Adds "loop":{"n":..,"p50Us":..,"p99Us":..,"maxUs":..}, one entry of the "latency" object.
+void writeLatencyEntry(HivePayloadWriter& latency, LatencyPath path){
+  latency.beginObject(latencyPathFields[path]);
+  latency.addLong(HF_LatencyCount, latencyHistograms[path].count);
+  latency.addLong(HF_LatencyP50Us, latencyPercentileUs(path, 50));
+  latency.addLong(HF_LatencyP99Us, latencyPercentileUs(path, 99));
+  latency.addLong(HF_LatencyMaxUs, latencyHistograms[path].maxUs);
+  latency.endObject();
+}
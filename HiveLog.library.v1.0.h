@@ -0,0 +1,144 @@
+/*
+ * HiveLog, leveled logging into a ring buffer that is drained to the UART when it has room.
+ *   HIVE_LOG_DEBUG("MQTT", "Connecting to %s", server);  ->  "DEBUG: [MQTT] Connecting to ..."
+ * Levels above HIVE_LOG_LEVEL compile to nothing, arguments are not even evaluated.
+ *
+ * A call only formats the line into the ring, drainHiveLog() hands it to Serial without ever
+ * waiting on the UART. Single producer / single consumer on free running counters, no locks.
+ * Do not log from an interrupt handler. When the UART falls behind, new lines are dropped
+ * and counted, the ring also keeps the recent history for the LOGTAIL instruction.
+ * Boot (setup()) logs synchronously, nothing gets lost if it never reaches the scheduler.
+ */
+#include <stdarg.h>
+
+#define HIVE_LOG_LEVEL_NONE   0
+#define HIVE_LOG_LEVEL_ERROR  1
+#define HIVE_LOG_LEVEL_WARN   2
+#define HIVE_LOG_LEVEL_INFO   3
+#define HIVE_LOG_LEVEL_DEBUG  4
+#ifndef HIVE_LOG_LEVEL
+#define HIVE_LOG_LEVEL HIVE_LOG_LEVEL_DEBUG
+#endif
+
+#define HIVE_LOG_BUFFER_SIZE 2048 //Power of two
+#define HIVE_LOG_LINE_MAX    160  //Longer lines are cut and end with ".."
+#define HIVE_LOG_DRAIN_IDLE_MS 10 //Scheduler idle while lines are waiting for the UART
+
+#define _HIVE_LOG_NOTHING do {} while(0)
+#if HIVE_LOG_LEVEL >= HIVE_LOG_LEVEL_ERROR
+#define HIVE_LOG_ERROR(tag, format, ...) hiveLogWrite("ERROR:", tag, format, ##__VA_ARGS__)
+#else
+#define HIVE_LOG_ERROR(tag, format, ...) _HIVE_LOG_NOTHING
+#endif
+#if HIVE_LOG_LEVEL >= HIVE_LOG_LEVEL_WARN
+#define HIVE_LOG_WARN(tag, format, ...)  hiveLogWrite("WARN :", tag, format, ##__VA_ARGS__)
+#else
+#define HIVE_LOG_WARN(tag, format, ...)  _HIVE_LOG_NOTHING
+#endif
+#if HIVE_LOG_LEVEL >= HIVE_LOG_LEVEL_INFO
+#define HIVE_LOG_INFO(tag, format, ...)  hiveLogWrite("INFO :", tag, format, ##__VA_ARGS__)
+#else
+#define HIVE_LOG_INFO(tag, format, ...)  _HIVE_LOG_NOTHING
+#endif
+#if HIVE_LOG_LEVEL >= HIVE_LOG_LEVEL_DEBUG
+#define HIVE_LOG_DEBUG(tag, format, ...) hiveLogWrite("DEBUG:", tag, format, ##__VA_ARGS__)
+#else
+#define HIVE_LOG_DEBUG(tag, format, ...) _HIVE_LOG_NOTHING
+#endif
+
+char _hiveLogBuffer[HIVE_LOG_BUFFER_SIZE];
+volatile uint32_t _hiveLogWritten = 0;  //Producer, bytes ever written
+volatile uint32_t _hiveLogDrained = 0;  //Consumer, bytes ever sent to the UART
+uint32_t hiveLogDroppedLines = 0;
+boolean hiveLogAsync = false;           //Until setup() is done every line goes out right away.
+
+void flushHiveLog();
+
+void hiveLogWrite(const char* level, const char* tag, const char* format, ...) __attribute__((format(printf, 3, 4)));
+void hiveLogWrite(const char* level, const char* tag, const char* format, ...){
+  char line[HIVE_LOG_LINE_MAX + 1];
+  int length = snprintf(line, HIVE_LOG_LINE_MAX, "%s [%s] ", level, tag);
+  va_list args;
+  va_start(args, format);
+  int messageLength = vsnprintf(line + length, HIVE_LOG_LINE_MAX - length, format, args);
+  va_end(args);
+  if(messageLength < 0) messageLength = 0;
+  length += messageLength;
+  if(length >= HIVE_LOG_LINE_MAX - 1){
+    length = HIVE_LOG_LINE_MAX - 1;
+    line[length - 2] = '.';
+    line[length - 1] = '.';
+  }
+  line[length++] = '\n';
+
+  uint32_t written = _hiveLogWritten;
+  if(HIVE_LOG_BUFFER_SIZE - (written - _hiveLogDrained) < (uint32_t)length){
+    hiveLogDroppedLines++;
+    return;
+  }
+  for(int i=0;i<length;i++){
+    _hiveLogBuffer[(written + i) & (HIVE_LOG_BUFFER_SIZE - 1)] = line[i];
+  }
+  _hiveLogWritten = written + length; //Publish the line only once it is complete.
+  if(!hiveLogAsync) flushHiveLog();
+}
+
+boolean isHiveLogPending(){
+  return _hiveLogWritten != _hiveLogDrained;
+}
+
+//Sends what the UART can take right now, never waits.
+void drainHiveLog(){
+  static uint32_t reportedDroppedLines = 0;
+  if(hiveLogDroppedLines != reportedDroppedLines && !isHiveLogPending()){
+    uint32_t dropped = hiveLogDroppedLines - reportedDroppedLines;
+    reportedDroppedLines = hiveLogDroppedLines;
+    HIVE_LOG_WARN("LOG", "%lu lines dropped, UART behind.", (unsigned long)dropped);
+  }
+  int room = Serial.availableForWrite();
+  uint32_t drained = _hiveLogDrained;
+  uint32_t written = _hiveLogWritten;
+  while(room > 0 && drained != written){
+    uint32_t at = drained & (HIVE_LOG_BUFFER_SIZE - 1);
+    uint32_t chunk = written - drained;
+    if(chunk > HIVE_LOG_BUFFER_SIZE - at) chunk = HIVE_LOG_BUFFER_SIZE - at;
+    if(chunk > (uint32_t)room) chunk = room;
+    Serial.write((const uint8_t*)_hiveLogBuffer + at, chunk);
+    drained += chunk;
+    room -= chunk;
+  }
+  _hiveLogDrained = drained;
+}
+
+//Blocking, before DeepSleep or a restart so the last lines are not lost.
+void flushHiveLog(){
+  while(isHiveLogPending()){
+    drainHiveLog();
+    yield();
+  }
+  Serial.flush();
+}
+
+/*
+ * Copies the most recent log lines, whole lines only, into tail (NUL terminated).
+ * Returns the length copied.
+ */
+size_t readHiveLogTail(char* tail, size_t tailSize){
+  if(tailSize == 0) return 0;
+  uint32_t written = _hiveLogWritten;
+  uint32_t available = written < HIVE_LOG_BUFFER_SIZE ? written : HIVE_LOG_BUFFER_SIZE;
+  if(available > tailSize - 1) available = tailSize - 1;
+  uint32_t from = written - available;
+  size_t length = 0;
+  boolean atLineStart = from == 0;
+  for(uint32_t at=from; at<written; at++){
+    char c = _hiveLogBuffer[at & (HIVE_LOG_BUFFER_SIZE - 1)];
+    if(!atLineStart){
+      atLineStart = c == '\n';
+      continue;
+    }
+    tail[length++] = c;
+  }
+  tail[length] = '\0';
+  return length;
+}
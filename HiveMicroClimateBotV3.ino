@@ -6,173 +6,363 @@
  *  -- LED Connected GREEN ( +v=D2, -v=:Resistory:GND25 )
  */
 
+#include "HiveLog.library.v1.0.h"
 #include "BotEnvConfig.h" 
 #include "LEDNotify.library.v2.0.h"
 #include "HiveUtility.library.v2.0.h"
+#include "HivePayload.library.v1.0.h"
+#include "BotEnergyMeter.library.v1.0.h"
+#include "HiveLatency.library.v1.0.h"
+#include "HivePublishQueue.library.v1.0.h"
 #include "BotSensors.library.v2.0.h"
+#include "BotSampleStore.library.v1.0.h"
+#include "BotReportPolicy.library.v1.0.h"
+#include "BotSensorSet.library.v1.0.h"
 #include "HiveConnector.library.v3.0.h"
+#include "HiveInstructions.library.v1.0.h"
+#include "HiveSchedule.library.v1.0.h"
 #include "IRAirconRemote.utility.h"
+#include "BotThermostat.library.v1.0.h"
 
 /*
  * Our EventTimes and Enabled Switches
+ * Periods can be set at compile time (-DSENSOR_PERIOD_MS=..), to load test HiveCentral with
+ * off-device builds on other cadences. See README.md.
  */
+#ifndef HEARTBEAT_PERIOD_MS
+#define HEARTBEAT_PERIOD_MS (1000 * 60 * 5)
+#endif
+#ifndef SENSOR_PERIOD_MS
+#define SENSOR_PERIOD_MS    (1000 * 60)
+#endif
+#ifndef DEEPSLEEP_AFTER_MS
+#define DEEPSLEEP_AFTER_MS  (1000 * 10)
+#endif
+#ifndef DEEPSLEEP_SECS
+#define DEEPSLEEP_SECS 180
+#endif
 
-EventTimer heartbeatTimer("HeartBeat",      1000 * 60 * 5 , true,   false); //every x mins, works only if DeepSleep is not enabled. else use the catchup.
-EventTimer sensorTimer("Sensor",            1000 * 60  , true,   true);  //every x seconds, Run from bootuptime or when enabled; Use
-EventTimer irRecieverFunction("IRReciever", 500       , false,  false); //How frequent we should give control
-EventTimer deepsleepFunction("Deepsleep",   1000 * 10 , false,  false); //every x Seconds , No need to run immediate if enabled. Give time for others.
+EventTimer heartbeatTimer("HeartBeat",      HEARTBEAT_PERIOD_MS, true, false); //every x mins, works only if DeepSleep is not enabled. else use the catchup.
+EventTimer sensorTimer("Sensor",            SENSOR_PERIOD_MS, true,   true);  //every x seconds, Run from bootuptime or when enabled; Use
+EventTimer sensorPollTimer("SensorPoll#",   SENSOR_POLL_MS, false, true);  //Background sampling of BotSensorSet, with the Sensor function
+EventTimer irRecieverFunction("IRReciever#", 25       , false,  false); //Poll for captured IR frames, never blocks
+EventTimer deepsleepFunction("Deepsleep",   DEEPSLEEP_AFTER_MS, false, false); //every x Seconds , No need to run immediate if enabled. Give time for others.
+
+/*
+ * Sensors of this bot, sampled and reported together by runSensorTask.
+ */
+typedef SensorSet<Dht22Driver> BotSensorSet;
+
+/*
+ * Tasks due in the same pass run together, in the order added on ties.
+ * Idle between deadlines is capped so client.loop() still picks up incoming instructions.
+ */
+#define SCHEDULER_MAX_IDLE_MS 1000
+EventScheduler hiveScheduler;
 /* 
  * Overide HiveConnector Callback  
  * 
 */
 void callbackMqttConnected(){
-  publishToHive(DATATYPE_BOOTUP_NOTIFY,"");
+  publishToHive(DATATYPE_BOOTUP_NOTIFY);
 }
 void callbackMqttNotConnected(){}
+//delay() between deadlines drops to Light Sleep, unless IR listen is on, Light Sleep stalls the CPU and the capture interrupt misses edges.
+void updateWiFiSleepMode(){
+  WiFi.setSleepMode(irRecieverFunction.isEnabled() ? WIFI_MODEM_SLEEP : WIFI_LIGHT_SLEEP);
+}
 void callbackUpdateFunctions(String enabledFunctions){
-  Serial.print("DEBUG: [FUNCT] +DHT22    : " );
-  String ifOnRunFreq = "ON (check_frequency_secs) " + String(sensorTimer.runFrequency()/1000);
-  Serial.println((sensorTimer.enabled((enabledFunctions.indexOf("DHT22") > 0)))?ifOnRunFreq:"OFF");
+  boolean functionOn = sensorTimer.enabled(enabledFunctions.indexOf("DHT22") > 0);
+  sensorPollTimer.enabled(functionOn);
+  if(functionOn) HIVE_LOG_DEBUG("FUNCT", "+DHT22    : ON (check_frequency_secs) %d", sensorTimer.runFrequency()/1000);
+  else HIVE_LOG_DEBUG("FUNCT", "+DHT22    : OFF");
+  sampleStoreSetFlag(SAMPLE_STORE_DHT22, functionOn);
 
-  Serial.print("DEBUG: [FUNCT] +DEEPSLEEP: " );
-  ifOnRunFreq = "ON (after_secs) " + String(deepsleepFunction.runFrequency()/1000);
-  Serial.println((deepsleepFunction.enabled((enabledFunctions.indexOf("DEEPSLEEP") > 0)))?ifOnRunFreq:"OFF");
+  functionOn = deepsleepFunction.enabled(enabledFunctions.indexOf("DEEPSLEEP") > 0);
+  if(functionOn) HIVE_LOG_DEBUG("FUNCT", "+DEEPSLEEP: ON (after_secs) %d", deepsleepFunction.runFrequency()/1000);
+  else HIVE_LOG_DEBUG("FUNCT", "+DEEPSLEEP: OFF");
+  sampleStoreSetFlag(SAMPLE_STORE_DEEPSLEEP, functionOn);
 
-  Serial.print("DEBUG: [FUNCT] +IR_LISTEN: " );
-  Serial.println((irRecieverFunction.enabled((enabledFunctions.indexOf("IR_LISTEN") > 0)))?"ON":"OFF");
+  functionOn = irRecieverFunction.enabled(enabledFunctions.indexOf("IR_LISTEN") > 0);
+  HIVE_LOG_DEBUG("FUNCT", "+IR_LISTEN: %s", functionOn ? "ON" : "OFF");
+  updateWiFiSleepMode();
 
-  
-}
-void callbackInstructionRecieved(long instrId,String command, String params){
-  boolean publishInstructionSucessfull = false;
-  boolean publishInstructionFailed = false;
-  boolean rebootDeviceAfterReportingToServer = false;
-  if(command == "LEDDANCE"){
-    Serial.print("DEBUG: [LEDDANCE] Executing. InstructionId:" );
-    Serial.println(instrId);
-    doLEDDance();
-    publishInstructionSucessfull=true;
-  }else if(command == "REBOOT"){
-    Serial.print("DEBUG: [REBOOT] Executing. InstructionId:" );
-    Serial.println(instrId);
-    doLEDDance();
-    publishInstructionSucessfull=true;
-    rebootDeviceAfterReportingToServer=true;
-    
-  }else if(command == "IRAC_OFF"){
-    Serial.print("DEBUG: [IRAC_OFF] Executing. InstructionId:" );
-    Serial.println(instrId);
-    setAirconProfile(0,false,26,KELVINATOR_COOL,0);
-    sendAirconProfile();
-    publishInstructionSucessfull=true;
-    publishToHive(DATATYPE_SENSOR_DATA,getAirconfProfileDataMap());
-  }else if(command == "IRAC_ONN_PROFILE_A"){
-    Serial.print("DEBUG: [IRAC_ONN_PROFILE_A] Executing. InstructionId:" );
-    Serial.println(instrId);
-    setAirconProfile(1,true,24,KELVINATOR_COOL,2);
-    sendAirconProfile();
-    publishInstructionSucessfull=true;
-    publishToHive(DATATYPE_SENSOR_DATA,getAirconfProfileDataMap());
-  }else if(command == "IRAC_ONN_PROFILE_B"){
-    Serial.print("DEBUG: [IRAC_ONN_PROFILE_B] Executing. InstructionId:" );
-    Serial.println(instrId);
-     setAirconProfile(2,true,24,KELVINATOR_DRY,2);
-     sendAirconProfile();
-    publishInstructionSucessfull=true;
-    publishToHive(DATATYPE_SENSOR_DATA,getAirconfProfileDataMap());
-  }else if(command == "IRAC_ONN_PROFILE_C"){
-    Serial.print("DEBUG: [IRAC_ONN_PROFILE_C] Executing. InstructionId:" );
-    Serial.println(instrId);
-    setAirconProfile(3,true,24,KELVINATOR_FAN,4);
-    sendAirconProfile();
-    publishInstructionSucessfull=true;
-    publishToHive(DATATYPE_SENSOR_DATA,getAirconfProfileDataMap());
-  }else{
-    Serial.print("DEBUG: [UNKINSR] Unknown Instruction no action taken:" );
-    Serial.print(instrId);
-    Serial.println(command);
-  }
+  irPublishRawFrames = enabledFunctions.indexOf("IR_RAW") > 0;
+  HIVE_LOG_DEBUG("FUNCT", "+IR_RAW   : %s", irPublishRawFrames ? "ON" : "OFF");
 
-  if(publishInstructionSucessfull){
-    String insrDet = "{\"instrId\":" ;
-    insrDet += String(instrId);
-    insrDet += ",\"command\":\"";
-    insrDet += command;
-    insrDet += "\"}";
-    publishToHive(DATATYPE_INSTRUCTION_COMPLETED,insrDet);
-  }else if(publishInstructionFailed){
-    String insrDet = "{\"instrId\":" ;
-    insrDet += String(instrId);
-    insrDet += ",\"command\":\"";
-    insrDet += command;
-    insrDet += "\"}";
-    publishToHive(DATATYPE_INSTRUCTION_EXEFAILED,insrDet);
-  }
+  functionOn = enableThermostat(enabledFunctions.indexOf("THERMOSTAT") > 0);
+  HIVE_LOG_DEBUG("FUNCT", "+THERMOSTAT: %s", functionOn ? "ON" : "OFF");
 
+  functionOn = enabledFunctions.indexOf("MSGPACK") > 0;
+  HIVE_LOG_DEBUG("FUNCT", "+MSGPACK  : %s", functionOn ? "ON" : "OFF");
+  setHivePayloadBinary(functionOn);
+}
+void callbackUpdateSettings(JsonObject& settings){
+  updateReportSettings(settings);
+  updateThermostatSettings(settings);
+}
+void publishAirconProfile(){
+  writeAirconProfileDataMap(beginHivePayload(DATATYPE_SENSOR_DATA));
+  publishHivePayload();
+}
+/*
+ * Instruction Handlers, registered in setup().
+ */
+void doLEDDanceMetered(){
+  EnergyPhase previousPhase = energyEnterPhase(ENERGY_LED);
+  doLEDDance();
+  energyEnterPhase(previousPhase);
+}
+int instructionLedDance(long instrId, const char* params){
+  doLEDDanceMetered();
+  return INSTRUCTION_OK;
+}
+int instructionReboot(long instrId, const char* params){
+  doLEDDanceMetered();
+  return INSTRUCTION_OK_THEN_REBOOT;
+}
+int instructionAirconOff(long instrId, const char* params){
+  applyAirconProfile(0);
+  publishAirconProfile();
+  return INSTRUCTION_OK;
+}
+int instructionAirconProfileA(long instrId, const char* params){
+  applyAirconProfile(1);
+  publishAirconProfile();
+  return INSTRUCTION_OK;
+}
+int instructionAirconProfileB(long instrId, const char* params){
+  applyAirconProfile(2);
+  publishAirconProfile();
+  return INSTRUCTION_OK;
+}
+int instructionAirconProfileC(long instrId, const char* params){
+  applyAirconProfile(3);
+  publishAirconProfile();
+  return INSTRUCTION_OK;
+}
+//Defines and/or applies a profile from the table, params in IRAirconRemote.utility.h
+int instructionAirconProfile(long instrId, const char* params){
+  if(!airconProfileFromParams(params)) return INSTRUCTION_FAILED;
+  if(instructionParamLong(params, "apply", 1) != 0) publishAirconProfile();
+  return INSTRUCTION_OK;
+}
+//Recent log lines to HiveCentral, as many whole lines as fit one message.
+char _logTail[HIVE_LOG_BUFFER_SIZE / 4];
+int instructionLogTail(long instrId, const char* params){
+  HivePayloadWriter& dataMap = beginHivePayload(DATATYPE_SENSOR_DATA);
+  size_t room = hivePayloadRoom() * 9 / 10; //Escaped newlines take two bytes.
+  readHiveLogTail(_logTail, room < sizeof(_logTail) ? room : sizeof(_logTail));
+  dataMap.addString(HF_LogTail, _logTail);
+  return publishHivePayload() ? INSTRUCTION_OK : INSTRUCTION_FAILED;
+}
+//Latency histograms since the last report, split over messages when they do not fit one. Then starts over.
+int instructionLatency(long instrId, const char* params){
+  boolean published = true;
+  HivePayloadWriter* dataMap = NULL;
+  for(int i=0;i<LATENCY_PATH_COUNT;i++){
+    if(dataMap != NULL && hivePayloadRoom() < LATENCY_ENTRY_BYTES){
+      dataMap->endObject();
+      published = publishHivePayload() && published;
+      dataMap = NULL;
+    }
+    if(dataMap == NULL){
+      dataMap = &beginHivePayload(DATATYPE_SENSOR_DATA);
+      dataMap->beginObject(HF_Latency);
+    }
+    writeLatencyEntry(*dataMap, (LatencyPath)i);
+  }
+  dataMap->endObject();
+  published = publishHivePayload() && published;
+  resetLatencyHistograms(); //Live or queued, the snapshot is in the payloads.
+  return published ? INSTRUCTION_OK : INSTRUCTION_FAILED;
+}
+void setupInstructions(){
+  REGISTER_INSTRUCTION("LEDDANCE",            instructionLedDance);
+  REGISTER_INSTRUCTION("REBOOT",              instructionReboot);
+  REGISTER_INSTRUCTION("IRAC_OFF",            instructionAirconOff);
+  REGISTER_INSTRUCTION("IRAC_ONN_PROFILE_A",  instructionAirconProfileA);
+  REGISTER_INSTRUCTION("IRAC_ONN_PROFILE_B",  instructionAirconProfileB);
+  REGISTER_INSTRUCTION("IRAC_ONN_PROFILE_C",  instructionAirconProfileC);
+  REGISTER_INSTRUCTION("IRAC_PROFILE",        instructionAirconProfile);
+  REGISTER_INSTRUCTION("LOGTAIL",             instructionLogTail);
+  REGISTER_INSTRUCTION("LATENCY",             instructionLatency);
+}
 
-  if(rebootDeviceAfterReportingToServer){
+void callbackInstructionRecieved(long instrId,const char* command, const char* params){
+  unsigned long startUs = micros();
+  int result = dispatchInstruction(instrId,command,params);
+  latencyRecord(LATENCY_INSTRUCTION, micros() - startUs);
+  if(result == INSTRUCTION_OK_THEN_REBOOT){
     disconnectFromHive();
-    Serial.println("DEBUG: [REBOOT] Rebooting Device in 5 seconds" );
+    HIVE_LOG_DEBUG("REBOOT", "Rebooting Device in 5 seconds");
+    flushHiveLog();
+    flushInstructionCache();
+    saveHiveSchedule();
     delay(1000 * 5);
+    energyDeepSleep(3);
+    saveAirconSent(3);
     ESP.deepSleep(3e6); // 10e6 = 10 Seconds, 
   }
 }
 
+void callbackInstructionScheduled(long instrId,const char* command, const char* params, uint32_t dueAt){
+  if(!scheduleInstruction(instrId,command,params,dueAt)){
+    publishInstructionResult(DATATYPE_INSTRUCTION_EXEFAILED, instrId, command);
+  }
+}
+
+/*
+ * Scheduled Tasks, run by hiveScheduler in order of their next deadline.
+ */
+void runSensorTask(){
+  boolean heartbeatDue = reportMaxSilenceExpired();
+  if(!BotSensorSet::sample()){
+    return;
+  }
+  HivePayloadWriter& dataMap = beginHivePayload(DATATYPE_SENSOR_DATA);
+  BotSensorSet::writeDataMap(dataMap);
+  //Stands in for the HeartBeat, so it carries the energy summary too.
+  if(heartbeatDue && hivePayloadRoom() >= ENERGY_DATAMAP_BYTES) writeEnergyDataMap(dataMap);
+  if(publishHivePayload()){
+    BotSensorSet::markPublished();
+  }
+}
+void runDeepsleepTask(){
+  disconnectFromHive();
+  HIVE_LOG_DEBUG("DEEPSLEEP", "Going into PowerSaver Sleep.");
+  delay(1000 *1);
+  sampleStoreDeepSleep(DEEPSLEEP_SECS, SAMPLE_STORE_PUBLISH_EVERY_WAKEUPS <= 1);
+}
+
+/*
+ * Wake from DeepSleep with the radio off, read the sensor into the Sample Store and
+ * go straight back to sleep. Returns only when this wake should connect and publish.
+ */
+void handleDeepSleepWakeup(){
+  boolean storeValid = loadSampleStore();
+  if(ESP.getResetInfoPtr()->reason != REASON_DEEP_SLEEP_AWAKE) return;
+  if(!storeValid || !(sampleStore.flags & SAMPLE_STORE_DEEPSLEEP)) return;
+  sampleStore.wakeups++;
+  if(!(sampleStore.flags & SAMPLE_STORE_RADIO_OFF)) return; //Radio is up, the sensor task publishes the batch.
+
+  if((sampleStore.flags & SAMPLE_STORE_DHT22) && readSensors()){
+    sampleStorePush(dht22_temp_f, dht22_humidity);
+  }
+  if(sampleStoreNeedsPublish()){
+    HIVE_LOG_DEBUG("DEEPSLEEP", "Sample batch due, restarting with radio on.");
+    sampleStoreDeepSleep(0, true);
+  }
+  HIVE_LOG_DEBUG("DEEPSLEEP", "Sample stored (%d batched), radio stays off.", sampleStore.count);
+  sampleStoreDeepSleep(DEEPSLEEP_SECS, sampleStore.wakeups + 1 >= SAMPLE_STORE_PUBLISH_EVERY_WAKEUPS);
+}
+void runHeartbeatTask(){
+  //if Nothing Else to Publish , just a heartBeat since its pubTime
+  //With the sensor on, its max silence report is the HeartBeat.
+  unsigned long quietForMs = sensorTimer.isEnabled() ? reportMaxSilenceSecs * 1000UL : heartbeatTimer.runFrequency();
+  if(millis() - hiveLastPublishAtMs < quietForMs) return;
+  publishToHive(DATATYPE_NOTHING_SPECIAL_BUT_LET_THEM_KNOW_I_AM_ALIVE);
+}
+/*
+ * One IRFrames entry per distinct frame, a held button shows up as repeats.
+ * Split over several messages when the frames do not fit one MQTT packet.
+ */
+void publishIRFrames(){
+  //In IR_RAW, UNKNOWN frames are what HiveCentral wants to decode, keep them.
+  if(!irPublishRawFrames && isIRBurstNoise()){
+    HIVE_LOG_WARN("IR_RECIEVE", "Only UNKNOWN IR frames, Possibly Interference");
+    clearIRFrames();
+    return;
+  }
+  HivePayloadWriter* dataMap = NULL;
+  IrFrame frame;
+  while(popIRFrame(frame)){
+    //Raw entries are bounded by the frame, text is only built when it is sent.
+    String description = irPublishRawFrames ? String() : describeIRFrame(frame);
+    size_t entryBytes = irPublishRawFrames ? 48 + (STATE_SIZE_MAX + frame.timingBytes) * 4 / 3 : description.length() + 32;
+    if(!irPublishRawFrames){
+      HIVE_LOG_DEBUG("IRREAD", "Readable:%s", description.c_str());
+    }
+    if(dataMap != NULL && hivePayloadRoom() < entryBytes){
+      dataMap->endArray();
+      publishHivePayload();
+      dataMap = NULL;
+    }
+    if(dataMap == NULL){
+      dataMap = &beginHivePayload(DATATYPE_SENSOR_DATA);
+      dataMap->beginArray(HF_IrFrames);
+    }
+    dataMap->beginObject();
+    if(irPublishRawFrames) writeIRFrameRaw(*dataMap, frame);
+    else dataMap->addString(HF_IRemoteData, description.c_str());
+    dataMap->addLong(HF_IrRepeats, frame.repeats);
+    dataMap->endObject();
+  }
+  if(dataMap != NULL){
+    dataMap->endArray();
+    if(irDroppedFrames > 0) dataMap->addLong(HF_IrDroppedFrames, irDroppedFrames);
+    publishHivePayload();
+  }
+  clearIRFrames();
+}
+void runIRRecieverTask(){
+  EnergyPhase previousPhase = energyEnterPhase(ENERGY_IR);
+  pollIRReceiver();
+  energyEnterPhase(previousPhase);
+  if(isIRBurstComplete()){
+    publishIRFrames();
+  }
+}
+
 void loop() 
 {
-  
+  unsigned long startUs = micros();
   loopHiveConnector();
+  pollScheduledInstructions(); //Connected or not, acks are queued when offline.
+  pollThermostat();
+  pollInstructionCache();
   
-  if(isHiveConnected()){
-
-    //Check time to collect Sensor Data
-    if(sensorTimer.isDueForRun()){
-      if(readSensors()){
-        String dataMap = "\"Temperature\": \""+ String(dht22_temp_f) +"\""  ;
-        dataMap += ",\"HumidityPercent\": \""+ String(dht22_humidity) +"\""  ;
-        dataMap += ",\"DHT22_SensorStatus\": \"OK\""  ;
-        publishToHive(DATATYPE_SENSOR_DATA,dataMap);
-      }else{
-        String dataMap = "\"Temperature\": \"-1\" ,\"HumidityPercent\": \"-1\", \"DHT22_SensorStatus\": \"Error Reading DHT22.\""  ;
-        publishToHive(DATATYPE_SENSOR_DATA,dataMap);
-      }  
-    }else if(deepsleepFunction.isDueForRun()){
-      disconnectFromHive();
-      Serial.println("DEBUG: [DEEPSLEEP] Going into PowerSaver Sleep." );
-      delay(1000 *1);
-      ESP.deepSleep(180e6); // 10e6 = 10 Seconds , freq in MicroSeconds, 
-    }else if(heartbeatTimer.isDueForRun()){
-      //if Nothing Else to Publish , just a heartBeat since its pubTime
-      String dataMap = "";
-      publishToHive(DATATYPE_NOTHING_SPECIAL_BUT_LET_THEM_KNOW_I_AM_ALIVE,dataMap);
-    }else if(irRecieverFunction.isDueForRun()){
-      //
-      Serial.printf("DEBUG: [IR_RECIEVE] Handling Control to IR Reader for %d Seconds.\n", irContinusRunForSecs);
-      while(!checkIRAndInteruptForOtherProcessing()){
-        //Keep going Man.
-      }
-      if(!irDataPayload.equals("") ){
-        if(irDataPayload.length()>50){
-          String dataMap = "\"IRemoteData\": \"" + irDataPayload +"\""  ;
-          publishToHive(DATATYPE_SENSOR_DATA,dataMap);
-        }else{
-          Serial.println("WARN : [IR_RECIEVE] IR Data Ignored < 50 Chars, Possibly Interference");
-        }
-      }
-    }
-
+  boolean connected = isHiveConnected();
+  if(connected){
+    hiveScheduler.runDueTasks();
+  }
+  drainHiveLog();
+  latencyRecord(LATENCY_LOOP, micros() - startUs);
+  energyEnterPhase(ENERGY_IDLE);
+  unsigned long maxIdleMs = isHiveLogPending() ? HIVE_LOG_DRAIN_IDLE_MS : SCHEDULER_MAX_IDLE_MS;
+  if(connected){
+    hiveScheduler.sleepUntilNextDue(maxIdleMs);
+  }else{
+    //Tasks are held back until the broker is back, idle until the next reconnect attempt.
+    hiveScheduler.sleepFor(msUntilHiveReconnect(), maxIdleMs);
   }
-  delay(100);
+  energyEnterPhase(ENERGY_ACTIVE);
 }
 
 
 void setup() {
   Serial.begin(115200);
   Serial.println();
-  Serial.println("INFO : [HIVEBOT] Booting up.");
+  HIVE_LOG_INFO("HIVEBOT", "Booting up.");
   delay(10);
+  setupEnergyMeter();
+  handleDeepSleepWakeup();
   setupLEDNotify();
+  energyEnterPhase(ENERGY_WIFI);
   setupHiveConnector();
+  energyEnterPhase(ENERGY_ACTIVE);
   // Ready & Connected to Wifi Post AP Setup.
   setupIRModule();
+  setupInstructions();
+  setupHiveSchedule();
+  setupThermostat();
+
+  hiveScheduler.addTask(&sensorPollTimer,     BotSensorSet::poll);
+  hiveScheduler.addTask(&sensorTimer,         runSensorTask);
+  hiveScheduler.addTask(&deepsleepFunction,   runDeepsleepTask);
+  hiveScheduler.addTask(&heartbeatTimer,      runHeartbeatTask);
+  hiveScheduler.addTask(&irRecieverFunction,  runIRRecieverTask);
+  hiveScheduler.addTask(&publishQueueDrainTimer, drainPublishQueue);
+  updateWiFiSleepMode();
+  hiveLogAsync = true; //From here on the log waits for the scheduler to drain it.
 }
@@ -0,0 +1,398 @@
+/*
+ * HivePayloadWriter, streams the HiveCentral message envelope straight into a fixed buffer.
+ * No String, no heap. Overflow is sticky and checked once before publishing.
+ *
+ * Field names are known at compile time, add new ones to HIVE_PAYLOAD_FIELDS.
+ * Only append to the list, the position is the field id.
+ *
+ * Two encodings from the same calls:
+ *  JSON    : {"dataType":"SensorData","dataMap":{"Temperature":"23.40"},..}
+ *  MSGPACK : keys are the field id, dataType is the DATATYPE_ code,
+ *            addFixed values are integers scaled by 10^decimals (23.40 -> 2340).
+ *            Maps and arrays are written as map16/array16, counts patched on close.
+ * addBytes is base64 text in JSON and bin in MSGPACK.
+ */
+#include <stdint.h>
+#include <string.h>
+#include <math.h>
+
+#define HIVE_PAYLOAD_FIELDS(FIELD) \
+  FIELD(DataType,           "dataType") \
+  FIELD(DataMap,            "dataMap") \
+  FIELD(Instructions,       "instructions") \
+  FIELD(HiveBotId,          "hiveBotId") \
+  FIELD(AccessKey,          "accessKey") \
+  FIELD(InstrId,            "instrId") \
+  FIELD(Command,            "command") \
+  FIELD(Temperature,        "Temperature") \
+  FIELD(HumidityPercent,    "HumidityPercent") \
+  FIELD(DHT22SensorStatus,  "DHT22_SensorStatus") \
+  FIELD(IRemoteData,        "IRemoteData") \
+  FIELD(AcPower,            "AcPower") \
+  FIELD(AcTemp,             "AcTemp") \
+  FIELD(AcMode,             "AcMode") \
+  FIELD(AcFan,              "AcFan") \
+  FIELD(AcProfileId,        "AcProfileId") \
+  FIELD(Samples,            "Samples") \
+  FIELD(SampleAgeSecs,      "ageSecs") \
+  FIELD(SampleTemperature,  "t") \
+  FIELD(SampleHumidity,     "h") \
+  FIELD(BootMode,           "bootMode") \
+  FIELD(BootWifiMs,         "bootWifiMs") \
+  FIELD(BootMqttMs,         "bootMqttMs") \
+  FIELD(Seq,                "seq") \
+  FIELD(Encodings,          "encodings") \
+  FIELD(IrFrames,           "IRFrames") \
+  FIELD(IrRepeats,          "repeats") \
+  FIELD(IrDroppedFrames,    "IRDroppedFrames") \
+  FIELD(IrProtocol,         "IRProtocol") \
+  FIELD(IrBits,             "bits") \
+  FIELD(IrState,            "IRState") \
+  FIELD(IrTimings,          "IRTimings") \
+  FIELD(IrRawLen,           "rawlen") \
+  FIELD(LogTail,            "logTail") \
+  FIELD(Energy,             "energy") \
+  FIELD(EnergyMahPerHour,   "mAhPerHour") \
+  FIELD(EnergyActiveSecs,   "activeSecs") \
+  FIELD(EnergyWifiSecs,     "wifiSecs") \
+  FIELD(EnergyMqttSecs,     "mqttSecs") \
+  FIELD(EnergyPublishSecs,  "publishSecs") \
+  FIELD(EnergyDht22Secs,    "dht22Secs") \
+  FIELD(EnergyIrSecs,       "irSecs") \
+  FIELD(EnergyLedSecs,      "ledSecs") \
+  FIELD(EnergyIdleSecs,     "idleSecs") \
+  FIELD(EnergyDeepSleepSecs,"deepSleepSecs") \
+  FIELD(Latency,            "latency") \
+  FIELD(LatencyLoop,        "loop") \
+  FIELD(LatencyMqttCallback,"mqttCallback") \
+  FIELD(LatencyInstruction, "instruction") \
+  FIELD(LatencyPublish,     "publish") \
+  FIELD(LatencyCount,       "n") \
+  FIELD(LatencyP50Us,       "p50Us") \
+  FIELD(LatencyP99Us,       "p99Us") \
+  FIELD(LatencyMaxUs,       "maxUs") \
+  FIELD(Thermostat,         "thermostat") \
+  FIELD(ThermostatSetpoint, "setpoint")
+
+#define HIVE_PAYLOAD_FIELD_ENUM(fieldId, fieldName) HF_##fieldId,
+#define HIVE_PAYLOAD_FIELD_NAME(fieldId, fieldName) fieldName,
+enum HiveField { HIVE_PAYLOAD_FIELDS(HIVE_PAYLOAD_FIELD_ENUM) HF_FIELD_COUNT };
+static const char* const hivePayloadFieldNames[HF_FIELD_COUNT] = { HIVE_PAYLOAD_FIELDS(HIVE_PAYLOAD_FIELD_NAME) };
+static_assert(HF_FIELD_COUNT <= 128, "MSGPACK keys are written as positive fixint");
+
+#define HIVE_PAYLOAD_MAX_DEPTH 6
+
+class HivePayloadWriter
+{
+  private:
+    char* _buffer;
+    size_t _capacity;
+    size_t _length = 0;
+    boolean _overflow = false;
+    boolean _needsComma = false;
+    boolean _binary = false;
+    uint8_t _depth = 0;
+    size_t _containerAt[HIVE_PAYLOAD_MAX_DEPTH];
+    uint16_t _containerCount[HIVE_PAYLOAD_MAX_DEPTH];
+    void _write(char c);
+    void _write(const char* text);
+    void _writeEscaped(const char* text);
+    void _writeBase64(const uint8_t* data, size_t length);
+    void _writeUnsigned(unsigned long value, uint8_t minDigits);
+    void _writeKey(HiveField field);
+    void _writeBigEndian(uint32_t value, uint8_t bytes);
+    void _packLong(long value);
+    void _packString(const char* value);
+    void _packOpen(uint8_t marker);
+    void _packClose();
+    void _countElement();
+  public:
+    HivePayloadWriter(char* buffer, size_t capacity);
+    void setBinary(boolean binary);   //MSGPACK instead of JSON, from the next reset()
+    boolean isBinary();
+    void reset();
+    void beginObject();
+    void beginObject(HiveField field);
+    void endObject();
+    void beginArray(HiveField field);
+    void endArray();
+    void addString(HiveField field, const char* value);
+    void addLong(HiveField field, long value);
+    void addFixed(HiveField field, float value, uint8_t decimals); //Text with fixed decimals, "23.40"
+    void addSymbol(HiveField field, long code, const char* name); //name in JSON, code in MSGPACK
+    void addBytes(HiveField field, const uint8_t* data, size_t length);
+    boolean overflowed();
+    size_t length();
+    const char* c_str();
+};
+
+HivePayloadWriter::HivePayloadWriter(char* buffer, size_t capacity){
+  this->_buffer = buffer;
+  this->_capacity = capacity;
+  this->reset();
+}
+void HivePayloadWriter::setBinary(boolean binary){
+  this->_binary = binary;
+}
+boolean HivePayloadWriter::isBinary(){
+  return this->_binary;
+}
+void HivePayloadWriter::reset(){
+  this->_length = 0;
+  this->_overflow = false;
+  this->_needsComma = false;
+  this->_depth = 0;
+  this->_buffer[0] = '\0';
+}
+//Always keeps one byte for the terminating NUL.
+void HivePayloadWriter::_write(char c){
+  if(this->_length + 1 >= this->_capacity){
+    this->_overflow = true;
+    return;
+  }
+  this->_buffer[this->_length++] = c;
+  this->_buffer[this->_length] = '\0';
+}
+void HivePayloadWriter::_write(const char* text){
+  while(*text) this->_write(*text++);
+}
+void HivePayloadWriter::_writeEscaped(const char* text){
+  static const char hexDigits[] = "0123456789abcdef";
+  this->_write('"');
+  for(;*text;text++){
+    char c = *text;
+    if(c == '"' || c == '\\'){
+      this->_write('\\');
+      this->_write(c);
+    }else if((unsigned char)c < 0x20){
+      this->_write("\\u00");
+      this->_write(hexDigits[(c >> 4) & 0x0F]);
+      this->_write(hexDigits[c & 0x0F]);
+    }else{
+      this->_write(c);
+    }
+  }
+  this->_write('"');
+}
+void HivePayloadWriter::_writeBase64(const uint8_t* data, size_t length){
+  static const char base64Digits[] = "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+  this->_write('"');
+  for(size_t i=0;i<length;i+=3){
+    uint32_t group = (uint32_t)data[i] << 16;
+    if(i + 1 < length) group |= (uint32_t)data[i + 1] << 8;
+    if(i + 2 < length) group |= data[i + 2];
+    this->_write(base64Digits[(group >> 18) & 0x3F]);
+    this->_write(base64Digits[(group >> 12) & 0x3F]);
+    this->_write(i + 1 < length ? base64Digits[(group >> 6) & 0x3F] : '=');
+    this->_write(i + 2 < length ? base64Digits[group & 0x3F] : '=');
+  }
+  this->_write('"');
+}
+void HivePayloadWriter::_writeUnsigned(unsigned long value, uint8_t minDigits){
+  char digits[11];
+  uint8_t count = 0;
+  do{
+    digits[count++] = '0' + (value % 10);
+    value /= 10;
+  }while(value > 0 && count < sizeof(digits));
+  while(count < minDigits && count < sizeof(digits)) digits[count++] = '0';
+  while(count > 0) this->_write(digits[--count]);
+}
+void HivePayloadWriter::_writeKey(HiveField field){
+  if(this->_binary){
+    this->_countElement();
+    this->_write((char)field);
+    return;
+  }
+  if(this->_needsComma) this->_write(',');
+  this->_write('"');
+  this->_write(hivePayloadFieldNames[field]);
+  this->_write("\":");
+  this->_needsComma = true;
+}
+
+/* MSGPACK */
+void HivePayloadWriter::_writeBigEndian(uint32_t value, uint8_t bytes){
+  while(bytes > 0){
+    bytes--;
+    this->_write((char)((value >> (8 * bytes)) & 0xFF));
+  }
+}
+void HivePayloadWriter::_countElement(){
+  if(this->_depth > 0) this->_containerCount[this->_depth - 1]++;
+}
+void HivePayloadWriter::_packLong(long value){
+  if(value >= 0 && value < 128){
+    this->_write((char)value);                       //positive fixint
+  }else if(value < 0 && value >= -32){
+    this->_write((char)(0xE0 | (value + 32)));       //negative fixint
+  }else if(value >= -128 && value < 128){
+    this->_write((char)0xD0);
+    this->_writeBigEndian((uint32_t)value, 1);
+  }else if(value >= -32768 && value < 32768){
+    this->_write((char)0xD1);
+    this->_writeBigEndian((uint32_t)value, 2);
+  }else{
+    this->_write((char)0xD2);
+    this->_writeBigEndian((uint32_t)value, 4);
+  }
+}
+void HivePayloadWriter::_packString(const char* value){
+  size_t length = strlen(value);
+  if(length < 32){
+    this->_write((char)(0xA0 | length));
+  }else if(length < 256){
+    this->_write((char)0xD9);
+    this->_writeBigEndian(length, 1);
+  }else{
+    this->_write((char)0xDA);
+    this->_writeBigEndian(length, 2);
+  }
+  for(size_t i=0;i<length;i++) this->_write(value[i]);
+}
+//map16 (0xDE) or array16 (0xDC), count filled in by _packClose.
+void HivePayloadWriter::_packOpen(uint8_t marker){
+  if(this->_depth >= HIVE_PAYLOAD_MAX_DEPTH){
+    this->_overflow = true;
+    return;
+  }
+  this->_write((char)marker);
+  this->_containerAt[this->_depth] = this->_length;
+  this->_containerCount[this->_depth] = 0;
+  this->_depth++;
+  this->_writeBigEndian(0, 2);
+}
+void HivePayloadWriter::_packClose(){
+  if(this->_depth == 0 || this->_overflow) return;
+  this->_depth--;
+  size_t at = this->_containerAt[this->_depth];
+  uint16_t count = this->_containerCount[this->_depth];
+  this->_buffer[at] = (char)(count >> 8);
+  this->_buffer[at + 1] = (char)(count & 0xFF);
+}
+
+void HivePayloadWriter::beginObject(){
+  if(this->_binary){
+    this->_countElement();
+    this->_packOpen(0xDE);
+    return;
+  }
+  if(this->_needsComma) this->_write(',');
+  this->_write('{');
+  this->_needsComma = false;
+}
+void HivePayloadWriter::beginObject(HiveField field){
+  this->_writeKey(field);
+  if(this->_binary){
+    this->_packOpen(0xDE);
+    return;
+  }
+  this->_write('{');
+  this->_needsComma = false;
+}
+void HivePayloadWriter::endObject(){
+  if(this->_binary){
+    this->_packClose();
+    return;
+  }
+  this->_write('}');
+  this->_needsComma = true;
+}
+void HivePayloadWriter::beginArray(HiveField field){
+  this->_writeKey(field);
+  if(this->_binary){
+    this->_packOpen(0xDC);
+    return;
+  }
+  this->_write('[');
+  this->_needsComma = false;
+}
+void HivePayloadWriter::endArray(){
+  if(this->_binary){
+    this->_packClose();
+    return;
+  }
+  this->_write(']');
+  this->_needsComma = true;
+}
+void HivePayloadWriter::addString(HiveField field, const char* value){
+  this->_writeKey(field);
+  if(this->_binary){
+    this->_packString(value == NULL ? "" : value);
+    return;
+  }
+  this->_writeEscaped(value == NULL ? "" : value);
+}
+void HivePayloadWriter::addLong(HiveField field, long value){
+  this->_writeKey(field);
+  if(this->_binary){
+    this->_packLong(value);
+    return;
+  }
+  if(value < 0){
+    this->_write('-');
+    this->_writeUnsigned(0UL - (unsigned long)value, 1);
+  }else{
+    this->_writeUnsigned((unsigned long)value, 1);
+  }
+}
+void HivePayloadWriter::addSymbol(HiveField field, long code, const char* name){
+  if(this->_binary) this->addLong(field, code);
+  else this->addString(field, name);
+}
+void HivePayloadWriter::addBytes(HiveField field, const uint8_t* data, size_t length){
+  this->_writeKey(field);
+  if(!this->_binary){
+    this->_writeBase64(data, length);
+    return;
+  }
+  if(length < 256){
+    this->_write((char)0xC4);
+    this->_writeBigEndian(length, 1);
+  }else{
+    this->_write((char)0xC5);
+    this->_writeBigEndian(length, 2);
+  }
+  for(size_t i=0;i<length;i++) this->_write((char)data[i]);
+}
+/*
+ * JSON: same text String(float) gave us, without the heap. MSGPACK: value * 10^decimals.
+ */
+void HivePayloadWriter::addFixed(HiveField field, float value, uint8_t decimals){
+  static const unsigned long scales[] = {1, 10, 100, 1000, 10000};
+  this->_writeKey(field);
+  if(decimals > 4) decimals = 4;
+  unsigned long scale = scales[decimals];
+  float scaledValue = fabs(value) * scale + 0.5f;
+  if(this->_binary){
+    //Fixed point, NaN and out of range go out as the int32 minimum.
+    if(isnan(value) || !(scaledValue < 2.0e9f)) this->_packLong((long)INT32_MIN);
+    else this->_packLong(value < 0 ? -(long)scaledValue : (long)scaledValue);
+    return;
+  }
+  this->_write('"');
+  if(isnan(value)){
+    this->_write("nan");
+  }else if(!(scaledValue < 4.0e9f)){
+    this->_write("ovf");
+  }else{
+    boolean negative = value < 0;
+    unsigned long scaled = (unsigned long)scaledValue;
+    if(negative && scaled != 0) this->_write('-');
+    this->_writeUnsigned(scaled / scale, 1);
+    if(decimals > 0){
+      this->_write('.');
+      this->_writeUnsigned(scaled % scale, decimals);
+    }
+  }
+  this->_write('"');
+}
+boolean HivePayloadWriter::overflowed(){
+  return this->_overflow;
+}
+size_t HivePayloadWriter::length(){
+  return this->_length;
+}
+const char* HivePayloadWriter::c_str(){
+  return this->_buffer;
+}
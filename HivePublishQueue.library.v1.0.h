@@ -0,0 +1,172 @@
+/*
+ * Publish Queue, store-and-forward of payloads that could not be published.
+ * Log structured on SPIFFS: payloads are appended to segment files /q/<segmentId>,
+ * each record is [uint16 length][payload]. The drain position lives in /q/head.
+ * Compaction removes segments once drained. When the queue is full the oldest segment is dropped.
+ *
+ * SPIFFS is mounted on first use, the first publish, so Fast Wake boots do not pay for it before that.
+ */
+
+#define PUBLISH_QUEUE_DIR           "/q/"
+#define PUBLISH_QUEUE_HEAD_FILE     "/q/head"
+#define PUBLISH_QUEUE_SEGMENT_BYTES 4096
+#define PUBLISH_QUEUE_MAX_SEGMENTS  8     //Bounded to 32KB of flash
+
+typedef boolean (*PublishQueueSender)(const char* payload, unsigned int length);
+
+boolean _publishQueueMounted = false;
+boolean _publishQueueEmpty = true;
+uint32_t _publishQueueFirstSegment = 0;  //Segment being drained
+uint32_t _publishQueueLastSegment = 0;   //Segment being appended
+uint32_t _publishQueueHeadOffset = 0;    //Drain position in the first segment
+uint32_t _publishQueueTailBytes = 0;     //Bytes in the last segment
+uint32_t publishQueueDroppedSegments = 0;
+
+void _publishQueueSegmentPath(uint32_t segmentId, char* path){
+  sprintf(path, PUBLISH_QUEUE_DIR "%08lx", (unsigned long)segmentId);
+}
+
+void _publishQueueSaveHead(){
+  File headFile = SPIFFS.open(PUBLISH_QUEUE_HEAD_FILE, "w");
+  if(!headFile) return;
+  headFile.write((const uint8_t*)&_publishQueueFirstSegment, sizeof(_publishQueueFirstSegment));
+  headFile.write((const uint8_t*)&_publishQueueHeadOffset, sizeof(_publishQueueHeadOffset));
+  headFile.close();
+}
+
+void _publishQueueRemoveSegment(uint32_t segmentId){
+  char path[16];
+  _publishQueueSegmentPath(segmentId, path);
+  SPIFFS.remove(path);
+}
+
+//Scans the segments on flash once, after that the queue is tracked in RAM.
+boolean _publishQueueMount(){
+  if(_publishQueueMounted) return true;
+  if(!SPIFFS.begin()){
+    HIVE_LOG_ERROR("QUEUE", "Unable to mount FS.");
+    return false;
+  }
+  boolean foundSegment = false;
+  Dir dir = SPIFFS.openDir(PUBLISH_QUEUE_DIR);
+  while(dir.next()){
+    String fileName = dir.fileName();
+    if(fileName == PUBLISH_QUEUE_HEAD_FILE) continue;
+    uint32_t segmentId = strtoul(fileName.c_str() + strlen(PUBLISH_QUEUE_DIR), NULL, 16);
+    if(!foundSegment || segmentId < _publishQueueFirstSegment) _publishQueueFirstSegment = segmentId;
+    if(!foundSegment || segmentId >= _publishQueueLastSegment){
+      _publishQueueLastSegment = segmentId;
+      _publishQueueTailBytes = dir.fileSize();
+    }
+    foundSegment = true;
+  }
+  _publishQueueHeadOffset = 0;
+  File headFile = SPIFFS.open(PUBLISH_QUEUE_HEAD_FILE, "r");
+  if(headFile){
+    uint32_t headSegment = 0, headOffset = 0;
+    if(headFile.read((uint8_t*)&headSegment, sizeof(headSegment)) == sizeof(headSegment)
+        && headFile.read((uint8_t*)&headOffset, sizeof(headOffset)) == sizeof(headOffset)
+        && foundSegment && headSegment == _publishQueueFirstSegment){
+      _publishQueueHeadOffset = headOffset;
+    }
+    headFile.close();
+  }
+  _publishQueueEmpty = !foundSegment
+    || (_publishQueueFirstSegment == _publishQueueLastSegment && _publishQueueHeadOffset >= _publishQueueTailBytes);
+  _publishQueueMounted = true;
+  if(!_publishQueueEmpty){
+    HIVE_LOG_INFO("QUEUE", "Found queued payloads in segments %lu..%lu",
+      (unsigned long)_publishQueueFirstSegment, (unsigned long)_publishQueueLastSegment);
+  }
+  return true;
+}
+
+//Drops drained segments, and the oldest one when over the limit.
+void _publishQueueCompact(){
+  if(_publishQueueEmpty && _publishQueueTailBytes > 0){
+    _publishQueueRemoveSegment(_publishQueueLastSegment);
+    _publishQueueLastSegment++;
+    _publishQueueFirstSegment = _publishQueueLastSegment;
+    _publishQueueHeadOffset = 0;
+    _publishQueueTailBytes = 0;
+    _publishQueueSaveHead();
+  }
+  while(_publishQueueLastSegment - _publishQueueFirstSegment + 1 > PUBLISH_QUEUE_MAX_SEGMENTS){
+    _publishQueueRemoveSegment(_publishQueueFirstSegment);
+    _publishQueueFirstSegment++;
+    _publishQueueHeadOffset = 0;
+    publishQueueDroppedSegments++;
+    HIVE_LOG_WARN("QUEUE", "Queue full, dropped oldest segment.");
+    _publishQueueSaveHead();
+  }
+}
+
+//Mounts, payloads left on flash by an earlier boot must go out before anything new.
+boolean isPublishQueuePending(){
+  return _publishQueueMount() && !_publishQueueEmpty;
+}
+
+boolean publishQueueAppend(const char* payload, unsigned int length){
+  if(!_publishQueueMount()) return false;
+  if(_publishQueueTailBytes + sizeof(uint16_t) + length > PUBLISH_QUEUE_SEGMENT_BYTES){
+    _publishQueueLastSegment++;
+    _publishQueueTailBytes = 0;
+    _publishQueueCompact();
+  }
+  char path[16];
+  _publishQueueSegmentPath(_publishQueueLastSegment, path);
+  File segment = SPIFFS.open(path, "a");
+  if(!segment){
+    HIVE_LOG_ERROR("QUEUE", "Unable to append to queue segment.");
+    return false;
+  }
+  uint16_t recordLength = length;
+  segment.write((const uint8_t*)&recordLength, sizeof(recordLength));
+  segment.write((const uint8_t*)payload, length);
+  segment.close();
+  _publishQueueTailBytes += sizeof(recordLength) + length;
+  _publishQueueEmpty = false;
+  return true;
+}
+
+/*
+ * Sends up to maxMessages queued payloads in order, stops at the first failed send.
+ * buffer receives each payload, it must fit the largest one appended.
+ */
+int publishQueueDrain(char* buffer, unsigned int bufferSize, PublishQueueSender sender, int maxMessages){
+  if(!_publishQueueMount() || _publishQueueEmpty) return 0;
+  int sent = 0;
+  while(sent < maxMessages && !_publishQueueEmpty){
+    char path[16];
+    _publishQueueSegmentPath(_publishQueueFirstSegment, path);
+    File segment = SPIFFS.open(path, "r");
+    uint16_t recordLength = 0;
+    boolean haveRecord = segment
+      && segment.seek(_publishQueueHeadOffset, SeekSet)
+      && segment.read((uint8_t*)&recordLength, sizeof(recordLength)) == sizeof(recordLength)
+      && recordLength < bufferSize
+      && segment.read((uint8_t*)buffer, recordLength) == recordLength;
+    if(segment) segment.close();
+    if(!haveRecord){
+      //End of segment (or a torn write), move on to the next one.
+      if(_publishQueueFirstSegment == _publishQueueLastSegment){
+        _publishQueueEmpty = true;
+      }else{
+        _publishQueueRemoveSegment(_publishQueueFirstSegment);
+        _publishQueueFirstSegment++;
+        _publishQueueHeadOffset = 0;
+      }
+      continue;
+    }
+    buffer[recordLength] = '\0';
+    if(!sender(buffer, recordLength)) break;
+    _publishQueueHeadOffset += sizeof(recordLength) + recordLength;
+    sent++;
+    if(_publishQueueFirstSegment == _publishQueueLastSegment && _publishQueueHeadOffset >= _publishQueueTailBytes){
+      _publishQueueEmpty = true;
+    }
+  }
+  if(_publishQueueEmpty) _publishQueueCompact();
+  else if(sent > 0) _publishQueueSaveHead();
+  return sent;
+}
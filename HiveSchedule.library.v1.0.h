@@ -0,0 +1,265 @@
+/*
+ * HiveSchedule, instructions sent ahead of time and run by the bot at their wall time.
+ *   {"instrId":42,"command":"IRAC_OFF","schedule":"1760684400","execute":"false"}
+ * schedule is UTC unix seconds. A whole day can come in one message. Entries run whether the
+ * bot is connected or not, the ack is queued like any other payload when it is not.
+ *
+ * Wire change: before HiveSchedule an instruction without execute "true" was ignored. Now one
+ * with a schedule at or past SCHEDULE_CLOCK_VALID (HiveConnector) is scheduled, a missing, zero
+ * or smaller schedule is still ignored, so HiveCentral builds without schedules are unaffected.
+ *
+ * Hashed timer wheel: SCHEDULE_WHEEL_SLOTS slots of one second, an entry waits in slot
+ * dueAt % slots and fires on the pass where its dueAt has come, so each second only one short
+ * list is looked at. Bounded to SCHEDULE_MAX_ENTRIES and kept in RAM, too big for RTC memory.
+ * Before DeepSleep or a REBOOT saveHiveSchedule() writes it to SCHEDULE_FILE when it changed,
+ * the next boot reads it back once connected, and a DeepSleep with entries pending is cut
+ * short to wake by the next one with the radio on (scheduleDeepSleepSecs()). CatchupPostBootup
+ * sends pending ones again too, the executed cache stops a second run.
+ *
+ * Wall time comes from NTP through hiveWallClock, test/HiveScheduleTest.cpp points it at a stand-in clock.
+ */
+
+#define SCHEDULE_MAX_ENTRIES   16
+#define SCHEDULE_WHEEL_SLOTS   64  //Power of two
+#define SCHEDULE_COMMAND_MAX   24
+#define SCHEDULE_PARAMS_MAX    48
+#define SCHEDULE_MAX_LATE_SECS 600 //Missed by more than this (asleep, no clock) it is reported failed, not run
+#define SCHEDULE_NTP_SERVER_1  "pool.ntp.org"
+#define SCHEDULE_NTP_SERVER_2  "time.nist.gov"
+#define SCHEDULE_NONE          0xFF
+#define SCHEDULE_FILE          "/schedule"
+#define SCHEDULE_FILE_MAGIC    0x48534331UL // "HSC1"
+
+typedef uint32_t (*HiveWallClock)();
+
+struct ScheduledInstruction {
+  int32_t instrId;         //0 when the entry is free
+  uint32_t dueAt;
+  uint8_t next;            //Next entry in the same slot, or in the free list
+  char command[SCHEDULE_COMMAND_MAX];
+  char params[SCHEDULE_PARAMS_MAX];
+};
+
+ScheduledInstruction _scheduleEntries[SCHEDULE_MAX_ENTRIES];
+uint8_t _scheduleWheel[SCHEDULE_WHEEL_SLOTS]; //First entry of each slot
+uint8_t _scheduleFree = SCHEDULE_NONE;
+uint8_t scheduledInstructionCount = 0;
+uint32_t _scheduleLastTickAt = 0;             //Wall time of the last slot visited
+boolean _scheduleChanged = false;             //Entries differ from SCHEDULE_FILE
+boolean _scheduleLoaded = false;
+
+//SCHEDULE_FILE, this then count entries as they are in RAM.
+struct ScheduleFileHeader {
+  uint32_t crc;         //Over everything after this field and the entries
+  uint32_t magic;
+  uint8_t count;
+  uint8_t reserved[3];
+};
+
+//UTC seconds, 0 until NTP has synced, time() counts from 1970 until then.
+uint32_t _ntpWallClock(){
+  time_t now = time(nullptr);
+  return now >= (time_t)SCHEDULE_CLOCK_VALID ? (uint32_t)now : 0;
+}
+HiveWallClock hiveWallClock = _ntpWallClock;
+
+void resetHiveSchedule(){
+  memset(_scheduleEntries, 0, sizeof(_scheduleEntries));
+  memset(_scheduleWheel, SCHEDULE_NONE, sizeof(_scheduleWheel));
+  for(int i=0;i<SCHEDULE_MAX_ENTRIES;i++){
+    _scheduleEntries[i].next = i + 1 < SCHEDULE_MAX_ENTRIES ? i + 1 : SCHEDULE_NONE;
+  }
+  _scheduleFree = 0;
+  scheduledInstructionCount = 0;
+  _scheduleLastTickAt = 0;
+  _scheduleChanged = false;
+}
+
+void setupHiveSchedule(){
+  configTime(0, 0, SCHEDULE_NTP_SERVER_1, SCHEDULE_NTP_SERVER_2);
+  resetHiveSchedule();
+  _scheduleLoaded = false;
+}
+
+boolean isInstructionScheduled(long instrId){
+  for(int i=0;i<SCHEDULE_MAX_ENTRIES;i++){
+    if(_scheduleEntries[i].instrId == instrId) return true;
+  }
+  return false;
+}
+
+//False when it can not be taken, the caller reports it failed.
+boolean scheduleInstruction(long instrId, const char* command, const char* params, uint32_t dueAt){
+  if(instrId <= 0 || dueAt == 0){
+    HIVE_LOG_ERROR("SCHEDULE", "No instrId or schedule, not scheduled:%s", command);
+    return false;
+  }
+  //CatchupPostBootup sends it again on every connect, also after it ran.
+  if(isInstructionScheduled(instrId) || ackIfInstructionExecuted(instrId, command)) return true;
+  if(strlen(command) >= SCHEDULE_COMMAND_MAX || strlen(params) >= SCHEDULE_PARAMS_MAX){
+    HIVE_LOG_ERROR("SCHEDULE", "Command or params too long, not scheduled:%s", command);
+    return false;
+  }
+  if(_scheduleFree == SCHEDULE_NONE){
+    HIVE_LOG_ERROR("SCHEDULE", "Schedule full, not scheduled:%s InstructionId:%ld", command, instrId);
+    return false;
+  }
+  uint8_t entry = _scheduleFree;
+  _scheduleFree = _scheduleEntries[entry].next;
+  _scheduleEntries[entry].instrId = instrId;
+  _scheduleEntries[entry].dueAt = dueAt;
+  strcpy(_scheduleEntries[entry].command, command);
+  strcpy(_scheduleEntries[entry].params, params);
+  //Already due, into the next slot to be visited.
+  uint32_t slotAt = _scheduleLastTickAt != 0 && dueAt <= _scheduleLastTickAt ? _scheduleLastTickAt + 1 : dueAt;
+  uint8_t slot = slotAt & (SCHEDULE_WHEEL_SLOTS - 1);
+  _scheduleEntries[entry].next = _scheduleWheel[slot];
+  _scheduleWheel[slot] = entry;
+  scheduledInstructionCount++;
+  _scheduleChanged = true;
+  HIVE_LOG_DEBUG("SCHEDULE", "%s at %lu. InstructionId:%ld", command, (unsigned long)dueAt, instrId);
+  return true;
+}
+
+void _runScheduledInstruction(ScheduledInstruction& scheduled, uint32_t now){
+  //Ran before it was sent again, already done is not missed.
+  if(ackIfInstructionExecuted(scheduled.instrId, scheduled.command)) return;
+  if(now - scheduled.dueAt > SCHEDULE_MAX_LATE_SECS){
+    HIVE_LOG_WARN("SCHEDULE", "Missed by %lus, not run:%s InstructionId:%ld",
+      (unsigned long)(now - scheduled.dueAt), scheduled.command, (long)scheduled.instrId);
+    publishInstructionResult(DATATYPE_INSTRUCTION_EXEFAILED, scheduled.instrId, scheduled.command);
+    return;
+  }
+  callbackInstructionRecieved(scheduled.instrId, scheduled.command, scheduled.params);
+}
+
+//Fires what is due in one slot. Unlinked and freed before it runs, a REBOOT does not return.
+void _visitScheduleSlot(uint8_t slot, uint32_t now){
+  uint8_t* link = &_scheduleWheel[slot];
+  while(*link != SCHEDULE_NONE){
+    uint8_t entry = *link;
+    if(_scheduleEntries[entry].dueAt > now){
+      link = &_scheduleEntries[entry].next; //A later turn of the wheel.
+      continue;
+    }
+    ScheduledInstruction scheduled = _scheduleEntries[entry];
+    *link = scheduled.next;
+    _scheduleEntries[entry].instrId = 0;
+    _scheduleEntries[entry].next = _scheduleFree;
+    _scheduleFree = entry;
+    scheduledInstructionCount--;
+    _scheduleChanged = true;
+    _runScheduledInstruction(scheduled, now);
+  }
+}
+
+uint32_t _scheduleFileCrc(const ScheduleFileHeader& header){
+  uint32_t crc = hiveCrc32((const uint8_t*)&header + sizeof(header.crc), sizeof(header) - sizeof(header.crc));
+  for(int i=0;i<SCHEDULE_MAX_ENTRIES;i++){
+    if(_scheduleEntries[i].instrId != 0) crc = hiveCrc32((const uint8_t*)&_scheduleEntries[i], sizeof(ScheduledInstruction), crc);
+  }
+  return crc;
+}
+
+//Flash copy for the boot after DeepSleep or a REBOOT, call right before ESP.deepSleep().
+void saveHiveSchedule(){
+  if(!_scheduleChanged) return;
+  _scheduleChanged = false;
+  if(!SPIFFS.begin()){
+    HIVE_LOG_ERROR("SCHEDULE", "Unable to save the schedule.");
+    return;
+  }
+  if(scheduledInstructionCount == 0){
+    SPIFFS.remove(SCHEDULE_FILE);
+    return;
+  }
+  ScheduleFileHeader header;
+  memset(&header, 0, sizeof(header));
+  header.magic = SCHEDULE_FILE_MAGIC;
+  header.count = scheduledInstructionCount;
+  header.crc = _scheduleFileCrc(header);
+  File scheduleFile = SPIFFS.open(SCHEDULE_FILE, "w");
+  if(!scheduleFile){
+    HIVE_LOG_ERROR("SCHEDULE", "Unable to save the schedule.");
+    return;
+  }
+  scheduleFile.write((const uint8_t*)&header, sizeof(header));
+  for(int i=0;i<SCHEDULE_MAX_ENTRIES;i++){
+    if(_scheduleEntries[i].instrId != 0) scheduleFile.write((const uint8_t*)&_scheduleEntries[i], sizeof(ScheduledInstruction));
+  }
+  scheduleFile.close();
+}
+
+//Entries saved before the last DeepSleep or REBOOT, checked whole before any is taken.
+void _loadHiveSchedule(){
+  _scheduleLoaded = true;
+  if(!SPIFFS.begin()) return;
+  File scheduleFile = SPIFFS.open(SCHEDULE_FILE, "r");
+  if(!scheduleFile) return;
+  ScheduleFileHeader header;
+  ScheduledInstruction entry;
+  boolean valid = scheduleFile.read((uint8_t*)&header, sizeof(header)) == sizeof(header)
+      && header.magic == SCHEDULE_FILE_MAGIC && header.count <= SCHEDULE_MAX_ENTRIES
+      && scheduleFile.size() == sizeof(header) + header.count * sizeof(ScheduledInstruction);
+  uint32_t crc = hiveCrc32((const uint8_t*)&header + sizeof(header.crc), sizeof(header) - sizeof(header.crc));
+  for(int i=0;valid && i<header.count;i++){
+    scheduleFile.read((uint8_t*)&entry, sizeof(entry));
+    crc = hiveCrc32((const uint8_t*)&entry, sizeof(entry), crc);
+  }
+  if(!valid || crc != header.crc){
+    scheduleFile.close();
+    HIVE_LOG_ERROR("SCHEDULE", "Saved schedule is corrupt, dropped.");
+    SPIFFS.remove(SCHEDULE_FILE);
+    return;
+  }
+  scheduleFile.seek(sizeof(header));
+  for(int i=0;i<header.count;i++){
+    scheduleFile.read((uint8_t*)&entry, sizeof(entry));
+    entry.command[SCHEDULE_COMMAND_MAX - 1] = '\0';
+    entry.params[SCHEDULE_PARAMS_MAX - 1] = '\0';
+    scheduleInstruction(entry.instrId, entry.command, entry.params, entry.dueAt);
+  }
+  scheduleFile.close();
+  HIVE_LOG_DEBUG("SCHEDULE", "Restored from flash:%d", header.count);
+}
+
+//Seconds until the next entry is due, 0 when one is. UINT32_MAX with none or without wall time.
+uint32_t secsUntilNextScheduled(){
+  uint32_t now = hiveWallClock();
+  if(scheduledInstructionCount == 0 || now == 0) return UINT32_MAX;
+  uint32_t secs = UINT32_MAX;
+  for(int i=0;i<SCHEDULE_MAX_ENTRIES;i++){
+    if(_scheduleEntries[i].instrId == 0) continue;
+    uint32_t dueAt = _scheduleEntries[i].dueAt;
+    uint32_t dueInSecs = dueAt > now ? dueAt - now : 0;
+    if(dueInSecs < secs) secs = dueInSecs;
+  }
+  return secs;
+}
+
+//DeepSleep with entries pending wakes by the next one, the radio on for NTP and the ack.
+uint32_t scheduleDeepSleepSecs(uint32_t sleepSecs, boolean& radioOnNextWake){
+  if(scheduledInstructionCount == 0) return sleepSecs;
+  radioOnNextWake = true;
+  uint32_t dueInSecs = secsUntilNextScheduled();
+  if(dueInSecs >= sleepSecs) return sleepSecs;
+  return dueInSecs > 0 ? dueInSecs : 1;
+}
+
+//Call every pass of loop(), connected or not. Visits the slots of the seconds since the last call.
+void pollScheduledInstructions(){
+  //Once connected, the wall time needs NTP anyway and a fast wake mounts SPIFFS after its first publish.
+  if(!_scheduleLoaded && isHiveConnected()) _loadHiveSchedule();
+  if(scheduledInstructionCount == 0) return;
+  uint32_t now = hiveWallClock();
+  if(now == 0) return; //No wall time yet.
+  //Every slot once covers any gap, the first pass and a clock set back.
+  uint32_t ticks = SCHEDULE_WHEEL_SLOTS;
+  if(_scheduleLastTickAt != 0 && now >= _scheduleLastTickAt && now - _scheduleLastTickAt < ticks){
+    ticks = now - _scheduleLastTickAt;
+  }
+  _scheduleLastTickAt = now;
+  for(uint32_t tick=now - ticks + 1; tick != now + 1; tick++){
+    _visitScheduleSlot(tick & (SCHEDULE_WHEEL_SLOTS - 1), now);
+  }
+}
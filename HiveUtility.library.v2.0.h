@@ -1,6 +1,7 @@
 /*
  * EventTimer allow you schedule Event recuring for a specified time.
  */
+#define EVENT_TIMER_NEVER_DUE 0xFFFFFFFFUL
 
 class EventTimer
 {
@@ -14,8 +15,10 @@ class EventTimer
   public:
     EventTimer(String timerName, long freqMillSecs, boolean is_enabled, boolean runFromBootupOrLastRunIfConnectedOrEnabled);
     boolean isDueForRun();
+    unsigned long msUntilDue();
     long runCounts();
     boolean enabled(boolean is_enabled);
+    boolean isEnabled();
     int runFrequency();
 };
 
@@ -44,26 +47,30 @@ boolean EventTimer::enabled(boolean is_enabled){
   }
   return this->_isenabled;
 }
+boolean EventTimer::isEnabled(){
+  return this->_isenabled;
+}
+/*
+ * Time left before the timer is due, 0 when due now.
+ * Uses elapsed time (unsigned subtraction) so it stays correct across the millis() wraparound (~49 days).
+ */
+unsigned long EventTimer::msUntilDue(){
+  if(!this->_isenabled) return EVENT_TIMER_NEVER_DUE;
+  unsigned long elapsedMS = millis() - this->_lastEventAtMs;
+  if(elapsedMS >= (unsigned long)this->_evenFreqMilliSecs) return 0;
+  return (unsigned long)this->_evenFreqMilliSecs - elapsedMS;
+}
 boolean EventTimer::isDueForRun(){
   if(!this->_isenabled) return false;
   unsigned long currenttMS =millis();
-  signed long timeRemaining =  (this->_lastEventAtMs + this->_evenFreqMilliSecs ) - currenttMS;
+  unsigned long timeRemaining = this->msUntilDue();
   /* Enable for Debugging 
   if(this->_timerName.indexOf("#")<0){ //Debug Information if it does not have #
-    Serial.print("DEBUG: [EVENT_TIMER] (ms)" );
-    Serial.print(this->_timerName);
-    Serial.print(" TimeRemaining(s ");
-    Serial.print(String(timeRemaining/1000));
-    Serial.print("), LastRunAt( ");
-    Serial.print(String((this->_lastEventAtMs)));
-    Serial.print("), CurrTime( ");
-    Serial.print(String(currenttMS));
-    Serial.print("), interval(s  ");
-    Serial.print(String(this->_evenFreqMilliSecs/1000));
-    Serial.println(")");
+    HIVE_LOG_DEBUG("EVENT_TIMER", "(ms)%s TimeRemaining(s %lu), LastRunAt( %lu), CurrTime( %lu), interval(s  %d)",
+      this->_timerName.c_str(), timeRemaining/1000, this->_lastEventAtMs, currenttMS, this->_evenFreqMilliSecs/1000);
   }
   */
-  if (timeRemaining<=0){
+  if (timeRemaining==0){
     this->counter++;
     this->_lastEventAtMs =currenttMS;
     return true;
@@ -72,6 +79,112 @@ boolean EventTimer::isDueForRun(){
   }
 }
 
+/*
+ * EventScheduler runs EventTimer tasks ordered by their next deadline.
+ * Every due task runs in the same pass, then the CPU idles until the next deadline
+ * instead of polling every timer on a fixed delay.
+ * Idle is capped by maxIdleMs so network clients (MQTT loop, keepalive) still get serviced.
+ */
+#define EVENT_SCHEDULER_MAX_TASKS 8
+typedef void (*EventTask)();
+
+class EventScheduler
+{
+  private:
+    EventTimer* _timers[EVENT_SCHEDULER_MAX_TASKS];
+    EventTask _tasks[EVENT_SCHEDULER_MAX_TASKS];
+    unsigned long _untilDueMs[EVENT_SCHEDULER_MAX_TASKS];
+    unsigned char _byDeadline[EVENT_SCHEDULER_MAX_TASKS];
+    int _taskCount = 0;
+    long _wakeups = 0;
+    void _orderByDeadline();
+  public:
+    boolean addTask(EventTimer* timer, EventTask task);
+    int runDueTasks();
+    unsigned long msUntilNextDue();
+    unsigned long sleepUntilNextDue(unsigned long maxIdleMs);
+    unsigned long sleepFor(unsigned long sleepMs, unsigned long maxIdleMs);
+    long wakeupCounts();
+};
+
+boolean EventScheduler::addTask(EventTimer* timer, EventTask task){
+  if(this->_taskCount >= EVENT_SCHEDULER_MAX_TASKS) return false;
+  this->_timers[this->_taskCount] = timer;
+  this->_tasks[this->_taskCount] = task;
+  this->_taskCount++;
+  return true;
+}
+//Insertion Sort over task indexes, stable and the tasks stay as added, so tasks due at the same time run in the order they were added in.
+void EventScheduler::_orderByDeadline(){
+  for(int i=0;i<this->_taskCount;i++){
+    this->_untilDueMs[i] = this->_timers[i]->msUntilDue();
+    this->_byDeadline[i] = i;
+  }
+  for(int i=1;i<this->_taskCount;i++){
+    int task = this->_byDeadline[i];
+    int j = i - 1;
+    while(j>=0 && this->_untilDueMs[this->_byDeadline[j]] > this->_untilDueMs[task]){
+      this->_byDeadline[j+1] = this->_byDeadline[j];
+      j--;
+    }
+    this->_byDeadline[j+1] = task;
+  }
+}
+int EventScheduler::runDueTasks(){
+  this->_orderByDeadline();
+  int ranTasks = 0;
+  for(int i=0;i<this->_taskCount;i++){
+    int task = this->_byDeadline[i];
+    if(this->_untilDueMs[task] > 0) break; //Ordered, nothing else is due.
+    //Re-check, a task run earlier in this pass may have disabled this one.
+    if(this->_timers[task]->isDueForRun()){
+      this->_tasks[task]();
+      ranTasks++;
+    }
+  }
+  return ranTasks;
+}
+unsigned long EventScheduler::msUntilNextDue(){
+  unsigned long nextDueMs = EVENT_TIMER_NEVER_DUE;
+  for(int i=0;i<this->_taskCount;i++){
+    unsigned long untilDueMs = this->_timers[i]->msUntilDue();
+    if(untilDueMs < nextDueMs) nextDueMs = untilDueMs;
+  }
+  return nextDueMs;
+}
+/*
+ * delay() lets the ESP8266 drop into (light/modem) sleep as set by WiFi.setSleepMode.
+ * Returns the time slept.
+ */
+unsigned long EventScheduler::sleepUntilNextDue(unsigned long maxIdleMs){
+  return this->sleepFor(this->msUntilNextDue(), maxIdleMs);
+}
+//For when the due tasks are held back (offline), their deadlines would keep the CPU spinning.
+unsigned long EventScheduler::sleepFor(unsigned long sleepMs, unsigned long maxIdleMs){
+  if(sleepMs > maxIdleMs) sleepMs = maxIdleMs;
+  if(sleepMs > 0) delay(sleepMs);
+  this->_wakeups++;
+  return sleepMs;
+}
+long EventScheduler::wakeupCounts(){
+  return this->_wakeups;
+}
+
+/*
+ * CRC32 (IEEE, reflected), for checking state kept in RTC memory or flash.
+ * Bitwise, no table in RAM, the blocks we check are small.
+ */
+uint32_t hiveCrc32(const uint8_t* data, size_t length, uint32_t crc = 0){
+  crc = ~crc;
+  while(length--){
+    crc ^= *data++;
+    for(int bit=0;bit<8;bit++){
+      crc = (crc >> 1) ^ (0xEDB88320UL & (0UL - (crc & 1)));
+    }
+  }
+  return ~crc;
+}
+
 /* Piezo Beepers */
 #define PIEZO_TRANSDUCER_PIN D5  //cet12a35
 
@@ -154,7 +154,425 @@ String describeACInfo(decode_results *results) {
   }
 }
 
-IRKelvinatorAC kelvir(IR_SEND_PIN);  // An IR LED is controlled by GPIO4, NodeMCU D2
+/*
+ * Aircon Drivers, the transmit side for one brand, picked at build time:
+ *   -DAIRCON_BRAND=AIRCON_DAIKIN
+ * Only the selected driver is compiled, its remote is the only one in RAM and every call
+ * resolves at compile time. A driver is a type with:
+ *   MIN_TEMP, MAX_TEMP, STATE_LENGTH                                       //Celsius, most bytes of a state
+ *   static int8_t mode(uint8_t mode);                                      //Brand mode of an AIRCON_MODE_, -1 when it has none
+ *   static uint8_t encode(const AirconSettings& settings, uint8_t* state); //Library encoder, returns the length
+ *   static void begin();
+ *   static void send(const uint8_t* state, uint8_t length);
+ * Settings are brand neutral: Celsius, AIRCON_MODE_ and fan 0 (auto) .. AIRCON_FAN_MAX.
+ */
+#define AIRCON_KELVINATOR 1
+#define AIRCON_DAIKIN     2
+#define AIRCON_FUJITSU    3
+#define AIRCON_TOSHIBA    4
+#define AIRCON_MIDEA      5
+#ifndef AIRCON_BRAND
+#define AIRCON_BRAND      AIRCON_KELVINATOR
+#endif
+
+enum AirconMode {
+  AIRCON_MODE_AUTO,
+  AIRCON_MODE_COOL,
+  AIRCON_MODE_DRY,
+  AIRCON_MODE_FAN,
+  AIRCON_MODE_HEAT,
+  AIRCON_MODE_COUNT
+};
+#define AIRCON_FAN_MAX 5
+
+struct AirconSettings {
+  uint8_t power;
+  uint8_t temp;
+  uint8_t mode;  //AIRCON_MODE_
+  uint8_t fan;
+};
+
+//The one remote that sends, and send() for remotes that take their state as a byte array.
+template<typename Remote> struct AirconTransmitter {
+  static Remote remote;
+  static void begin(){
+    remote.begin();
+  }
+  static void send(const uint8_t* state, uint8_t length){
+    remote.setRaw((uint8_t*)state);
+    remote.send();
+  }
+};
+template<typename Remote> Remote AirconTransmitter<Remote>::remote(IR_SEND_PIN);
+
+#if AIRCON_BRAND == AIRCON_KELVINATOR
+struct KelvinatorAircon : AirconTransmitter<IRKelvinatorAC> {
+  enum { MIN_TEMP = KELVINATOR_MIN_TEMP, MAX_TEMP = KELVINATOR_MAX_TEMP, STATE_LENGTH = KELVINATOR_STATE_LENGTH };
+  static int8_t mode(uint8_t mode){
+    static const int8_t modes[AIRCON_MODE_COUNT] = {KELVINATOR_AUTO, KELVINATOR_COOL, KELVINATOR_DRY, KELVINATOR_FAN, KELVINATOR_HEAT};
+    return mode < AIRCON_MODE_COUNT ? modes[mode] : -1;
+  }
+  static uint8_t encode(const AirconSettings& settings, uint8_t* state){
+    IRKelvinatorAC encoder(IR_SEND_PIN); //Never sends
+    if(!settings.power){
+      encoder.setFan(0);
+      encoder.setLight(true);
+      encoder.setMode(KELVINATOR_AUTO);
+      encoder.off();
+    }else{
+      encoder.on();
+      encoder.setFan(settings.fan);
+      encoder.setMode(mode(settings.mode));
+      encoder.setTemp(settings.temp);
+      encoder.setSwingVertical(false);
+      encoder.setSwingHorizontal(true);
+      encoder.setXFan(true);
+      encoder.setIonFilter(false);
+      encoder.setLight(true);
+    }
+    memcpy(state, encoder.getRaw(), STATE_LENGTH); //getRaw() fixes the checksum
+    return STATE_LENGTH;
+  }
+};
+typedef KelvinatorAircon AirconDriver;
+
+#elif AIRCON_BRAND == AIRCON_DAIKIN
+struct DaikinAircon : AirconTransmitter<IRDaikinESP> {
+  enum { MIN_TEMP = DAIKIN_MIN_TEMP, MAX_TEMP = DAIKIN_MAX_TEMP, STATE_LENGTH = DAIKIN_COMMAND_LENGTH };
+  static int8_t mode(uint8_t mode){
+    static const int8_t modes[AIRCON_MODE_COUNT] = {DAIKIN_AUTO, DAIKIN_COOL, DAIKIN_DRY, DAIKIN_FAN, DAIKIN_HEAT};
+    return mode < AIRCON_MODE_COUNT ? modes[mode] : -1;
+  }
+  static uint8_t encode(const AirconSettings& settings, uint8_t* state){
+    IRDaikinESP encoder(IR_SEND_PIN);
+    encoder.setMode(mode(settings.mode));
+    encoder.setTemp(settings.temp);
+    encoder.setFan(settings.fan == 0 ? DAIKIN_FAN_AUTO : settings.fan); //1..5 as is
+    encoder.setSwingVertical(false);
+    encoder.setSwingHorizontal(true);
+    if(settings.power) encoder.on(); else encoder.off();
+    memcpy(state, encoder.getRaw(), STATE_LENGTH);
+    return STATE_LENGTH;
+  }
+};
+typedef DaikinAircon AirconDriver;
+
+#elif AIRCON_BRAND == AIRCON_FUJITSU
+//Off is a short state, setRaw() takes the length.
+struct FujitsuAircon : AirconTransmitter<IRFujitsuAC> {
+  enum { MIN_TEMP = FUJITSU_AC_MIN_TEMP, MAX_TEMP = FUJITSU_AC_MAX_TEMP, STATE_LENGTH = FUJITSU_AC_STATE_LENGTH };
+  static int8_t mode(uint8_t mode){
+    static const int8_t modes[AIRCON_MODE_COUNT] = {FUJITSU_AC_MODE_AUTO, FUJITSU_AC_MODE_COOL, FUJITSU_AC_MODE_DRY, FUJITSU_AC_MODE_FAN, FUJITSU_AC_MODE_HEAT};
+    return mode < AIRCON_MODE_COUNT ? modes[mode] : -1;
+  }
+  static uint8_t encode(const AirconSettings& settings, uint8_t* state){
+    //Fujitsu counts down from HIGH to QUIET.
+    static const uint8_t fans[AIRCON_FAN_MAX + 1] = {FUJITSU_AC_FAN_AUTO, FUJITSU_AC_FAN_QUIET, FUJITSU_AC_FAN_LOW,
+      FUJITSU_AC_FAN_MED, FUJITSU_AC_FAN_HIGH, FUJITSU_AC_FAN_HIGH};
+    IRFujitsuAC encoder(IR_SEND_PIN);
+    if(!settings.power){
+      encoder.off();
+    }else{
+      encoder.setCmd(FUJITSU_AC_CMD_TURN_ON);
+      encoder.setMode(mode(settings.mode));
+      encoder.setTemp(settings.temp);
+      encoder.setFanSpeed(fans[settings.fan]);
+    }
+    uint8_t length = encoder.getStateLength();
+    memcpy(state, encoder.getRaw(), length);
+    return length;
+  }
+  static void send(const uint8_t* state, uint8_t length){
+    remote.setRaw((uint8_t*)state, length);
+    remote.send();
+  }
+};
+typedef FujitsuAircon AirconDriver;
+
+#elif AIRCON_BRAND == AIRCON_TOSHIBA
+//No fan only mode.
+struct ToshibaAircon : AirconTransmitter<IRToshibaAC> {
+  enum { MIN_TEMP = TOSHIBA_AC_MIN_TEMP, MAX_TEMP = TOSHIBA_AC_MAX_TEMP, STATE_LENGTH = TOSHIBA_AC_STATE_LENGTH };
+  static int8_t mode(uint8_t mode){
+    static const int8_t modes[AIRCON_MODE_COUNT] = {TOSHIBA_AC_AUTO, TOSHIBA_AC_COOL, TOSHIBA_AC_DRY, -1, TOSHIBA_AC_HEAT};
+    return mode < AIRCON_MODE_COUNT ? modes[mode] : -1;
+  }
+  static uint8_t encode(const AirconSettings& settings, uint8_t* state){
+    IRToshibaAC encoder(IR_SEND_PIN);
+    encoder.setMode(mode(settings.mode));
+    encoder.setTemp(settings.temp);
+    encoder.setFan(settings.fan); //0 auto, 1..5 as is
+    if(settings.power) encoder.on(); else encoder.off();
+    memcpy(state, encoder.getRaw(), STATE_LENGTH);
+    return STATE_LENGTH;
+  }
+};
+typedef ToshibaAircon AirconDriver;
+
+#elif AIRCON_BRAND == AIRCON_MIDEA
+//The state is a uint64_t, kept as its bytes.
+struct MideaAircon : AirconTransmitter<IRMideaAC> {
+  enum { MIN_TEMP = MIDEA_AC_MIN_TEMP_C, MAX_TEMP = MIDEA_AC_MAX_TEMP_C, STATE_LENGTH = sizeof(uint64_t) };
+  static int8_t mode(uint8_t mode){
+    static const int8_t modes[AIRCON_MODE_COUNT] = {MIDEA_AC_AUTO, MIDEA_AC_COOL, MIDEA_AC_DRY, MIDEA_AC_FAN, MIDEA_AC_HEAT};
+    return mode < AIRCON_MODE_COUNT ? modes[mode] : -1;
+  }
+  static uint8_t encode(const AirconSettings& settings, uint8_t* state){
+    static const uint8_t fans[AIRCON_FAN_MAX + 1] = {MIDEA_AC_FAN_AUTO, MIDEA_AC_FAN_LOW, MIDEA_AC_FAN_LOW,
+      MIDEA_AC_FAN_MED, MIDEA_AC_FAN_HI, MIDEA_AC_FAN_HI};
+    IRMideaAC encoder(IR_SEND_PIN);
+    encoder.setMode(mode(settings.mode));
+    encoder.setTemp(settings.temp, true);
+    encoder.setFan(fans[settings.fan]);
+    if(settings.power) encoder.on(); else encoder.off();
+    uint64_t raw = encoder.getRaw();
+    memcpy(state, &raw, STATE_LENGTH);
+    return STATE_LENGTH;
+  }
+  static void send(const uint8_t* state, uint8_t length){
+    uint64_t raw;
+    memcpy(&raw, state, STATE_LENGTH);
+    remote.setRaw(raw);
+    remote.send();
+  }
+};
+typedef MideaAircon AirconDriver;
+
+#else
+#error "AIRCON_BRAND is not one of AIRCON_KELVINATOR, AIRCON_DAIKIN, AIRCON_FUJITSU, AIRCON_TOSHIBA, AIRCON_MIDEA"
+#endif
+
+/*
+ * Aircon Profiles, the state bytes of each profile encoded ahead of time by the AirconDriver.
+ * Applying one is a copy into the remote and send(), nothing is encoded on the command path.
+ * Profiles 0..3 (OFF, A, B, C) are built in, HiveCentral overrides them or adds more
+ * with IRAC_PROFILE, overrides are kept on SPIFFS and encoded again after boot, on first use,
+ * so a Fast Wake boot publishes before SPIFFS is mounted.
+ *   "id=4,power=1,temp=22,mode=COOL,fan=3"  defines profile 4 and applies it
+ *   "id=4,power=1,temp=22,mode=COOL,fan=3,apply=0"  only defines it
+ *   "id=4"  applies it
+ * mode : AUTO, COOL, DRY, FAN, HEAT or the AIRCON_MODE_ number. fan : 0 (auto) .. AIRCON_FAN_MAX
+ */
+#define AIRCON_PROFILE_SLOTS   8
+#define AIRCON_PROFILES_FILE   "/acprofiles"
+#define AIRCON_PROFILES_MAGIC  0x48415031UL // "HAP1"
+
+struct AirconProfile {
+  AirconSettings settings;
+  boolean defined;
+  boolean overridden;      //Pushed by HiveCentral, saved to SPIFFS
+  uint8_t stateLength;
+  uint8_t state[AirconDriver::STATE_LENGTH];
+};
+//Overrides on SPIFFS, settings only.
+struct AirconProfileOverrides {
+  uint32_t magic;
+  uint8_t overridden[AIRCON_PROFILE_SLOTS];
+  AirconSettings settings[AIRCON_PROFILE_SLOTS];
+};
+
+static const AirconSettings airconDefaultProfiles[] PROGMEM = {
+  {false, 26, AIRCON_MODE_COOL, 0}, //0 OFF
+  {true,  24, AIRCON_MODE_COOL, 2}, //1 A
+  {true,  24, AIRCON_MODE_DRY,  2}, //2 B
+  {true,  24, AIRCON_MODE_FAN,  4}, //3 C
+};
+#define AIRCON_DEFAULT_PROFILES (sizeof(airconDefaultProfiles) / sizeof(airconDefaultProfiles[0]))
+
+AirconProfile airconProfiles[AIRCON_PROFILE_SLOTS];
+boolean _airconProfilesLoaded = false;
+int _acProfileId = -1;
+AirconSettings _airconSent = {false, 0, AIRCON_MODE_AUTO, 0}; //Last sent, brand neutral
+boolean airconHaveSwitched = false;     //Power not switched since boot
+unsigned long airconSwitchedAtMs = 0;   //Last power switch, by the thermostat or an IRAC_ instruction
+
+/*
+ * What was sent last survives a DeepSleep or a REBOOT in RTC memory, the A/C does not reboot with
+ * the bot. millis() starts over, so the switch time is kept as the time since it, saved on every
+ * send and before the sleep with the sleep counted. After a crash the time since the last send is
+ * lost and the minimum on / off time only gets longer. Power lost, the boot is a first one.
+ */
+#define AIRCON_SENT_MAGIC 0x48415331UL // "HAS1"
+
+struct AirconSentState {
+  uint32_t crc;           //Over everything after this field
+  uint32_t magic;
+  AirconSettings sent;
+  int8_t acProfileId;
+  uint8_t haveSwitched;
+  uint8_t reserved[2];
+  uint32_t sinceSwitchMs; //At the save, the coming sleep included
+};
+static_assert(sizeof(AirconSentState) % 4 == 0, "RTC memory is read and written in 4 byte blocks");
+
+uint32_t _airconSentCrc(const AirconSentState& state){
+  return hiveCrc32((const uint8_t*)&state + sizeof(state.crc), sizeof(state) - sizeof(state.crc));
+}
+
+//On every send, and right before ESP.deepSleep() with the sleep to come.
+void saveAirconSent(uint32_t sleepSecs){
+  AirconSentState state;
+  memset(&state, 0, sizeof(state));
+  state.magic = AIRCON_SENT_MAGIC;
+  state.sent = _airconSent;
+  state.acProfileId = _acProfileId;
+  state.haveSwitched = airconHaveSwitched;
+  state.sinceSwitchMs = airconHaveSwitched ? millis() - airconSwitchedAtMs + sleepSecs * 1000UL : 0;
+  state.crc = _airconSentCrc(state);
+  ESP.rtcUserMemoryWrite(RTC_AIRCON_SENT_ADDRESS, (uint32_t*)&state, sizeof(state));
+}
+
+void _loadAirconSent(){
+  AirconSentState state;
+  ESP.rtcUserMemoryRead(RTC_AIRCON_SENT_ADDRESS, (uint32_t*)&state, sizeof(state));
+  if(state.magic != AIRCON_SENT_MAGIC || state.crc != _airconSentCrc(state)) return;
+  _airconSent = state.sent;
+  _acProfileId = state.acProfileId;
+  airconHaveSwitched = state.haveSwitched;
+  airconSwitchedAtMs = millis() - state.sinceSwitchMs;
+  HIVE_LOG_DEBUG("IRAC", "Sent before the boot, profile %d Power:%d", _acProfileId, _airconSent.power);
+}
+
+void writeAirconProfileDataMap(HivePayloadWriter& dataMap){
+  dataMap.addString(HF_AcPower, _airconSent.power ? "ON" : "OFF");
+  dataMap.addFixed(HF_AcTemp, _airconSent.temp, 0);
+  dataMap.addFixed(HF_AcMode, _airconSent.mode, 0);
+  dataMap.addFixed(HF_AcFan, _airconSent.fan, 0);
+  dataMap.addFixed(HF_AcProfileId, _acProfileId, 0);
+}
+
+boolean _isAirconSettingsValid(const AirconSettings& settings){
+  return settings.temp >= AirconDriver::MIN_TEMP && settings.temp <= AirconDriver::MAX_TEMP
+      && AirconDriver::mode(settings.mode) >= 0 && settings.fan <= AIRCON_FAN_MAX;
+}
+
+void _encodeAirconProfile(AirconProfile& profile){
+  profile.stateLength = AirconDriver::encode(profile.settings, profile.state);
+  profile.defined = true;
+}
+
+void _saveAirconProfileOverrides(){
+  AirconProfileOverrides overrides;
+  memset(&overrides, 0, sizeof(overrides));
+  overrides.magic = AIRCON_PROFILES_MAGIC;
+  for(int i=0;i<AIRCON_PROFILE_SLOTS;i++){
+    overrides.overridden[i] = airconProfiles[i].overridden;
+    overrides.settings[i] = airconProfiles[i].settings;
+  }
+  File overridesFile;
+  if(SPIFFS.begin()) overridesFile = SPIFFS.open(AIRCON_PROFILES_FILE, "w");
+  if(!overridesFile){
+    HIVE_LOG_ERROR("IRAC", "Unable to save aircon profiles.");
+    return;
+  }
+  overridesFile.write((const uint8_t*)&overrides, sizeof(overrides));
+  overridesFile.close();
+}
+
+//Built-in profiles, then the overrides from SPIFFS, all encoded now.
+void _loadAirconProfiles(){
+  if(_airconProfilesLoaded) return;
+  _airconProfilesLoaded = true;
+  memset(airconProfiles, 0, sizeof(airconProfiles));
+  for(unsigned int i=0;i<AIRCON_DEFAULT_PROFILES;i++){
+    memcpy_P(&airconProfiles[i].settings, &airconDefaultProfiles[i], sizeof(AirconSettings));
+    airconProfiles[i].defined = _isAirconSettingsValid(airconProfiles[i].settings); //C has no FAN mode on some brands
+  }
+  AirconProfileOverrides overrides;
+  File overridesFile;
+  if(SPIFFS.begin()) overridesFile = SPIFFS.open(AIRCON_PROFILES_FILE, "r");
+  if(overridesFile){
+    if(overridesFile.read((uint8_t*)&overrides, sizeof(overrides)) == sizeof(overrides)
+        && overrides.magic == AIRCON_PROFILES_MAGIC){
+      for(int i=0;i<AIRCON_PROFILE_SLOTS;i++){
+        if(!overrides.overridden[i] || !_isAirconSettingsValid(overrides.settings[i])) continue;
+        airconProfiles[i].settings = overrides.settings[i];
+        airconProfiles[i].defined = true;
+        airconProfiles[i].overridden = true;
+      }
+    }
+    overridesFile.close();
+  }
+  for(int i=0;i<AIRCON_PROFILE_SLOTS;i++){
+    if(airconProfiles[i].defined) _encodeAirconProfile(airconProfiles[i]);
+  }
+}
+//Loaded again on first use, what was sent last from RTC memory now.
+void setupAirconProfiles(){
+  _airconProfilesLoaded = false;
+  _loadAirconSent();
+}
+
+//Encodes and keeps it, false when the settings are out of range.
+boolean defineAirconProfile(int acProfileId, const AirconSettings& settings){
+  if(acProfileId < 0 || acProfileId >= AIRCON_PROFILE_SLOTS || !_isAirconSettingsValid(settings)){
+    HIVE_LOG_ERROR("IRAC", "Invalid aircon profile:%d", acProfileId);
+    return false;
+  }
+  _loadAirconProfiles();
+  AirconProfile& profile = airconProfiles[acProfileId];
+  if(profile.defined && memcmp(&profile.settings, &settings, sizeof(settings)) == 0) return true;
+  profile.settings = settings;
+  profile.overridden = true;
+  _encodeAirconProfile(profile);
+  _saveAirconProfileOverrides();
+  HIVE_LOG_DEBUG("IRAC", "Profile %d Power:%d Temp:%d Mode:%d Fan:%d", acProfileId,
+    settings.power, settings.temp, settings.mode, settings.fan);
+  return true;
+}
+
+//Copies the encoded state into the remote and sends it.
+boolean applyAirconProfile(int acProfileId){
+  _loadAirconProfiles();
+  if(acProfileId < 0 || acProfileId >= AIRCON_PROFILE_SLOTS || !airconProfiles[acProfileId].defined){
+    HIVE_LOG_ERROR("IRAC", "No aircon profile:%d", acProfileId);
+    return false;
+  }
+  AirconProfile& profile = airconProfiles[acProfileId];
+  AirconDriver::send(profile.state, profile.stateLength);
+  if(profile.settings.power != _airconSent.power){
+    airconHaveSwitched = true;
+    airconSwitchedAtMs = millis();
+  }
+  _airconSent = profile.settings;
+  _acProfileId = acProfileId;
+  saveAirconSent(0);
+  return true;
+}
+
+uint8_t _airconModeParam(const char* value, uint8_t defaultMode){
+  if(value == NULL) return defaultMode;
+  if(isdigit(*value)) return atoi(value);
+  static const char* const modeNames[AIRCON_MODE_COUNT] = {"AUTO", "COOL", "DRY", "FAN", "HEAT"}; //AIRCON_MODE_ order
+  for(uint8_t mode=0; mode<sizeof(modeNames)/sizeof(modeNames[0]); mode++){
+    size_t nameLength = strlen(modeNames[mode]);
+    if(strncasecmp(value, modeNames[mode], nameLength) == 0 && (value[nameLength] == ',' || value[nameLength] == '\0')){
+      return mode;
+    }
+  }
+  return 0xFF; //Rejected by _isAirconSettingsValid
+}
+
+//IRAC_PROFILE params, see above. Settings left out keep the profile's current ones.
+boolean airconProfileFromParams(const char* params){
+  int acProfileId = instructionParamLong(params, "id", -1);
+  if(acProfileId < 0 || acProfileId >= AIRCON_PROFILE_SLOTS) return false;
+  _loadAirconProfiles();
+  const AirconSettings& current = airconProfiles[acProfileId].settings;
+  boolean defines = findInstructionParam(params, "power") != NULL || findInstructionParam(params, "temp") != NULL
+    || findInstructionParam(params, "mode") != NULL || findInstructionParam(params, "fan") != NULL;
+  if(defines){
+    AirconSettings settings;
+    settings.power = instructionParamLong(params, "power", current.power) != 0;
+    settings.temp = instructionParamLong(params, "temp", current.temp);
+    settings.mode = _airconModeParam(findInstructionParam(params, "mode"), current.mode);
+    settings.fan = instructionParamLong(params, "fan", current.fan);
+    if(!defineAirconProfile(acProfileId, settings)) return false;
+  }
+  if(instructionParamLong(params, "apply", 1) == 0) return true;
+  return applyAirconProfile(acProfileId);
+}
+
 void setupIRModule(){
   #if DECODE_HASH
       // Ignore messages with less than minimum on or off pulses.
@@ -163,124 +581,175 @@ void setupIRModule(){
   irrecv.enableIRIn(); 
   //irsend.begin();
 
-  //Initilize IR Settings for Kelvinator
-  kelvir.begin();
-
+  AirconDriver::begin();
+  setupAirconProfiles();
 }
 
+
 /*
- * mode : KELVINATOR_AUTO, KELVINATOR_COOL, KELVINATOR_HEAT, KELVINATOR_DRY, KELVINATOR_FAN
+ * IR Receive. IRrecv captures in its interrupt handler, pollIRReceiver() only copies a finished
+ * frame into a small ring. Frames are turned into text and published by the IR task once the
+ * remote goes quiet, so the MQTT client keeps being serviced while listening.
+ * A frame identical to the newest one (a held button, or an A/C remote repeating its state)
+ * only bumps that entry's repeat count.
+ *
+ * With IR_RAW enabled frames go out as protocol id + state bytes instead of describeACInfo() text,
+ * decoding is left to HiveCentral. UNKNOWN frames carry their raw timings, packed at capture:
+ * each timing as the zigzag varint of its difference to the timing two before (mark to mark,
+ * space to space), in RAWTICK units, rawbuf[0] (the gap before the frame) skipped.
  */
-int _acProfileId = -1;
-String getAirconfProfileDataMap(){
-  String dataMap =  "\"AcPower\": \"";
-  if(kelvir.getPower()) dataMap +="ON\""  ;
-  else dataMap +="OFF\""  ;
-  dataMap += ",\"AcTemp\": \""+ String(kelvir.getTemp()) +"\""  ;
-  dataMap += ",\"AcMode\": \""+ String(kelvir.getMode()) +"\""  ;
-  dataMap += ",\"AcFan\": \""+ String(kelvir.getFan()) +"\""  ;
-  dataMap += ",\"AcProfileId\": \""+ String(_acProfileId) +"\""  ;
-  return dataMap;
-}
-void setAirconProfile(int acProfileId ,boolean on_off, int temp, uint64 mode, uint8_t fanSpeed){
-  /*
-   * Set Default 
-   */
-  _acProfileId  = acProfileId;
-
-  if(!on_off){
-    kelvir.setFan(0);
-    kelvir.setLight(true);
-    kelvir.setMode(KELVINATOR_AUTO);
-    kelvir.off();
-  }else{
-    kelvir.on();
-    kelvir.setFan(fanSpeed);
-    kelvir.setMode(mode);
-    kelvir.setTemp(temp);
-    kelvir.setSwingVertical(false);
-    kelvir.setSwingHorizontal(true);
-    kelvir.setXFan(true);
-    kelvir.setIonFilter(false);
-    kelvir.setLight(true);
-  }
-
-  
+#define IR_VERBOSE_DUMPS      false //Timing info and source code of every frame, slow at 115200 baud.
+#define IR_FRAME_QUEUE_SIZE   8
+#define IR_BURST_QUIET_MS     250   //A/C remotes send several packets ~40ms apart, wait for the last.
+#define IR_FRAME_TIMING_BYTES 96    //Packed timings kept per UNKNOWN frame, the rest is cut.
+
+struct IrFrame {
+  decode_type_t decodeType;
+  uint16_t bits;
+  uint16_t repeats;
+  uint16_t rawlen;               //Timings captured, UNKNOWN frames in IR_RAW only
+  uint8_t timingBytes;
+  uint8_t state[STATE_SIZE_MAX]; //Shares the union with value, as in decode_results.
+  uint8_t timings[IR_FRAME_TIMING_BYTES];
+};
+IrFrame _irFrames[IR_FRAME_QUEUE_SIZE];
+uint8_t _irFrameHead = 0;
+uint8_t _irFrameCount = 0;
+unsigned long irLastFrameAtMS = 0;
+uint32_t irDroppedFrames = 0;
+boolean irPublishRawFrames = false;
+
+//Multi-line dump, written straight to Serial after whatever the log still holds.
+void _irDumpResults(decode_results* results){
+  flushHiveLog();
+  uint32_t now = millis();
+  Serial.printf("Timestamp : %06u.%03u\n", now / 1000, now % 1000);
+  // Display the basic output of what we found.
+  Serial.print(resultToHumanReadableBasic(results));
+  Serial.println(describeACInfo(results));  // Display any extra A/C info if we have it.
+  yield();  // Feed the WDT as the text output can take a while to print.
+
+  // Display the library version the message was captured with.
+  Serial.print("Library   : v");
+  Serial.println(_IRREMOTEESP8266_VERSION_);
+  Serial.println();
+
+  // Output RAW timing info of the result.
+  Serial.println(resultToTimingInfo(results));
+  yield();  // Feed the WDT (again)
+
+  // Output the results as source code
+  Serial.println(resultToSourceCode(results));
+  Serial.println("");  // Blank line between entries
+  yield();  // Feed the WDT (again)
 }
 
-void sendAirconProfile(){
-  kelvir.send();
+//Same protocol, length and payload bytes. value protocols keep value in the first state bytes.
+boolean _isSameIRFrame(const IrFrame& frame, const decode_results& decoded){
+  if(frame.decodeType != decoded.decode_type || frame.bits != decoded.bits) return false;
+  size_t bytes = (decoded.bits + 7) / 8;
+  if(bytes > sizeof(frame.state)) bytes = sizeof(frame.state);
+  return memcmp(frame.state, decoded.state, bytes) == 0;
 }
 
+//Stops at the first timing that does not fit, rawlen then tells HiveCentral it was cut.
+void _irPackTimings(IrFrame& frame, const decode_results& decoded){
+  frame.rawlen = decoded.rawlen > 0 ? decoded.rawlen - 1 : 0;
+  for(uint16_t i=1;i<decoded.rawlen;i++){
+    int32_t delta = (int32_t)decoded.rawbuf[i] - (i > 2 ? (int32_t)decoded.rawbuf[i - 2] : 0);
+    uint32_t zigzag = ((uint32_t)delta << 1) ^ (uint32_t)(delta >> 31);
+    uint8_t packed[5];
+    uint8_t packedBytes = 0;
+    do{
+      packed[packedBytes] = zigzag & 0x7F;
+      zigzag >>= 7;
+      if(zigzag) packed[packedBytes] |= 0x80;
+      packedBytes++;
+    }while(zigzag);
+    if(frame.timingBytes + packedBytes > IR_FRAME_TIMING_BYTES) return;
+    memcpy(frame.timings + frame.timingBytes, packed, packedBytes);
+    frame.timingBytes += packedBytes;
+  }
+}
 
-unsigned int irContinusRunForSecs = 10;
-unsigned long irLastInerrupttMS =0;
-unsigned long irForceInterruptAtMS =0;
-String irDataPayload = "";
-//String irTolerentEncodedDataPayload = "";
-boolean checkIRAndInteruptForOtherProcessing(){
-  unsigned long irCurrenttMS =millis();
-  if(
-    irCurrenttMS > (irLastInerrupttMS + (irContinusRunForSecs * 1000) ) //Organic end of Exclusive Period
-    || (irForceInterruptAtMS>1 && irCurrenttMS > irForceInterruptAtMS  ) //Force Interrupt after x Seconds already decided 
-  ){
-      //Interrupt
-      irLastInerrupttMS = irCurrenttMS; 
-      irForceInterruptAtMS=0;
-      Serial.println("DEBUG: [IR_RECIEVE] Interrupting for IR Yield" );
-      return true; //ok breakup, you have either data or time to yield for other work.
-  }else{
-    if (irrecv.decode(&results)) {
-              // Display a crude timestamp.
-      {    
-            //Decode Section from original Codes. 
-            
-            uint32_t now = millis();
-            Serial.printf("Timestamp : %06u.%03u\n", now / 1000, now % 1000);
-            if (results.overflow)
-              Serial.printf("WARNING: IR code is too big for buffer (>= %d). "
-                            "This result shouldn't be trusted until this is resolved. "
-                            "Edit & increase CAPTURE_BUFFER_SIZE.\n",
-                            CAPTURE_BUFFER_SIZE);
-            // Display the basic output of what we found.
-            Serial.print(resultToHumanReadableBasic(&results));
-            Serial.println(describeACInfo(&results));  // Display any extra A/C info if we have it.
-            yield();  // Feed the WDT as the text output can take a while to print.
-        
-            // Display the library version the message was captured with.
-            Serial.print("Library   : v");
-            Serial.println(_IRREMOTEESP8266_VERSION_);
-            Serial.println();
-        
-            // Output RAW timing info of the result.
-            Serial.println(resultToTimingInfo(&results));
-            yield();  // Feed the WDT (again)
-        
-            // Output the results as source code
-            Serial.println(resultToSourceCode(&results));
-            Serial.println("");  // Blank line between entries
-            yield();  // Feed the WDT (again)
-      }        
-              
-      Serial.print("DEBUG: [IRREAD] Readable:" );
-      
-      
-      //I have IR Data.
-      irDataPayload += describeACInfo(&results);
-      irDataPayload += " ";
-      Serial.println(irDataPayload);
-      
-      //String tolIRValues = _IRREMOTEESP8266_VERSION_;
-      //irTolerentEncodedDataPayload +=tolIRValues;
-
-      //We have IR Signal so ForceInterrupt in 2 Sec Later, and keep continuing to gather the reset of data.
-      irForceInterruptAtMS = irCurrenttMS + (1 * 1000);
-    }else{
-      //No Data , lets Yield.
-      yield();
+//Never blocks, true when a frame was taken from IRrecv.
+boolean pollIRReceiver(){
+  if(!irrecv.decode(&results)) return false;
+  if(IR_VERBOSE_DUMPS) _irDumpResults(&results);
+  if(results.overflow){
+    HIVE_LOG_WARN("IRREAD", "IR code is too big for buffer (>= %d), increase CAPTURE_BUFFER_SIZE.", CAPTURE_BUFFER_SIZE);
+  }
+  irLastFrameAtMS = millis();
+  if(_irFrameCount > 0){
+    IrFrame& newest = _irFrames[(_irFrameHead + _irFrameCount - 1) % IR_FRAME_QUEUE_SIZE];
+    if(_isSameIRFrame(newest, results)){
+      if(newest.repeats < 0xFFFF) newest.repeats++;
+      return true;
     }
   }
-  return false;//keep continuing to give me control to run.
+  if(_irFrameCount >= IR_FRAME_QUEUE_SIZE){
+    irDroppedFrames++;
+    return true;
+  }
+  IrFrame& frame = _irFrames[(_irFrameHead + _irFrameCount) % IR_FRAME_QUEUE_SIZE];
+  frame.decodeType = results.decode_type;
+  frame.bits = results.bits;
+  frame.repeats = 0;
+  memcpy(frame.state, results.state, sizeof(frame.state));
+  frame.rawlen = 0;
+  frame.timingBytes = 0;
+  if(irPublishRawFrames && results.decode_type == UNKNOWN) _irPackTimings(frame, results);
+  _irFrameCount++;
+  return true;
+}
+
+//Nothing but UNKNOWN frames, most likely interference.
+boolean isIRBurstNoise(){
+  for(uint8_t i=0;i<_irFrameCount;i++){
+    if(_irFrames[(_irFrameHead + i) % IR_FRAME_QUEUE_SIZE].decodeType != UNKNOWN) return false;
+  }
+  return true;
+}
+
+void clearIRFrames(){
+  _irFrameHead = 0;
+  _irFrameCount = 0;
+  irDroppedFrames = 0;
+}
+
+//Frames are queued and the remote has gone quiet.
+boolean isIRBurstComplete(){
+  return _irFrameCount > 0 && millis() - irLastFrameAtMS >= IR_BURST_QUIET_MS;
+}
+
+boolean popIRFrame(IrFrame& frame){
+  if(_irFrameCount == 0) return false;
+  frame = _irFrames[_irFrameHead];
+  _irFrameHead = (_irFrameHead + 1) % IR_FRAME_QUEUE_SIZE;
+  _irFrameCount--;
+  return true;
+}
+
+//IR_RAW entry: {"IRProtocol":18,"bits":128,"IRState":"<base64>"}, UNKNOWN adds IRTimings and rawlen.
+void writeIRFrameRaw(HivePayloadWriter& entry, const IrFrame& frame){
+  entry.addLong(HF_IrProtocol, frame.decodeType);
+  entry.addLong(HF_IrBits, frame.bits);
+  size_t stateBytes = (frame.bits + 7) / 8;
+  if(stateBytes > sizeof(frame.state)) stateBytes = sizeof(frame.state);
+  entry.addBytes(HF_IrState, frame.state, stateBytes);
+  if(frame.timingBytes > 0){
+    entry.addBytes(HF_IrTimings, frame.timings, frame.timingBytes);
+    entry.addLong(HF_IrRawLen, frame.rawlen);
+  }
+}
+
+String describeIRFrame(const IrFrame& frame){
+  decode_results decoded;
+  memset(&decoded, 0, sizeof(decoded));
+  decoded.decode_type = frame.decodeType;
+  decoded.bits = frame.bits;
+  memcpy(decoded.state, frame.state, sizeof(frame.state));
+  return describeACInfo(&decoded);
 }
 
 
@@ -0,0 +1,110 @@
+/*
+ * Energy Meter on the fake clock: time charged to each phase, the RTC ledger over DeepSleep,
+ * halving, and the mAh per hour it adds up to.
+ */
+#include "HiveTest.h"
+#include "../HiveMicroClimateBotV3.ino"
+#include <ArduinoJson.h>
+
+void testSpend(EnergyPhase phase, unsigned long ms){
+  energyEnterPhase(phase);
+  hostAdvanceMs(ms);
+}
+
+//Entering a phase charges the elapsed time to the one left, nested phases hand back to the outer one.
+HIVE_TEST(phasesAreChargedTheTimeSpentInThem){
+  setupEnergyMeter();
+  hostAdvanceMs(1200); //Boot, charged as ACTIVE
+  EnergyPhase previous = energyEnterPhase(ENERGY_DHT22);
+  HIVE_CHECK_EQ(ENERGY_ACTIVE, previous);
+  hostAdvanceMs(250);
+  EnergyPhase inDht22 = energyEnterPhase(ENERGY_LED);
+  hostAdvanceMs(30);
+  energyEnterPhase(inDht22);
+  hostAdvanceMs(20);
+  energyEnterPhase(previous);
+  hostAdvanceMs(500);
+  testSpend(ENERGY_IDLE, 8000);
+  energyEnterPhase(ENERGY_ACTIVE);
+
+  HIVE_CHECK_EQ(1700, energyLedger.phaseMs[ENERGY_ACTIVE]);
+  HIVE_CHECK_EQ(270, energyLedger.phaseMs[ENERGY_DHT22]);
+  HIVE_CHECK_EQ(30, energyLedger.phaseMs[ENERGY_LED]);
+  HIVE_CHECK_EQ(8000, energyLedger.phaseMs[ENERGY_IDLE]);
+  HIVE_CHECK_EQ(0, energyLedger.phaseMs[ENERGY_DEEPSLEEP]);
+  uint64_t totalMs = 0;
+  for(int i=0;i<ENERGY_PHASE_COUNT;i++) totalMs += energyLedger.phaseMs[i];
+  HIVE_CHECK_EQ(millis(), totalMs);
+}
+
+//An hour of 59 minutes idle and one awake: (59 * 20mA + 80mA) / 60.
+HIVE_TEST(milliAmpHoursPerHourWeighsPhasesByTime){
+  setupEnergyMeter();
+  HIVE_CHECK(energyMilliAmpHoursPerHour() == 0);
+  testSpend(ENERGY_ACTIVE, 60 * 1000UL);
+  testSpend(ENERGY_IDLE, 59 * 60 * 1000UL);
+  float expected = (59.0f * ENERGY_IDLE_UA + ENERGY_ACTIVE_UA) / 60 / 1000;
+  HIVE_CHECK(fabs(energyMilliAmpHoursPerHour() - expected) < 0.01f);
+  HIVE_CHECK(fabs(energyMilliAmpHoursPerHour() - 21.0f) < 0.01f);
+  //The phase it is in counts up to now.
+  HIVE_CHECK_EQ(59 * 60 * 1000UL, energyLedger.phaseMs[ENERGY_IDLE]);
+}
+
+//The sleep is charged before ESP.deepSleep(), the ledger comes back from RTC memory on wake.
+HIVE_TEST(deepSleepIsChargedAndKeptOverTheWake){
+  setupEnergyMeter();
+  testSpend(ENERGY_ACTIVE, 4000);
+  energyDeepSleep(56);
+  HIVE_CHECK_EQ(4000, energyLedger.phaseMs[ENERGY_ACTIVE]);
+  HIVE_CHECK_EQ(56000, energyLedger.phaseMs[ENERGY_DEEPSLEEP]);
+
+  hostReset(true);
+  memset(&energyLedger, 0, sizeof(energyLedger));
+  setupEnergyMeter();
+  HIVE_CHECK_EQ(4000, energyLedger.phaseMs[ENERGY_ACTIVE]);
+  HIVE_CHECK_EQ(56000, energyLedger.phaseMs[ENERGY_DEEPSLEEP]);
+  hostAdvanceMs(4000);
+  float expected = (8000.0f * ENERGY_ACTIVE_UA + 56000.0f * ENERGY_DEEPSLEEP_UA) / 64000 / 1000;
+  HIVE_CHECK(fabs(energyMilliAmpHoursPerHour() - expected) < 0.01f);
+
+  //A damaged ledger starts over.
+  energyDeepSleep(56);
+  hostReset(true);
+  ESP.rtcMemory[RTC_ENERGY_LEDGER_ADDRESS + 3] ^= 1;
+  setupEnergyMeter();
+  for(int i=0;i<ENERGY_PHASE_COUNT;i++) HIVE_CHECK_EQ(0, energyLedger.phaseMs[i]);
+  HIVE_CHECK_EQ(ENERGY_MAGIC, energyLedger.magic);
+}
+
+//A phase reaching ENERGY_HALVE_AFTER_MS halves them all, the mix and so the estimate stay.
+HIVE_TEST(largeTotalsAreHalved){
+  setupEnergyMeter();
+  energyLedger.phaseMs[ENERGY_IDLE] = ENERGY_HALVE_AFTER_MS - 1000;
+  energyLedger.phaseMs[ENERGY_ACTIVE] = 100000;
+  testSpend(ENERGY_IDLE, 0);
+  float before = energyMilliAmpHoursPerHour();
+  hostAdvanceMs(1000);
+  energyEnterPhase(ENERGY_IDLE);
+  HIVE_CHECK_EQ(ENERGY_HALVE_AFTER_MS / 2, energyLedger.phaseMs[ENERGY_IDLE]);
+  HIVE_CHECK_EQ(50000, energyLedger.phaseMs[ENERGY_ACTIVE]);
+  HIVE_CHECK(fabs(energyMilliAmpHoursPerHour() - before) < 0.01f);
+}
+
+//"energy":{"mAhPerHour":"21.00",..} in seconds per phase.
+HIVE_TEST(energyDataMapReportsSecondsPerPhase){
+  setupEnergyMeter();
+  testSpend(ENERGY_ACTIVE, 60 * 1000UL);
+  testSpend(ENERGY_IDLE, 59 * 60 * 1000UL);
+  char buffer[HIVE_PAYLOAD_BUFFER_SIZE];
+  HivePayloadWriter dataMap(buffer, sizeof(buffer));
+  dataMap.beginObject();
+  writeEnergyDataMap(dataMap);
+  dataMap.endObject();
+  HIVE_CHECK(dataMap.length() <= ENERGY_DATAMAP_BYTES);
+
+  StaticJsonBuffer<1000> json;
+  JsonObject& energy = json.parseObject(dataMap.c_str())["energy"];
+  HIVE_CHECK_STR("21.00", energy["mAhPerHour"].as<const char*>());
+  HIVE_CHECK_EQ(60, energy["activeSecs"].as<long>());
+  HIVE_CHECK_EQ(59 * 60, energy["idleSecs"].as<long>());
+}
@@ -0,0 +1,90 @@
+/*
+ * Report Policy against recorded style traces, one reading a minute: which readings get published.
+ */
+#include "HiveTest.h"
+#include "../HiveMicroClimateBotV3.ino"
+#include <ArduinoJson.h>
+#include <vector>
+
+struct TestReading {
+  float temp;
+  float humidity;
+  boolean ok;
+};
+
+void testResetReportPolicy(){
+  reportTemperature = {REPORT_TEMP_DEADBAND_CENTI, REPORT_TEMP_RATE_CENTI, 0, 0, 0, false};
+  reportHumidity = {REPORT_HUMIDITY_DEADBAND_CENTI, REPORT_HUMIDITY_RATE_CENTI, 0, 0, 0, false};
+  reportMaxSilenceSecs = REPORT_MAX_SILENCE_SECS;
+  _reportHaveLast = false;
+  _reportLastSensorOk = false;
+  _reportLastAtMs = 0;
+}
+
+//Plays the trace a minute apart, returns the indexes that were published.
+std::vector<int> testPlayTrace(const std::vector<TestReading>& trace){
+  std::vector<int> published;
+  for(size_t i=0;i<trace.size();i++){
+    const TestReading& reading = trace[i];
+    if(reportShouldPublish(reading.ok, reading.temp, reading.humidity)){
+      reportMarkPublished(reading.ok, reading.temp, reading.humidity);
+      published.push_back(i);
+    }
+    hostAdvanceMs(60 * 1000UL);
+  }
+  return published;
+}
+
+std::vector<TestReading> testRoomTrace(){
+  std::vector<TestReading> trace = {
+    {24.00f, 55.0f, true},  //0  first reading
+    {24.05f, 55.0f, true},  //1  DHT22 flicker
+    {24.10f, 56.5f, true},  //2
+    {24.00f, 55.0f, true},  //3
+    {24.20f, 55.0f, true},  //4
+    {24.30f, 55.0f, true},  //5  deadband, 0.30 from 24.00
+    {24.56f, 55.0f, true},  //6  rate, 0.26 in a minute
+  };
+  for(int i=7;i<10;i++) trace.push_back({24.56f, 55.0f, true});
+  trace.push_back({24.56f, 57.0f, true});               //10 humidity deadband
+  for(int i=11;i<22;i++) trace.push_back({24.56f, 57.0f, true});
+  trace.push_back({0, 0, false});                       //22 sensor failed
+  trace.push_back({0, 0, false});                       //23
+  for(int i=24;i<40;i++) trace.push_back({24.56f, 57.0f, true}); //24 back, 39 max silence
+  return trace;
+}
+
+HIVE_TEST(defaultPolicyOnRoomTrace){
+  testResetReportPolicy();
+  HIVE_CHECK(testPlayTrace(testRoomTrace()) == std::vector<int>({0, 5, 6, 10, 22, 24, 39}));
+}
+
+HIVE_TEST(maxSilenceIsTheHeartBeat){
+  testResetReportPolicy();
+  HIVE_CHECK(reportMaxSilenceExpired());
+  std::vector<TestReading> flat(61, TestReading{22.0f, 40.0f, true});
+  HIVE_CHECK(testPlayTrace(flat) == std::vector<int>({0, 15, 30, 45, 60}));
+  hostAdvanceMs(14 * 60 * 1000UL - 1);
+  HIVE_CHECK(!reportMaxSilenceExpired());
+  hostAdvanceMs(1);
+  HIVE_CHECK(reportMaxSilenceExpired());
+}
+
+HIVE_TEST(settingsFromHiveCentral){
+  testResetReportPolicy();
+  StaticJsonBuffer<300> buffer;
+  JsonObject& settings = buffer.parseObject(
+    "{\"tempDeadband\":\"1.00\",\"tempRate\":\"0\",\"humidityDeadband\":\"-1\",\"maxSilenceSecs\":1800}");
+  updateReportSettings(settings);
+  HIVE_CHECK_EQ(100, reportTemperature.deadbandCenti);
+  HIVE_CHECK_EQ(0, reportTemperature.rateCentiPerMin);
+  HIVE_CHECK_EQ(0, reportHumidity.deadbandCenti);  //Clamped, every humidity reading is a change
+  HIVE_CHECK_EQ(1800, reportMaxSilenceSecs);
+
+  StaticJsonBuffer<100> restore;
+  updateReportSettings(restore.parseObject("{\"humidityDeadband\":\"2\",\"maxSilenceSecs\":0}"));
+  HIVE_CHECK_EQ(200, reportHumidity.deadbandCenti);
+  HIVE_CHECK_EQ(1800, reportMaxSilenceSecs); //0 is ignored
+  //Deadband 1.00 and no rate trigger, only the humidity step and the sensor dropping out report.
+  HIVE_CHECK(testPlayTrace(testRoomTrace()) == std::vector<int>({0, 10, 22, 24}));
+}
@@ -0,0 +1,90 @@
+/*
+ * Sample Store: the ring of readings in RTC memory, the publish decision and the batch it sends.
+ */
+#include "HiveTest.h"
+#include "../HiveMicroClimateBotV3.ino"
+#include <ArduinoJson.h>
+
+//The Samples batch as the bot would add it to dataMap, as JSON.
+std::string testSamplesJson(){
+  static char buffer[HIVE_PAYLOAD_BUFFER_SIZE];
+  HivePayloadWriter dataMap(buffer, sizeof(buffer));
+  dataMap.reset();
+  dataMap.beginObject();
+  writeSampleStoreDataMap(dataMap);
+  dataMap.endObject();
+  return std::string(dataMap.c_str(), dataMap.length());
+}
+
+HIVE_TEST(ringKeepsNewestSamplesOldestFirst){
+  resetSampleStore();
+  for(int i=0;i<SAMPLE_STORE_CAPACITY + 3;i++){
+    sampleStorePush(20.0f + i, 50.0f);
+    hostAdvanceMs(60 * 1000UL);
+  }
+  HIVE_CHECK_EQ(SAMPLE_STORE_CAPACITY, sampleStore.count);
+
+  StaticJsonBuffer<2000> buffer;
+  JsonArray& samples = buffer.parseObject(testSamplesJson().c_str())["Samples"];
+  HIVE_CHECK_EQ(SAMPLE_STORE_CAPACITY, samples.size());
+  for(int i=0;i<SAMPLE_STORE_CAPACITY;i++){
+    JsonObject& sample = samples.get<JsonVariant>(i).as<JsonObject>();
+    HIVE_CHECK_STR(std::to_string(23 + i) + ".00", sample["t"].as<const char*>());
+    HIVE_CHECK_STR("50.00", sample["h"].as<const char*>());
+    HIVE_CHECK_EQ((SAMPLE_STORE_CAPACITY - i) * 60, sample["ageSecs"].as<long>());
+  }
+}
+
+HIVE_TEST(emptyStoreAddsNoBatch){
+  resetSampleStore();
+  HIVE_CHECK_STR("{}", testSamplesJson());
+  HIVE_CHECK(!sampleStoreNeedsPublish());
+}
+
+HIVE_TEST(publishDueOnWakeupsFullRingOrThreshold){
+  resetSampleStore();
+  sampleStorePush(24.0f, 55.0f);
+  //Nothing published yet, no reference to compare with.
+  HIVE_CHECK(!sampleStoreNeedsPublish());
+  sampleStore.wakeups = SAMPLE_STORE_PUBLISH_EVERY_WAKEUPS;
+  HIVE_CHECK(sampleStoreNeedsPublish());
+
+  sampleStoreSetLastPublished(24.0f, 55.0f);
+  sampleStoreMarkPublished();
+  HIVE_CHECK_EQ(0, sampleStore.count);
+  sampleStorePush(24.49f, 57.99f);
+  HIVE_CHECK(!sampleStoreNeedsPublish());
+  sampleStorePush(23.50f, 55.0f);
+  HIVE_CHECK(sampleStoreNeedsPublish());
+  sampleStorePush(24.0f, 58.0f);
+  HIVE_CHECK(sampleStoreNeedsPublish());
+
+  resetSampleStore();
+  sampleStoreSetLastPublished(24.0f, 55.0f);
+  for(int i=0;i<SAMPLE_STORE_CAPACITY;i++) sampleStorePush(24.0f, 55.0f);
+  HIVE_CHECK(sampleStoreNeedsPublish());
+}
+
+//The store and its clock survive DeepSleep in RTC memory, a corrupt store starts fresh.
+HIVE_TEST(storeSurvivesDeepSleep){
+  resetSampleStore();
+  sampleStoreSetFlag(SAMPLE_STORE_DHT22, true);
+  hostAdvanceMs(5000);
+  sampleStorePush(21.5f, 40.25f);
+  sampleStoreDeepSleep(300, false);
+  HIVE_CHECK_EQ(1, ESP.deepSleeps);
+
+  hostReset(true);
+  memset(&sampleStore, 0xEE, sizeof(sampleStore));
+  HIVE_CHECK(loadSampleStore());
+  HIVE_CHECK_EQ(1, sampleStore.count);
+  HIVE_CHECK_EQ(305, sampleStoreNowSecs());
+  HIVE_CHECK(sampleStore.flags & SAMPLE_STORE_RADIO_OFF);
+  HIVE_CHECK(sampleStore.flags & SAMPLE_STORE_DHT22);
+  HIVE_CHECK_EQ(2150, sampleStore.samples[0].tempCenti);
+
+  ESP.rtcMemory[RTC_SAMPLE_STORE_ADDRESS + 3] ^= 1;
+  HIVE_CHECK(!loadSampleStore());
+  HIVE_CHECK_EQ(0, sampleStore.count);
+  HIVE_CHECK_EQ(SAMPLE_STORE_MAGIC, sampleStore.magic);
+}
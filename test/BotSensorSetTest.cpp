@@ -0,0 +1,84 @@
+/*
+ * Sensor Set over mock drivers: every call is one pass over the list in order, and the
+ * drivers' fields land in one dataMap.
+ */
+#include "HiveTest.h"
+#include "../HiveMicroClimateBotV3.ino"
+#include <ArduinoJson.h>
+
+std::string testCalls;
+boolean testPublishA = false, testPublishB = false, testPublishC = false;
+
+template<char NAME> struct TestDriver {
+  static boolean publish(){ return NAME == 'A' ? testPublishA : NAME == 'B' ? testPublishB : testPublishC; }
+  static void poll(){ testCalls += std::string("poll") + NAME + " "; }
+  static boolean sample(){ testCalls += std::string("sample") + NAME + " "; return publish(); }
+  static void markPublished(){ testCalls += std::string("published") + NAME + " "; }
+  static void writeDataMap(HivePayloadWriter& dataMap);
+};
+//Each writes fields of its own, as a CO2 or light driver would next to the DHT22.
+template<> void TestDriver<'A'>::writeDataMap(HivePayloadWriter& dataMap){
+  dataMap.addFixed(HF_Temperature, 23.5, 2);
+  dataMap.addFixed(HF_HumidityPercent, 41.25, 2);
+}
+template<> void TestDriver<'B'>::writeDataMap(HivePayloadWriter& dataMap){
+  dataMap.addString(HF_DHT22SensorStatus, "OK");
+}
+template<> void TestDriver<'C'>::writeDataMap(HivePayloadWriter& dataMap){}
+typedef SensorSet<TestDriver<'A'>, TestDriver<'B'>, TestDriver<'C'>> TestSensorSet;
+
+void testResetDrivers(boolean publishA, boolean publishB, boolean publishC){
+  testCalls = "";
+  testPublishA = publishA;
+  testPublishB = publishB;
+  testPublishC = publishC;
+}
+
+HIVE_TEST(pollIsOnePassInListOrder){
+  testResetDrivers(false, false, false);
+  TestSensorSet::poll();
+  HIVE_CHECK_STR("pollA pollB pollC ", testCalls);
+  testCalls = "";
+  SensorSet<>::poll();
+  HIVE_CHECK_STR("", testCalls);
+}
+
+//Every driver samples once whichever wants to publish, so no reading goes stale behind another.
+HIVE_TEST(sampleAsksEveryDriverOnce){
+  testResetDrivers(false, false, false);
+  HIVE_CHECK(!TestSensorSet::sample());
+  HIVE_CHECK_STR("sampleA sampleB sampleC ", testCalls);
+
+  testResetDrivers(true, false, false);
+  HIVE_CHECK(TestSensorSet::sample());
+  HIVE_CHECK_STR("sampleA sampleB sampleC ", testCalls);
+
+  testResetDrivers(false, false, true);
+  HIVE_CHECK(TestSensorSet::sample());
+  HIVE_CHECK_STR("sampleA sampleB sampleC ", testCalls);
+  HIVE_CHECK(!SensorSet<>::sample());
+}
+
+//One dataMap with every driver's fields, the way the Sensor task sends it.
+HIVE_TEST(dataMapMergesEveryDriver){
+  testResetDrivers(false, true, false);
+  char buffer[HIVE_PAYLOAD_BUFFER_SIZE];
+  HivePayloadWriter dataMap(buffer, sizeof(buffer));
+  HIVE_CHECK(TestSensorSet::sample());
+  dataMap.beginObject();
+  TestSensorSet::writeDataMap(dataMap);
+  dataMap.endObject();
+  TestSensorSet::markPublished();
+  HIVE_CHECK_STR("sampleA sampleB sampleC publishedA publishedB publishedC ", testCalls);
+  HIVE_CHECK_STR("{\"Temperature\":\"23.50\",\"HumidityPercent\":\"41.25\",\"DHT22_SensorStatus\":\"OK\"}",
+    std::string(dataMap.c_str(), dataMap.length()));
+
+  //MSGPACK, the same three fields in one map.
+  dataMap.setBinary(true);
+  dataMap.reset();
+  dataMap.beginObject();
+  TestSensorSet::writeDataMap(dataMap);
+  dataMap.endObject();
+  HIVE_CHECK_EQ(0xDE, (uint8_t)dataMap.c_str()[0]);
+  HIVE_CHECK_EQ(3, ((uint8_t)dataMap.c_str()[1] << 8) | (uint8_t)dataMap.c_str()[2]);
+}
@@ -0,0 +1,126 @@
+/*
+ * DHT22 sampler with a scripted reader: retry backoff, failure, recovery and the median filter.
+ */
+#include "HiveTest.h"
+#include "../HiveMicroClimateBotV3.ino"
+#include "HiveBotSimulation.h"
+#include <vector>
+
+struct TestDhtRead {
+  boolean ok;
+  float temp;
+  float humidity;
+};
+std::vector<TestDhtRead> testDhtScript;
+std::vector<unsigned long> testDhtReadAtMs;
+boolean testDhtReader(float& temp, float& humidity){
+  TestDhtRead read = testDhtScript.empty() ? TestDhtRead{true, 24.0f, 50.0f} : testDhtScript.front();
+  if(!testDhtScript.empty()) testDhtScript.erase(testDhtScript.begin());
+  testDhtReadAtMs.push_back(millis());
+  temp = read.temp;
+  humidity = read.humidity;
+  return read.ok;
+}
+
+void testResetDht22(std::vector<TestDhtRead> script){
+  _dht22SampleCount = 0;
+  _dht22SampleNext = 0;
+  _dht22Outliers = 0;
+  _dht22Failures = 0;
+  _dht22State = DHT22_SAMPLING;
+  _dht22HaveRead = false;
+  dht22Reader = testDhtReader;
+  testDhtScript = script;
+  testDhtReadAtMs.clear();
+}
+
+//Polls every 100 ms, as the Sensor Set poll task would, for ms.
+void testPollDht22For(unsigned long ms){
+  for(unsigned long at=0; at<ms; at+=100){
+    pollDht22Sampler();
+    hostAdvanceMs(100);
+  }
+}
+
+const TestDhtRead testDhtFail = {false, NAN, NAN};
+
+HIVE_TEST(failedReadsBackOffTwoFourEightThenFail){
+  testResetDht22({testDhtFail, testDhtFail, testDhtFail});
+  pollDht22Sampler();
+  HIVE_CHECK(isDht22Retrying());
+  HIVE_CHECK(!readSensors());
+  testPollDht22For(13900);
+  HIVE_CHECK(testDhtReadAtMs == std::vector<unsigned long>({0, 2000, 6000}));
+  HIVE_CHECK(isDht22Retrying());
+
+  testDhtScript = {testDhtFail};
+  testPollDht22For(200); //Last retry, 8s after the one before
+  HIVE_CHECK(testDhtReadAtMs == std::vector<unsigned long>({0, 2000, 6000, 14000}));
+  HIVE_CHECK_EQ(DHT22_FAILED, _dht22State);
+  HIVE_CHECK(!isDht22Retrying());
+  HIVE_CHECK(!readSensors());
+
+  //Failed, back on the sample cadence until a read succeeds.
+  testDhtScript = {testDhtFail};
+  testPollDht22For(12000);
+  HIVE_CHECK_EQ(5, testDhtReadAtMs.size());
+  HIVE_CHECK_EQ(26000, testDhtReadAtMs.back());
+  HIVE_CHECK_EQ(DHT22_FAILED, _dht22State);
+  testPollDht22For(12000);
+  HIVE_CHECK_EQ(38000, testDhtReadAtMs.back());
+  HIVE_CHECK(readSensors());
+  HIVE_CHECK_EQ(24.0f, dht22_temp_f);
+}
+
+HIVE_TEST(readInsideMinimumIntervalIsServedFromSamples){
+  testResetDht22({{true, 22.5f, 45.0f}});
+  HIVE_CHECK(readSensors());
+  hostAdvanceMs(DHT22_MIN_INTERVAL_MS - 1);
+  HIVE_CHECK(readSensors());
+  HIVE_CHECK_EQ(1, testDhtReadAtMs.size());
+  HIVE_CHECK_EQ(22.5f, dht22_temp_f);
+  HIVE_CHECK_EQ(45.0f, dht22_humidity);
+}
+
+HIVE_TEST(outOfRangeFrameCountsAsFailure){
+  testResetDht22({{true, 120.0f, 45.0f}, {true, 22.0f, 130.0f}, {true, 22.0f, 45.0f}});
+  testPollDht22For(6100);
+  HIVE_CHECK(testDhtReadAtMs == std::vector<unsigned long>({0, 2000, 6000}));
+  HIVE_CHECK_EQ(DHT22_SAMPLING, _dht22State);
+  HIVE_CHECK(readSensors());
+  HIVE_CHECK_EQ(22.0f, dht22_temp_f);
+}
+
+HIVE_TEST(medianRejectsSpikeButFollowsStep){
+  testResetDht22({{true, 24.0f, 50.0f}, {true, 24.2f, 50.0f}, {true, 24.1f, 50.0f},
+                  {true, 30.0f, 50.0f},                        //Spike, rejected
+                  {true, 24.3f, 50.0f},
+                  {true, 18.0f, 50.0f}, {true, 18.1f, 50.0f}}); //AC on, a real step
+  testPollDht22For(5 * DHT22_SAMPLE_EVERY_MS - 100);
+  HIVE_CHECK_EQ(5, testDhtReadAtMs.size());
+  HIVE_CHECK(readSensors());
+  HIVE_CHECK_EQ(24.15f, dht22_temp_f);
+  testPollDht22For(2 * DHT22_SAMPLE_EVERY_MS);
+  HIVE_CHECK_EQ(7, testDhtReadAtMs.size());
+  HIVE_CHECK(readSensors());
+  HIVE_CHECK(dht22_temp_f < 18.2f);
+}
+
+//What the filter costs: DHT22 conversions per Sensor task run over an hour of bot time.
+HIVE_TEST(conversionsPerSensorReport){
+  setup();
+  callbackUpdateFunctions(",DHT22");
+  testResetDht22({});
+  unsigned long sensorRuns = 0;
+  unsigned long dueInMs = sensorTimer.msUntilDue();
+  for(int second=0;second<60 * 60;second++){
+    hiveRunFor(1000);
+    if(sensorTimer.msUntilDue() > dueInMs) sensorRuns++; //Ran, due a whole period out again
+    dueInMs = sensorTimer.msUntilDue();
+  }
+  HIVE_CHECK(sensorRuns >= 59 && sensorRuns <= 61);
+  unsigned long expected = 60UL * 60 * 1000 / DHT22_SAMPLE_EVERY_MS;
+  HIVE_CHECK(testDhtReadAtMs.size() >= expected && testDhtReadAtMs.size() <= expected + 1);
+  printf("  %lu DHT22 conversions for %lu Sensor reports, %.1f per report\n",
+    (unsigned long)testDhtReadAtMs.size(), sensorRuns, (double)testDhtReadAtMs.size() / sensorRuns);
+}
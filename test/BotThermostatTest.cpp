@@ -0,0 +1,193 @@
+/*
+ * Thermostat against a thermal model: the room leaks towards the outside, the A/C pulls it down.
+ * The DHT22 reads the model through a scripted reader, the A/C is whatever was sent last.
+ */
+#include "HiveTest.h"
+#include "../HiveMicroClimateBotV3.ino"
+#include <vector>
+
+#define TEST_OUTSIDE_C        30.0f
+#define TEST_LEAK_PER_SEC     0.0005f  //Of the gap to outside, about +0.18 C/min at 24 C
+#define TEST_COOLING_C_SEC    0.0055f  //Net about -0.15 C/min at 24 C
+
+float testRoomC = 26.0f;
+boolean testSensorOk = true;
+boolean testRoomReader(float& temp, float& humidity){
+  temp = testRoomC;
+  humidity = 50.0f;
+  return testSensorOk;
+}
+
+struct TestSwitch {
+  unsigned long atMs;
+  boolean on;
+};
+std::vector<TestSwitch> testSwitches;
+
+//The DHT22 starts over on the model, no switches yet.
+void testResetRoom(float roomC){
+  _dht22SampleCount = 0;
+  _dht22SampleNext = 0;
+  _dht22Outliers = 0;
+  _dht22Failures = 0;
+  _dht22State = DHT22_SAMPLING;
+  _dht22HaveRead = false;
+  dht22Reader = testRoomReader;
+  testRoomC = roomC;
+  testSensorOk = true;
+  testSwitches.clear();
+}
+
+void testResetThermostat(float roomC){
+  testResetRoom(roomC);
+  setupAirconProfiles();
+  _thermostatSettingsLoaded = true;
+  _airconSent.power = false;
+  airconHaveSwitched = false;
+  thermostatSettings = {THERMOSTAT_SETTINGS_MAGIC, false, THERMOSTAT_ON_PROFILE, THERMOSTAT_OFF_PROFILE, 0,
+    THERMOSTAT_SETPOINT_CENTI, THERMOSTAT_HYSTERESIS_CENTI, THERMOSTAT_MIN_ON_SECS, THERMOSTAT_MIN_OFF_SECS};
+  enableThermostat(true);
+}
+
+//Polls the thermostat every second for ms, the room follows the A/C, every power switch is kept.
+void testRunRoomFor(unsigned long ms){
+  for(unsigned long at=0; at<ms; at+=1000){
+    boolean wasOn = _airconSent.power;
+    pollThermostat();
+    if(_airconSent.power != wasOn) testSwitches.push_back({millis(), _airconSent.power != 0});
+    testRoomC += (TEST_OUTSIDE_C - testRoomC) * TEST_LEAK_PER_SEC;
+    if(_airconSent.power) testRoomC -= TEST_COOLING_C_SEC;
+    hostAdvanceMs(1000);
+  }
+}
+
+HIVE_TEST(controlLawCoolsHeatsAndWaits){
+  ThermostatSettings settings = thermostatSettings;
+  settings.setpointCenti = 2400;
+  settings.hysteresisCenti = 50;
+  HIVE_CHECK_EQ(THERMOSTAT_SWITCH_ON, thermostatDecide(settings, false, false, true, 2450, false, 0));
+  HIVE_CHECK_EQ(THERMOSTAT_HOLD, thermostatDecide(settings, false, false, true, 2449, false, 0));
+  HIVE_CHECK_EQ(THERMOSTAT_SWITCH_OFF, thermostatDecide(settings, false, true, true, 2350, false, 0));
+  HIVE_CHECK_EQ(THERMOSTAT_SWITCH_ON, thermostatDecide(settings, true, false, true, 2350, false, 0));
+  HIVE_CHECK_EQ(THERMOSTAT_SWITCH_OFF, thermostatDecide(settings, false, true, false, 2400, false, 0));
+  //Minimum on / off time from the last switch.
+  HIVE_CHECK_EQ(THERMOSTAT_HOLD, thermostatDecide(settings, false, true, true, 2300, true, settings.minOnSecs * 1000UL - 1));
+  HIVE_CHECK_EQ(THERMOSTAT_SWITCH_OFF, thermostatDecide(settings, false, true, true, 2300, true, settings.minOnSecs * 1000UL));
+  HIVE_CHECK_EQ(THERMOSTAT_HOLD, thermostatDecide(settings, false, false, true, 2500, true, settings.minOffSecs * 1000UL - 1));
+}
+
+//Three hours from a warm room, it settles in the band and cycles no faster than the compressor allows.
+HIVE_TEST(holdsTheRoomInTheBand){
+  testResetThermostat(26.0f);
+  testRunRoomFor(30 * 60 * 1000UL);
+  HIVE_CHECK(!testSwitches.empty());
+  float lowC = 100, highC = -100;
+  for(unsigned long at=0; at<3 * 60 * 60 * 1000UL; at+=10000){
+    testRunRoomFor(10000);
+    if(testRoomC < lowC) lowC = testRoomC;
+    if(testRoomC > highC) highC = testRoomC;
+  }
+  printf("  room %.2f..%.2f C, %u switches\n", lowC, highC, (unsigned)testSwitches.size());
+  //Setpoint 24.00 +/- 0.50, overshoot from the 30 s check and the median filter's lag.
+  HIVE_CHECK(lowC >= 23.5f - 0.3f);
+  HIVE_CHECK(highC <= 24.5f + 0.3f);
+  HIVE_CHECK(testSwitches.size() >= 10);
+  for(size_t i=1;i<testSwitches.size();i++){
+    unsigned long heldMs = testSwitches[i].atMs - testSwitches[i-1].atMs;
+    HIVE_CHECK(testSwitches[i].on != testSwitches[i-1].on);
+    HIVE_CHECK(heldMs >= (testSwitches[i-1].on ? THERMOSTAT_MIN_ON_SECS : THERMOSTAT_MIN_OFF_SECS) * 1000UL);
+  }
+}
+
+//IRAC_ONN_PROFILE_A in a cold room, the thermostat wants it off but waits out the minimum on time.
+HIVE_TEST(manualSwitchCountsForMinimumOnTime){
+  testResetThermostat(22.0f);
+  testRunRoomFor(60 * 1000UL);
+  HIVE_CHECK(testSwitches.empty());
+  unsigned long switchedAtMs = millis();
+  instructionAirconProfileA(1, "");
+  HIVE_CHECK(_airconSent.power);
+  HIVE_CHECK(airconHaveSwitched);
+  HIVE_CHECK_EQ(switchedAtMs, airconSwitchedAtMs);
+
+  testRunRoomFor(THERMOSTAT_MIN_ON_SECS * 1000UL - 1000);
+  HIVE_CHECK(testSwitches.empty());
+  testRunRoomFor(THERMOSTAT_CHECK_MS + 1000);
+  HIVE_CHECK_EQ(1, testSwitches.size());
+  HIVE_CHECK(!testSwitches[0].on);
+  HIVE_CHECK(testSwitches[0].atMs - switchedAtMs >= THERMOSTAT_MIN_ON_SECS * 1000UL);
+
+  //Same the other way, a manual off holds the A/C off in a warm room.
+  testRoomC = 26.0f;
+  instructionAirconProfileA(2, "");
+  testRunRoomFor(THERMOSTAT_MIN_ON_SECS * 1000UL);
+  switchedAtMs = millis();
+  instructionAirconOff(3, "");
+  testSwitches.clear();
+  testRunRoomFor(THERMOSTAT_MIN_OFF_SECS * 1000UL - 1000);
+  HIVE_CHECK(testSwitches.empty());
+  testRunRoomFor(THERMOSTAT_CHECK_MS + 1000);
+  HIVE_CHECK_EQ(1, testSwitches.size());
+  HIVE_CHECK(testSwitches[0].on);
+}
+
+//Resending the profile already on is not a switch, the minimum time still counts from the first.
+HIVE_TEST(resendingSameProfileIsNotASwitch){
+  testResetThermostat(24.0f);
+  applyAirconProfile(THERMOSTAT_ON_PROFILE);
+  unsigned long switchedAtMs = millis();
+  hostAdvanceMs(60 * 1000UL);
+  applyAirconProfile(THERMOSTAT_ON_PROFILE);
+  HIVE_CHECK_EQ(switchedAtMs, airconSwitchedAtMs);
+}
+
+//A REBOOT with the A/C on, the bot still knows it sent ON: in a cold room the thermostat turns it
+//off, once the minimum on time counted from before the reboot is over.
+HIVE_TEST(rebootWhileOn){
+  testResetThermostat(26.0f);
+  testRunRoomFor(60 * 1000UL);
+  HIVE_CHECK_EQ(1, testSwitches.size());
+  HIVE_CHECK(_airconSent.power);
+  unsigned long onForMs = millis() - testSwitches[0].atMs;
+  saveAirconSent(3); //The REBOOT path, 3 s asleep
+  hostReset(true);
+  _airconSent = {false, 0, AIRCON_MODE_AUTO, 0};
+  _acProfileId = -1;
+  airconHaveSwitched = false;
+  airconSwitchedAtMs = 0;
+  setupAirconProfiles();
+  setupThermostat();
+  HIVE_CHECK(_airconSent.power);
+  HIVE_CHECK_EQ(THERMOSTAT_ON_PROFILE, _acProfileId);
+  HIVE_CHECK(airconHaveSwitched);
+  HIVE_CHECK_EQ(onForMs + 3000, millis() - airconSwitchedAtMs);
+
+  testResetRoom(22.0f);
+  testRunRoomFor(THERMOSTAT_MIN_ON_SECS * 1000UL - onForMs - 3000 - 1000);
+  HIVE_CHECK(testSwitches.empty());
+  testRunRoomFor(THERMOSTAT_CHECK_MS * 2);
+  HIVE_CHECK_EQ(1, testSwitches.size());
+  HIVE_CHECK(!testSwitches[0].on);
+
+  //RTC memory not intact, nothing is taken as sent.
+  saveAirconSent(0);
+  ESP.rtcMemory[RTC_AIRCON_SENT_ADDRESS + 2] ^= 1;
+  hostReset(true);
+  _airconSent = {false, 0, AIRCON_MODE_AUTO, 0};
+  _acProfileId = -1;
+  airconHaveSwitched = false;
+  setupAirconProfiles();
+  HIVE_CHECK_EQ(-1, _acProfileId);
+  HIVE_CHECK(!airconHaveSwitched);
+}
+
+//The sensor gone, the A/C goes off once retries run out and the minimum on time is over.
+HIVE_TEST(failedSensorTurnsTheAirconOff){
+  testResetThermostat(26.0f);
+  testRunRoomFor(THERMOSTAT_MIN_ON_SECS * 1000UL);
+  HIVE_CHECK(_airconSent.power);
+  testSensorOk = false;
+  testRunRoomFor(2 * 60 * 1000UL);
+  HIVE_CHECK(!_airconSent.power);
+  HIVE_CHECK_EQ(DHT22_FAILED, _dht22State);
+}
@@ -0,0 +1,73 @@
+/*
+ * Drives the whole sketch under the fake clock, include it after the sketch.
+ * hostBroker plays the MQTT broker, a test plays HiveCentral through hostBroker.onPublish
+ * and hostBroker.deliver().
+ */
+#pragma once
+#include <ArduinoJson.h>
+#include <vector>
+
+/*
+ * Runs loop() for ms of bot time. loop() sleeps through delay(), a pass that did not sleep
+ * is charged 1 ms, roughly what a pass costs on the ESP8266. Returns the passes run.
+ */
+unsigned long hiveRunFor(unsigned long ms){
+  unsigned long passes = 0;
+  unsigned long startMs = millis();
+  while(millis() - startMs < ms){
+    unsigned long beforeMs = millis();
+    loop();
+    passes++;
+    if(millis() == beforeMs) hostAdvanceMs(1);
+  }
+  return passes;
+}
+
+//Top level field of a JSON payload, "" when it is not there.
+std::string hiveField(const std::string& payload, const char* key){
+  StaticJsonBuffer<1000> buffer;
+  JsonObject& parsed = buffer.parseObject(payload.c_str());
+  const char* value = parsed[key];
+  if(value != nullptr) return value;
+  return parsed.containsKey(key) ? std::to_string(parsed[key].as<long>()) : "";
+}
+std::string hiveDataMapField(const std::string& payload, const char* key){
+  StaticJsonBuffer<1000> buffer;
+  JsonObject& dataMap = buffer.parseObject(payload.c_str())["dataMap"];
+  const char* value = dataMap[key];
+  return value != nullptr ? value : "";
+}
+
+//JSON payloads the bot published to HiveCentral, all of them or of one dataType.
+std::vector<std::string> hivePublished(const char* dataType = nullptr){
+  std::vector<std::string> payloads;
+  for(auto& payload : hostBroker.payloadsOn(mqtt_controller_notify_topic)){
+    if(dataType == nullptr || hiveField(payload, "dataType") == dataType) payloads.push_back(payload);
+  }
+  return payloads;
+}
+
+//instrIds acked with dataType (InstructionCompleted, InstructionFailed), in order.
+std::vector<long> hiveAckedInstrIds(const char* dataType){
+  std::vector<long> instrIds;
+  for(auto& payload : hivePublished(dataType)){
+    StaticJsonBuffer<1000> buffer;
+    JsonArray& instructions = buffer.parseObject(payload.c_str())["instructions"];
+    for(unsigned int i=0;i<instructions.size();i++){
+      instrIds.push_back(instructions.get<JsonVariant>(i).as<JsonObject>()["instrId"].as<long>());
+    }
+  }
+  return instrIds;
+}
+
+//The topic HiveCentral sends this bot's messages to.
+std::string hiveBotRecieveTopic(){
+  char topic[HIVE_TOPIC_MAX];
+  _hiveBotTopic(topic, mqtt_botcli_recieve_topic);
+  return topic;
+}
+
+//A message from HiveCentral to this bot, body is the JSON after the hiveBotId. Arrives now or at atMs.
+void hiveDeliverToBot(const std::string& body, unsigned long atMs = 0){
+  hostBroker.deliver(hiveBotRecieveTopic(), "{\"hiveBotId\":\"" + std::string(bot_id.c_str()) + "\"," + body + "}", atMs);
+}
@@ -0,0 +1,146 @@
+/*
+ * Accelerated time run of the whole bot: setup() and loop() against a scripted HiveCentral,
+ * a day of bot time with a broker outage in the middle, in well under a second.
+ */
+#include "HiveTest.h"
+#include "../HiveMicroClimateBotV3.ino"
+#include "HiveBotSimulation.h"
+#include "HiveFleet.h"
+#include <algorithm>
+
+#define SIMULATED_HOURS 24
+
+//HiveCentral answers every BootupHivebot with the functions and a pending instruction.
+void _hiveCentralCatchup(const HostMqttMessage& message){
+  if(message.topic != mqtt_controller_notify_topic || hiveField(message.payload, "dataType") != "BootupHivebot") return;
+  hiveDeliverToBot("\"dataType\":\"CatchupPostBootup\",\"enabledFunctions\":\",DHT22\","
+    "\"settings\":{\"maxSilenceSecs\":900},"
+    "\"instructions\":[{\"instrId\":7,\"command\":\"IRAC_ONN_PROFILE_A\",\"execute\":\"true\"}]}");
+}
+
+HIVE_TEST(simulatedDayWithBrokerOutage){
+  hostBroker.onPublish = _hiveCentralCatchup;
+  setup();
+  for(int minute=0; minute<SIMULATED_HOURS * 60; minute+=10){
+    //Slow swing of the room, a degree either way over the day.
+    hostDht.temperature = 24.0f + sinf(minute * 2 * M_PI / (24 * 60));
+    if(minute == 6 * 60) hostBroker.drop();
+    if(minute == 6 * 60 + 30) hostBroker.up = true;
+    hiveRunFor(10 * 60 * 1000UL);
+  }
+
+  HIVE_CHECK_EQ(2, hostBroker.connects);
+  HIVE_CHECK_EQ(2, hivePublished("BootupHivebot").size());
+  //Run on the first connect, the replay after the outage is only acked.
+  HIVE_CHECK_EQ(2, hivePublished("InstructionCompleted").size());
+  HIVE_CHECK_EQ(1, hostIr.sent.size());
+
+  std::vector<std::string> sensorData = hivePublished("SensorData");
+  HIVE_CHECK(sensorData.size() >= SIMULATED_HOURS * 3600 / 900 - 4);
+  //Every payload reaches HiveCentral once, in order.
+  std::vector<std::string> payloads = hivePublished();
+  for(size_t i=0;i<payloads.size();i++){
+    HIVE_CHECK_EQ(i + 1, atol(hiveField(payloads[i], "seq").c_str()));
+  }
+}
+
+/*
+ * What one bot adds to an instruction's round trip, and its publish load, over a simulated hour
+ * of instruction traffic. A fleet is N of these against HiveCentral.
+ */
+unsigned long testInstructionSentAtMs[64];
+std::vector<unsigned long> testRoundTripMs;
+void _hiveCentralTimesAcks(const HostMqttMessage& message){
+  if(hiveField(message.payload, "dataType") != "InstructionCompleted") return;
+  StaticJsonBuffer<1000> buffer;
+  JsonArray& instructions = buffer.parseObject(message.payload.c_str())["instructions"];
+  long instrId = instructions.get<JsonVariant>(0).as<JsonObject>()["instrId"].as<long>();
+  testRoundTripMs.push_back(millis() - testInstructionSentAtMs[instrId]);
+}
+
+HIVE_TEST(instructionRoundTripUnderSensorLoad){
+  hostBroker.onPublish = _hiveCentralTimesAcks;
+  setup();
+  hiveRunFor(5000);
+  srand(19);
+  //One a minute at a random point, most arrive while the loop is idle.
+  for(long instrId=1; instrId<=60; instrId++){
+    testInstructionSentAtMs[instrId] = millis() + rand() % 60000UL;
+    hiveDeliverToBot("\"dataType\":\"ExecuteInstruction\",\"instructions\":[{\"instrId\":"
+      + std::to_string(instrId) + ",\"command\":\"LOGTAIL\",\"execute\":\"true\"}]", testInstructionSentAtMs[instrId]);
+    hiveRunFor(60000UL);
+  }
+  hiveRunFor(SCHEDULER_MAX_IDLE_MS);
+
+  HIVE_CHECK_EQ(60, testRoundTripMs.size());
+  std::sort(testRoundTripMs.begin(), testRoundTripMs.end());
+  printf("  round trip at the bot (ms) p50:%lu p99:%lu max:%lu, published:%u\n",
+    testRoundTripMs[29], testRoundTripMs[58], testRoundTripMs[59], (unsigned)hivePublished().size());
+  //An instruction waits at most one idle of the loop.
+  HIVE_CHECK(testRoundTripMs.back() <= SCHEDULER_MAX_IDLE_MS);
+  std::vector<std::string> payloads = hivePublished();
+  for(size_t i=1;i<payloads.size();i++){
+    HIVE_CHECK_EQ(atol(hiveField(payloads[0], "seq").c_str()) + i, atol(hiveField(payloads[i], "seq").c_str()));
+  }
+}
+
+/*
+ * The same traffic to a fleet on the shared topics and on per-bot topics (bots 1-4 and 5-8 linked
+ * in from HiveFleetBot.cpp). Every session on the shared topic takes the whole fleet's messages,
+ * on its own topic a bot takes only its own, broadcasts reach every bot either way.
+ */
+#define FLEET_INSTRUCTIONS_PER_BOT 5
+#define FLEET_BROADCASTS 2
+struct TestFleetRun {
+  std::vector<unsigned long> delivered;
+  std::vector<unsigned long> acked;
+};
+TestFleetRun testRunFleet(HiveFleet& fleet){
+  size_t bots = fleet.bots.size();
+  TestFleetRun run{std::vector<unsigned long>(bots, 0), std::vector<unsigned long>(bots, 0)};
+  fleet.onCentral = [&](size_t bot, const HostMqttMessage& message){
+    if(hiveField(message.payload, "dataType") != "InstructionCompleted") return;
+    StaticJsonBuffer<1000> buffer;
+    JsonArray& instructions = buffer.parseObject(message.payload.c_str())["instructions"];
+    long instrId = instructions.get<JsonVariant>(0).as<JsonObject>()["instrId"].as<long>();
+    HIVE_CHECK_EQ(bot, instrId / 100); //Acked by the bot it was sent to
+    run.acked[bot]++;
+  };
+  fleet.runFor(10 * 1000UL);
+  for(size_t i=0;i<bots;i++) run.delivered[i] = fleet.bots[i].delivered;
+  for(int round=0; round<FLEET_INSTRUCTIONS_PER_BOT; round++){
+    for(size_t bot=0;bot<bots;bot++){
+      fleet.publish(fleet.bots[bot].entry.recieveTopic(), "{\"hiveBotId\":\"" + fleet.bots[bot].botId + "\","
+        "\"dataType\":\"ExecuteInstruction\",\"instructions\":[{\"instrId\":" + std::to_string(bot * 100 + round)
+        + ",\"command\":\"LOGTAIL\",\"execute\":\"true\"}]}");
+      fleet.runFor(500);
+    }
+  }
+  for(int broadcast=0; broadcast<FLEET_BROADCASTS; broadcast++){
+    fleet.publish(mqtt_botcli_broadcast_topic, "{\"dataType\":\"UpdateFunctions\",\"enabledFunctions\":\",DHT22\"}");
+    fleet.runFor(2000);
+  }
+  fleet.runFor(SCHEDULER_MAX_IDLE_MS);
+  for(size_t i=0;i<bots;i++) run.delivered[i] = fleet.bots[i].delivered - run.delivered[i];
+  return run;
+}
+
+HIVE_TEST(fleetDeliveriesSharedAgainstPerBotTopics){
+  HiveFleet shared(true);
+  HiveFleet perBot(false);
+  HIVE_CHECK_EQ(4, shared.bots.size());
+  HIVE_CHECK_EQ(4, perBot.bots.size());
+  TestFleetRun sharedRun = testRunFleet(shared);
+  TestFleetRun perBotRun = testRunFleet(perBot);
+  for(size_t i=0;i<4;i++){
+    HIVE_CHECK(shared.bots[i].entry.recieveTopic() == mqtt_botcli_recieve_topic);
+    HIVE_CHECK(perBot.bots[i].entry.recieveTopic() == std::string(mqtt_botcli_recieve_topic) + "/" + perBot.bots[i].botId);
+    HIVE_CHECK_EQ(4 * FLEET_INSTRUCTIONS_PER_BOT + FLEET_BROADCASTS, sharedRun.delivered[i]);
+    HIVE_CHECK_EQ(FLEET_INSTRUCTIONS_PER_BOT + FLEET_BROADCASTS, perBotRun.delivered[i]);
+    //Either way a bot runs its own instructions and nothing else.
+    HIVE_CHECK_EQ(FLEET_INSTRUCTIONS_PER_BOT, sharedRun.acked[i]);
+    HIVE_CHECK_EQ(FLEET_INSTRUCTIONS_PER_BOT, perBotRun.acked[i]);
+  }
+  printf("  messages delivered per bot, 4 bots: shared topics %lu, per-bot topics %lu\n",
+    sharedRun.delivered[0], perBotRun.delivered[0]);
+}
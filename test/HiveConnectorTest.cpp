@@ -0,0 +1,296 @@
+/*
+ * HiveConnector: publishing, queueing while the broker is away, and the inbound message path.
+ */
+#include "HiveTest.h"
+#include "../HiveMicroClimateBotV3.ino"
+#include "HiveBotSimulation.h"
+#include <chrono>
+
+//A reconnect due from inside publishHivePayload() must not overwrite the payload being published.
+HIVE_TEST(publishWhileOfflineDoesNotReconnect){
+  setup();
+  hiveRunFor(3000);
+  HIVE_CHECK_EQ(1, hostBroker.connects);
+  hostBroker.drop(true); //Broker comes straight back, only the bot has not noticed
+  hostAdvanceMs(5000);   //Reconnect timer is due
+
+  HivePayloadWriter& dataMap = beginHivePayload(DATATYPE_SENSOR_DATA);
+  dataMap.addFixed(HF_Temperature, 23.4, 2);
+  HIVE_CHECK(!publishHivePayload());
+  HIVE_CHECK_EQ(1, hostBroker.connects);
+  HIVE_CHECK(isPublishQueuePending());
+
+  hiveRunFor(5000);
+  HIVE_CHECK_EQ(2, hostBroker.connects);
+  HIVE_CHECK_EQ(2, hivePublished("BootupHivebot").size());
+  std::vector<std::string> sensorData = hivePublished("SensorData");
+  HIVE_CHECK_EQ(1, sensorData.size());
+  HIVE_CHECK_STR("23.40", hiveDataMapField(sensorData[0], "Temperature"));
+}
+
+//A message filling the whole PubSubClient packet buffer is still parsed, nothing written past it.
+HIVE_TEST(messageFillingPacketBufferStaysInBounds){
+  setup();
+  hiveRunFor(3000);
+  HIVE_CHECK(sensorTimer.isEnabled());
+  std::string topic = hiveBotRecieveTopic();
+  std::string head = "{\"hiveBotId\":\"" + std::string(bot_id.c_str()) + "\",\"dataType\":\"UpdateFunctions\",\"enabledFunctions\":\",\",\"pad\":\"";
+  std::string tail = "\"}";
+  size_t payloadLength = MQTT_MAX_PACKET_SIZE - 5 - topic.size(); //Fixed header(3) + topic length(2)
+  hostBroker.deliver(topic, head + std::string(payloadLength - head.size() - tail.size(), 'x') + tail);
+  hiveRunFor(1000);
+  HIVE_CHECK(hostBroker.inbound.empty());
+  HIVE_CHECK_EQ(0, hostBroker.overruns);
+  HIVE_CHECK(!sensorTimer.isEnabled());
+}
+
+long testSeqOf(const std::string& payload){ return atol(hiveField(payload, "seq").c_str()); }
+
+//A payload rejected as too big, or a HeartBeat dropped offline, takes no sequence number.
+HIVE_TEST(droppedPayloadsLeaveNoSeqGap){
+  setup();
+  hiveRunFor(3000);
+  size_t before = hivePublished().size();
+  long lastSeq = testSeqOf(hivePublished().back());
+
+  HivePayloadWriter& dataMap = beginHivePayload(DATATYPE_SENSOR_DATA);
+  dataMap.addString(HF_Temperature, std::string(HIVE_PAYLOAD_BUFFER_SIZE, 'x').c_str());
+  HIVE_CHECK(!publishHivePayload());
+  hostBroker.drop(false);
+  HIVE_CHECK(!publishToHive(DATATYPE_NOTHING_SPECIAL_BUT_LET_THEM_KNOW_I_AM_ALIVE));
+  HIVE_CHECK(!isPublishQueuePending());
+
+  hostBroker.up = true;
+  hiveRunFor(3000);
+  std::vector<std::string> payloads = hivePublished();
+  HIVE_CHECK(payloads.size() > before);
+  HIVE_CHECK_EQ(lastSeq + 1, testSeqOf(payloads[before]));
+}
+
+//Payloads left on flash by the last boot are found before the first publish and go out first.
+HIVE_TEST(queueFromLastBootGoesOutFirst){
+  hostBroker.up = false;
+  setup();
+  for(int i=0;i<2;i++){
+    HivePayloadWriter& dataMap = beginHivePayload(DATATYPE_SENSOR_DATA);
+    dataMap.addFixed(HF_Temperature, 20 + i, 2);
+    HIVE_CHECK(!publishHivePayload());
+  }
+
+  hostReset(true); //Flash and RTC memory kept
+  ESP.resetInfo.reason = REASON_EXT_SYS_RST;
+  _publishQueueMounted = false;
+  _publishQueueEmpty = true;
+  setup();
+  hiveRunFor(5000);
+  std::vector<std::string> payloads = hivePublished();
+  HIVE_CHECK_EQ(3, payloads.size());
+  HIVE_CHECK_STR("SensorData", hiveField(payloads[0], "dataType"));
+  HIVE_CHECK_STR("SensorData", hiveField(payloads[1], "dataType"));
+  HIVE_CHECK_STR("BootupHivebot", hiveField(payloads[2], "dataType"));
+  for(size_t i=1;i<payloads.size();i++){
+    HIVE_CHECK_EQ(testSeqOf(payloads[0]) + i, testSeqOf(payloads[i]));
+  }
+}
+
+//What a reboot clears in the sketch, RTC memory and flash are kept. Woken from DeepSleep.
+void testDeepSleepReboot(){
+  hostReset(true);
+  _publishQueueMounted = false;
+  _publishQueueEmpty = true;
+  memset(bootPhaseAtMs, 0, sizeof(bootPhaseAtMs));
+  bootFastWake = false;
+}
+
+//Woken from DeepSleep the bot rejoins the remembered AP, no WifiManager, and SPIFFS waits for the first publish.
+HIVE_TEST(fastWakeBootPublishesBeforeMountingSPIFFS){
+  setup();
+  hiveRunFor(3000);
+  HIVE_CHECK(!bootFastWake);
+  HIVE_CHECK_EQ(0, WiFi.begins);
+
+  testDeepSleepReboot();
+  WiFi.associateMs = 400;
+  long mountsAtFirstPublish = -1;
+  hostBroker.onPublish = [&](const HostMqttMessage&){
+    if(mountsAtFirstPublish < 0) mountsAtFirstPublish = SPIFFS.mounts;
+  };
+  setup();
+  HIVE_CHECK(bootFastWake);
+  HIVE_CHECK_EQ(1, WiFi.begins);
+  HIVE_CHECK_EQ(6, WiFi.beginChannel);
+  HIVE_CHECK_EQ(0, SPIFFS.mounts);
+  HIVE_CHECK(bootPhaseAtMs[BOOT_PHASE_WIFI_CONNECTED] >= 400);
+  HIVE_CHECK(bootPhaseAtMs[BOOT_PHASE_WIFI_CONNECTED] < 500);
+  hiveRunFor(3000);
+  std::vector<std::string> bootups = hivePublished("BootupHivebot");
+  HIVE_CHECK_EQ(1, bootups.size());
+  HIVE_CHECK_STR("FAST", hiveDataMapField(bootups[0], "bootMode"));
+  HIVE_CHECK_EQ(1, mountsAtFirstPublish); //The publish queue's own check
+  printf("  fast wake: wifi %lums, mqtt %lums, SPIFFS mounted at the first publish\n",
+    bootPhaseAtMs[BOOT_PHASE_WIFI_CONNECTED], bootPhaseAtMs[BOOT_PHASE_MQTT_CONNECTED]);
+
+  //The AP gone, the reconnect times out and the full boot runs, the RTC state is dropped.
+  testDeepSleepReboot();
+  WiFi.associateMs = FAST_WAKE_WIFI_TIMEOUT_MS * 2;
+  setup();
+  HIVE_CHECK(!bootFastWake);
+  HIVE_CHECK_EQ(1, WiFi.begins);
+  HIVE_CHECK(SPIFFS.mounts > 0);
+  HIVE_CHECK(!_fastWakeReconnect());
+}
+
+//Built twice, on the shared topics (default) and with HIVE_SHARED_TOPICS=false.
+HIVE_TEST(subscribesToTheConfiguredTopics){
+  setup();
+  hiveRunFor(3000);
+  std::string shared = mqtt_botcli_recieve_topic;
+  std::string perBot = shared + "/" + bot_id.c_str();
+  HIVE_CHECK_EQ(HIVE_SHARED_TOPICS, hostBroker.isSubscribed(shared));
+  HIVE_CHECK_EQ(!HIVE_SHARED_TOPICS, hostBroker.isSubscribed(perBot));
+  HIVE_CHECK(hostBroker.isSubscribed(mqtt_botcli_broadcast_topic));
+  HIVE_CHECK_STR(HIVE_SHARED_TOPICS ? shared : perBot, hiveBotRecieveTopic());
+
+  //Another bot's message, on the shared topic it reaches this bot and is dropped on hiveBotId.
+  sensorTimer.enabled(true);
+  const std::string disableSensor = "\"dataType\":\"UpdateFunctions\",\"enabledFunctions\":\",\"}";
+  hostBroker.deliver(shared, "{\"hiveBotId\":\"someOtherBot\"," + disableSensor);
+  hostBroker.deliver(shared + "/someOtherBot", "{\"hiveBotId\":\"someOtherBot\"," + disableSensor);
+  hiveRunFor(1000);
+  HIVE_CHECK(sensorTimer.isEnabled());
+  hostBroker.deliver(mqtt_botcli_broadcast_topic, "{" + disableSensor);
+  hiveRunFor(1000);
+  HIVE_CHECK(!sensorTimer.isEnabled());
+}
+
+//The baseline SensorData publish, dataMap and envelope grown by String concatenation.
+String testStringSensorPayload(float temperature, float humidity){
+  String dataMap = "\"Temperature\": \""+ String(temperature) +"\"";
+  dataMap += ",\"HumidityPercent\": \""+ String(humidity) +"\"";
+  String requestPayload = "{";
+  requestPayload += "\"dataType\": \"SensorData\"";
+  requestPayload += ",\"dataMap\": {";
+  requestPayload += dataMap;
+  requestPayload += "}";
+  requestPayload += ",\"hiveBotId\": \"";
+  requestPayload += bot_id;
+  requestPayload += "\",\"accessKey\": \"";
+  requestPayload += hive_accesskey;
+  requestPayload += "\"}";
+  return requestPayload;
+}
+
+double testNsSince(std::chrono::steady_clock::time_point startAt, int runs){
+  return std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - startAt).count() / runs;
+}
+
+//A SensorData publish through the payload writer takes nothing from the heap, the String path does every time.
+HIVE_TEST(publishAllocatesNothing){
+  setup();
+  hiveRunFor(3000);
+  HIVE_CHECK(publishToHive(DATATYPE_NOTHING_SPECIAL_BUT_LET_THEM_KNOW_I_AM_ALIVE)); //Queue checked, SPIFFS mounted
+  const int publishes = 1000;
+
+  hostHeap.counting = true;
+  std::chrono::steady_clock::time_point startAt = std::chrono::steady_clock::now();
+  for(int i=0;i<publishes;i++){
+    HivePayloadWriter& dataMap = beginHivePayload(DATATYPE_SENSOR_DATA);
+    dataMap.addFixed(HF_Temperature, 23.4, 2);
+    dataMap.addFixed(HF_HumidityPercent, 55.1, 2);
+    HIVE_CHECK(publishHivePayload());
+  }
+  double writerNs = testNsSince(startAt, publishes);
+  HostHeap writerHeap = hostHeap;
+
+  hostHeap = HostHeap();
+  hostHeap.counting = true;
+  startAt = std::chrono::steady_clock::now();
+  for(int i=0;i<publishes;i++){
+    String requestPayload = testStringSensorPayload(23.4, 55.1);
+    HIVE_CHECK(client.publish(mqtt_controller_notify_topic, requestPayload.c_str()));
+  }
+  double stringNs = testNsSince(startAt, publishes);
+  HostHeap stringHeap = hostHeap;
+  hostHeap.counting = false;
+
+  printf("  per SensorData publish: writer %lu allocations %lu bytes %.0f ns, String path %lu allocations %lu bytes %.0f ns\n",
+    writerHeap.allocations / publishes, writerHeap.bytes / publishes, writerNs,
+    stringHeap.allocations / publishes, stringHeap.bytes / publishes, stringNs);
+  HIVE_CHECK_EQ(0, writerHeap.allocations);
+  HIVE_CHECK(stringHeap.allocations >= (unsigned long)publishes);
+}
+
+/*
+ * Stack painting: paint a stretch below the caller's frame, call something from the same depth,
+ * the lowest byte no longer painted is how deep it went.
+ */
+#define TEST_STACK_PAINT (64 * 1024)
+uintptr_t testStackBottom;
+__attribute__((noinline)) void testPaintStack(){
+  volatile uint8_t painted[TEST_STACK_PAINT];
+  for(size_t i=0;i<sizeof(painted);i++) painted[i] = 0xA5;
+  testStackBottom = (uintptr_t)&painted[0];
+}
+__attribute__((noinline)) size_t testStackUsed(){
+  volatile uint8_t* painted = (volatile uint8_t*)testStackBottom;
+  size_t unused = 0;
+  while(unused < TEST_STACK_PAINT && painted[unused] == 0xA5) unused++;
+  return TEST_STACK_PAINT - unused;
+}
+
+struct TestInboundCost {
+  double us;
+  size_t stackBytes;
+};
+std::string testInboundTopic;
+char testInboundMessage[MQTT_MAX_PACKET_SIZE];
+int testInboundLength = 0;
+int testInboundRun = 0;
+//body is formatted with bot_id and a new run number, the topic copied, as PubSubClient would hand them over.
+void testFormatInbound(const char* body, char* topic){
+  testInboundLength = snprintf(testInboundMessage, sizeof(testInboundMessage), body, bot_id.c_str(), ++testInboundRun);
+  snprintf(topic, HIVE_TOPIC_MAX, "%s", testInboundTopic.c_str());
+}
+//Timed over runs, then the stack measured over runs more, by then every library call is bound.
+TestInboundCost testInboundCost(const char* body, int runs){
+  testInboundTopic = hiveBotRecieveTopic();
+  TestInboundCost cost = {0, 0};
+  std::chrono::steady_clock::time_point startAt = std::chrono::steady_clock::now();
+  char topic[HIVE_TOPIC_MAX];
+  for(int run=0;run<runs;run++){
+    testFormatInbound(body, topic);
+    callbackMqttMessage(topic, (byte*)testInboundMessage, testInboundLength);
+  }
+  cost.us = testNsSince(startAt, runs) / 1000;
+  testPaintStack();
+  size_t scanBytes = testStackUsed();
+  for(int run=0;run<runs;run++){
+    testFormatInbound(body, topic);
+    testPaintStack();
+    callbackMqttMessage(topic, (byte*)testInboundMessage, testInboundLength);
+    size_t stackBytes = testStackUsed() - scanBytes;
+    if(stackBytes > cost.stackBytes) cost.stackBytes = stackBytes;
+  }
+  return cost;
+}
+
+//Per inbound message: host time and the deepest stack the callback reaches, the JSON pool is not on it.
+HIVE_TEST(inboundMessageCostAndStack){
+  setup();
+  hiveRunFor(3000);
+  const int runs = 200;
+  TestInboundCost updateFunctions = testInboundCost(
+    "{\"hiveBotId\":\"%s\",\"dataType\":\"UpdateFunctions\",\"enabledFunctions\":\",DHT22,IR_LISTEN\",\"seq\":%d}", runs);
+  TestInboundCost execute = testInboundCost(
+    "{\"hiveBotId\":\"%s\",\"dataType\":\"ExecuteInstruction\",\"instructions\":[{\"instrId\":%d,\"command\":\"LATENCY\",\"execute\":\"true\"}]}", runs);
+  TestInboundCost otherBot = testInboundCost(
+    "{\"hiveBotId\":\"x%s\",\"dataType\":\"UpdateFunctions\",\"enabledFunctions\":\",\",\"seq\":%d}", runs);
+  printf("  per inbound message: UpdateFunctions %.1f us %u stack bytes, ExecuteInstruction %.1f us %u, other bot %.2f us %u\n",
+    updateFunctions.us, (unsigned)updateFunctions.stackBytes, execute.us, (unsigned)execute.stackBytes,
+    otherBot.us, (unsigned)otherBot.stackBytes);
+  HIVE_CHECK(irRecieverFunction.isEnabled());
+  HIVE_CHECK_EQ(2 * runs, hiveAckedInstrIds("InstructionCompleted").size());
+  //The callback's own frame, the JSON pool was 1000 of it. Host frames are wider than the ESP8266's 4K loop stack needs.
+  HIVE_CHECK(otherBot.stackBytes < 1000);
+  HIVE_CHECK(execute.stackBytes < 4096);
+}
@@ -0,0 +1,187 @@
+/*
+ * HiveFleet, N copies of the bot on one host against one broker. Each copy is HiveFleetBot.cpp
+ * built into the test once more (hive_add_fleet_bots() in CMakeLists.txt), the sketch inside an
+ * anonymous namespace so every copy keeps globals of its own. The stand-ins stay global: a
+ * bot's clock, RTC, SPIFFS, WiFi, broker session, DHT and IR are swapped in while it runs.
+ *   HiveFleet fleet;                      //Every bot linked in, booted
+ *   fleet.onCentral = [&](size_t bot, const HostMqttMessage& message){ fleet.publish(topic, payload); };
+ *   fleet.runFor(60 * 60 * 1000UL);
+ * The bot furthest behind runs the next loop() pass, so the fleet shares one timeline.
+ * Whatever a bot publishes goes to every session subscribed to the topic, then to onCentral.
+ */
+#pragma once
+#include <Arduino.h>
+#include <time.h>
+#include <FS.h>
+#include <ArduinoJson.h>
+#include <ESP8266WiFi.h>
+#include <ESP8266WebServer.h>
+#include <DNSServer.h>
+#include <WiFiManager.h>
+#include <DoubleResetDetector.h>
+#include <PubSubClient.h>
+#include <DHT.h>
+#include <IRremoteESP8266.h>
+#include <IRrecv.h>
+#include <IRsend.h>
+#include <IRutils.h>
+#include <ir_Daikin.h>
+#include <ir_Fujitsu.h>
+#include <ir_Kelvinator.h>
+#include <ir_Midea.h>
+#include <ir_Toshiba.h>
+#include <SPI.h>
+#include <Wire.h>
+#include <algorithm>
+#include <climits>
+#include <functional>
+#include <string>
+#include <vector>
+
+//What a copy of the sketch hands the fleet, see HiveFleetBot.cpp.
+struct HiveFleetBotEntry {
+  int index;                        //HIVE_FLEET_BOT, the bots run in this order
+  boolean sharedTopics;             //Built with HIVE_SHARED_TOPICS
+  void (*setup)(const char* botId);
+  void (*loop)();
+  std::string (*recieveTopic)();    //Where HiveCentral sends this bot's messages
+};
+inline std::vector<HiveFleetBotEntry>& hiveFleetBotEntries(){
+  static std::vector<HiveFleetBotEntry> entries;
+  return entries;
+}
+inline int hiveFleetRegister(const HiveFleetBotEntry& entry){
+  hiveFleetBotEntries().push_back(entry);
+  return (int)hiveFleetBotEntries().size();
+}
+
+//A bot's side of the host, swapped with the globals while it runs.
+struct HiveFleetHost {
+  HostClock clock = HostClock();
+  HardwareSerial serial;
+  EspClass esp;
+  FS spiffs;
+  WiFiClass wifi;
+  HostBroker broker;
+  HostDht dht;
+  HostIr ir;
+  void swap(){
+    std::swap(clock, hostClock);
+    std::swap(serial, Serial);
+    std::swap(esp, ESP);
+    std::swap(spiffs, SPIFFS);
+    std::swap(wifi, WiFi);
+    std::swap(broker, hostBroker);
+    std::swap(dht, hostDht);
+    std::swap(ir, hostIr);
+  }
+};
+
+struct HiveFleetBot {
+  HiveFleetBotEntry entry;
+  std::string botId;
+  HiveFleetHost host;
+  unsigned long published = 0;      //Messages the bot sent
+  unsigned long delivered = 0;      //Messages the broker handed its session, its or not
+  unsigned long deliveredBytes = 0;
+};
+
+class HiveFleet {
+  public:
+    std::vector<HiveFleetBot> bots;
+    //Every bot publish, the bot swapped in. Answer with publish(), millis() is the bot's.
+    std::function<void(size_t bot, const HostMqttMessage& message)> onCentral;
+    unsigned long botMessages = 0, botBytes = 0;         //Bots to the broker
+    unsigned long centralMessages = 0, centralBytes = 0; //HiveCentral to the broker
+    unsigned long deliveries = 0, deliveredBytes = 0;    //Broker to bot sessions
+
+    //Boots the bots linked in with sharedTopics, or all of them.
+    explicit HiveFleet(int sharedTopics = -1, const char* botIdPrefix = "HIVEBOT_FLEET."){
+      std::vector<HiveFleetBotEntry> entries = hiveFleetBotEntries();
+      std::sort(entries.begin(), entries.end(), [](const HiveFleetBotEntry& a, const HiveFleetBotEntry& b){ return a.index < b.index; });
+      for(auto& entry : entries){
+        if(sharedTopics >= 0 && entry.sharedTopics != (boolean)sharedTopics) continue;
+        HiveFleetBot bot;
+        bot.entry = entry;
+        bot.botId = botIdPrefix + std::to_string(entry.index);
+        bots.push_back(bot);
+      }
+      for(size_t i=0;i<bots.size();i++){
+        _swapIn(i);
+        hostReset(false);
+        hostBroker.onPublish = [this, i](const HostMqttMessage& message){ _botPublished(i, message); };
+        bots[i].entry.setup(bots[i].botId.c_str());
+        _swapOut();
+      }
+    }
+    HiveFleet(const HiveFleet&) = delete;
+    HiveFleet& operator=(const HiveFleet&) = delete;
+
+    //The session of bot, swapped in or not.
+    HostBroker& broker(size_t bot){ return bot == _running ? hostBroker : bots[bot].host.broker; }
+    unsigned long clockMs(size_t bot){ return bot == _running ? hostClock.ms : bots[bot].host.clock.ms; }
+    //Where the fleet has got to, the bot furthest behind.
+    unsigned long nowMs(){
+      unsigned long nowMs = ULONG_MAX;
+      for(size_t i=0;i<bots.size();i++) nowMs = std::min(nowMs, clockMs(i));
+      return bots.empty() ? 0 : nowMs;
+    }
+    //Runs bot while fn does, with its host swapped in.
+    void with(size_t bot, const std::function<void()>& fn){
+      boolean swapped = _running != bot;
+      if(swapped) _swapIn(bot);
+      fn();
+      if(swapped) _swapOut();
+    }
+
+    //HiveCentral publishes, every session subscribed to topic gets it at atMs (now when 0).
+    void publish(const std::string& topic, const std::string& payload, unsigned long atMs = 0){
+      centralMessages++;
+      centralBytes += payload.size();
+      _route(topic, payload, atMs);
+    }
+
+    //loop() passes until every bot is ms further on. A pass that did not sleep is charged 1 ms.
+    void runFor(unsigned long ms){
+      unsigned long endMs = nowMs() + ms;
+      while(!bots.empty()){
+        size_t next = 0;
+        for(size_t i=1;i<bots.size();i++) if(clockMs(i) < clockMs(next)) next = i;
+        if(clockMs(next) >= endMs) break;
+        _swapIn(next);
+        unsigned long beforeMs = millis();
+        bots[next].entry.loop();
+        if(millis() == beforeMs) hostAdvanceMs(1);
+        _swapOut();
+      }
+    }
+
+  private:
+    size_t _running = SIZE_MAX;
+    void _swapIn(size_t bot){
+      bots[bot].host.swap();
+      _running = bot;
+    }
+    void _swapOut(){
+      bots[_running].host.swap();
+      _running = SIZE_MAX;
+    }
+    void _route(const std::string& topic, const std::string& payload, unsigned long atMs){
+      for(size_t i=0;i<bots.size();i++){
+        HostBroker& session = broker(i);
+        if(!session.connected || !session.isSubscribed(topic)) continue;
+        session.deliver(topic, payload, atMs);
+        bots[i].delivered++;
+        bots[i].deliveredBytes += payload.size();
+        deliveries++;
+        deliveredBytes += payload.size();
+      }
+    }
+    void _botPublished(size_t bot, const HostMqttMessage& message){
+      bots[bot].published++;
+      botMessages++;
+      botBytes += message.payload.size();
+      _route(message.topic, message.payload, 0);
+      if(onCentral) onCentral(bot, message);
+    }
+};
@@ -0,0 +1,22 @@
+/*
+ * One bot of HiveFleet, built once per bot with HIVE_FLEET_BOT=<n> (hive_add_fleet_bots()).
+ * The host headers come first from HiveFleet.h, the sketch then only adds its own globals,
+ * inside an anonymous namespace so they belong to this copy.
+ */
+#include "HiveFleet.h"
+
+namespace {
+#include "../HiveMicroClimateBotV3.ino"
+
+void hiveFleetSetup(const char* botId){
+  bot_id = botId;
+  setup();
+}
+std::string hiveFleetRecieveTopic(){
+  char topic[HIVE_TOPIC_MAX];
+  _hiveBotTopic(topic, mqtt_botcli_recieve_topic);
+  return topic;
+}
+int hiveFleetRegistered = hiveFleetRegister(HiveFleetBotEntry{
+  HIVE_FLEET_BOT, HIVE_SHARED_TOPICS, hiveFleetSetup, loop, hiveFleetRecieveTopic});
+}
@@ -0,0 +1,106 @@
+/*
+ * Fleet load on HiveCentral's broker: HIVE_FLEET_BOTS bots for a simulated hour against a
+ * scripted HiveCentral that answers boot-ups and sends an instruction to one bot a second.
+ * Prints what the broker carries, bots to HiveCentral and HiveCentral to the bots' sessions
+ * with its fan-out, the instruction round trip, and seq gaps per bot. Built once with the
+ * shared topics and once per bot (HiveFleetLoadPerBotTest), -DHIVE_FLEET_BOTS=<n> at configure.
+ */
+#include "HiveTest.h"
+#include "../HiveMicroClimateBotV3.ino"
+#include "HiveBotSimulation.h"
+#include "HiveFleet.h"
+#include <algorithm>
+#include <map>
+#include <numeric>
+
+#define FLEET_SIMULATED_MS (60 * 60 * 1000UL)
+#define FLEET_INSTRUCTION_EVERY_MS 1000
+
+std::string testInstruction(const std::string& botId, long instrId){
+  return "{\"hiveBotId\":\"" + botId + "\",\"dataType\":\"ExecuteInstruction\",\"instructions\":[{\"instrId\":"
+    + std::to_string(instrId) + ",\"command\":\"LATENCY\",\"execute\":\"true\"}]}";
+}
+
+HIVE_TEST(fleetLoadOverAnHour){
+  HiveFleet fleet;
+  size_t bots = fleet.bots.size();
+  HIVE_CHECK(bots > 0);
+  if(bots == 0) return;
+  std::map<long, unsigned long> sentAtMs;
+  std::vector<unsigned long> roundTripMs;
+  std::vector<long> lastSeq(bots, 0);
+  std::vector<unsigned long> addressed(bots, 0);
+  unsigned long seqGaps = 0;
+
+  fleet.onCentral = [&](size_t bot, const HostMqttMessage& message){
+    if(message.topic != mqtt_controller_notify_topic) return;
+    long seq = atol(hiveField(message.payload, "seq").c_str());
+    if(lastSeq[bot] != 0 && seq != lastSeq[bot] + 1) seqGaps++;
+    lastSeq[bot] = seq;
+    std::string dataType = hiveField(message.payload, "dataType");
+    if(dataType == "BootupHivebot"){
+      addressed[bot]++;
+      fleet.publish(fleet.bots[bot].entry.recieveTopic(), "{\"hiveBotId\":\"" + fleet.bots[bot].botId + "\","
+        "\"dataType\":\"CatchupPostBootup\",\"enabledFunctions\":\",DHT22\",\"settings\":{\"maxSilenceSecs\":300}}");
+    }else if(dataType == "InstructionCompleted"){
+      StaticJsonBuffer<1000> buffer;
+      JsonArray& instructions = buffer.parseObject(message.payload.c_str())["instructions"];
+      long instrId = instructions.get<JsonVariant>(0).as<JsonObject>()["instrId"].as<long>();
+      if(sentAtMs.count(instrId)) roundTripMs.push_back(millis() - sentAtMs[instrId]);
+    }
+  };
+
+  fleet.runFor(10 * 1000UL); //Connected, functions on
+  unsigned long startMs = fleet.nowMs();
+  unsigned long botMessages = fleet.botMessages, botBytes = fleet.botBytes;
+  unsigned long centralMessages = fleet.centralMessages, centralBytes = fleet.centralBytes;
+  unsigned long deliveries = fleet.deliveries, deliveredBytes = fleet.deliveredBytes;
+  std::vector<unsigned long> delivered;
+  for(auto& bot : fleet.bots) delivered.push_back(bot.delivered);
+  std::fill(addressed.begin(), addressed.end(), 0);
+  srand(23);
+  long instrId = 0;
+  for(unsigned long atMs=0; atMs<FLEET_SIMULATED_MS; atMs+=FLEET_INSTRUCTION_EVERY_MS){
+    size_t bot = instrId % bots;
+    instrId++;
+    sentAtMs[instrId] = fleet.nowMs() + rand() % FLEET_INSTRUCTION_EVERY_MS;
+    addressed[bot]++;
+    fleet.publish(fleet.bots[bot].entry.recieveTopic(), testInstruction(fleet.bots[bot].botId, instrId), sentAtMs[instrId]);
+    if(atMs % (10 * 60 * 1000UL) == 0){
+      //Each room drifts on its own, the sensor reports follow.
+      for(size_t i=0;i<bots;i++) fleet.with(i, [&]{ hostDht.temperature = 22.0f + rand() % 400 / 100.0f; });
+    }
+    fleet.runFor(FLEET_INSTRUCTION_EVERY_MS);
+  }
+  fleet.runFor(SCHEDULER_MAX_IDLE_MS);
+
+  double secs = (fleet.nowMs() - startMs) / 1000.0;
+  botMessages = fleet.botMessages - botMessages;
+  botBytes = fleet.botBytes - botBytes;
+  centralMessages = fleet.centralMessages - centralMessages;
+  centralBytes = fleet.centralBytes - centralBytes;
+  deliveries = fleet.deliveries - deliveries;
+  deliveredBytes = fleet.deliveredBytes - deliveredBytes;
+  std::sort(roundTripMs.begin(), roundTripMs.end());
+  HIVE_CHECK_EQ(instrId, roundTripMs.size());
+  if(roundTripMs.empty()) return;
+  printf("  %lu bots, %s topics, %.0f s of bot time\n", (unsigned long)bots,
+    fleet.bots[0].entry.sharedTopics ? "shared" : "per bot", secs);
+  printf("  bots to HiveCentral: %.2f msg/s %.0f B/s, %lu messages\n", botMessages / secs, botBytes / secs, botMessages);
+  printf("  HiveCentral to bots: %.2f msg/s %.0f B/s, delivered %.2f msg/s %.0f B/s, fan-out %.2f\n",
+    centralMessages / secs, centralBytes / secs, deliveries / secs, deliveredBytes / secs, (double)deliveries / centralMessages);
+  printf("  per bot: %.0f messages delivered for %.0f of its own\n",
+    (double)deliveries / bots, (double)std::accumulate(addressed.begin(), addressed.end(), 0UL) / bots);
+  printf("  instruction round trip (ms) p50:%lu p99:%lu max:%lu, seq gaps:%lu\n",
+    roundTripMs[roundTripMs.size() / 2], roundTripMs[roundTripMs.size() * 99 / 100], roundTripMs.back(), seqGaps);
+
+  HIVE_CHECK_EQ(0, seqGaps);
+  //client.loop() takes one packet a pass, on the shared topic a bot's instruction can queue behind
+  //other bots' messages for part of another idle. On its own topic it waits one idle at most.
+  HIVE_CHECK(roundTripMs.back() <= (fleet.bots[0].entry.sharedTopics ? 2 : 1) * SCHEDULER_MAX_IDLE_MS);
+  for(size_t i=0;i<bots;i++){
+    HIVE_CHECK_EQ(1, fleet.broker(i).connects);
+    //A session gets every bot's messages on the shared topic, only its own on its topic.
+    HIVE_CHECK_EQ(fleet.bots[i].entry.sharedTopics ? centralMessages : addressed[i], fleet.bots[i].delivered - delivered[i]);
+  }
+}
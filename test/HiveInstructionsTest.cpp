@@ -0,0 +1,175 @@
+/*
+ * HiveInstructions: registry lookup, params, dispatch and its acks.
+ */
+#include "HiveTest.h"
+#include "../HiveMicroClimateBotV3.ino"
+#include "HiveBotSimulation.h"
+
+void testClearInstructionRegistry(){
+  memset(_instructionRegistry, 0, sizeof(_instructionRegistry));
+  _instructionRegistryCount = 0;
+}
+
+int testInstructionRuns = 0;
+int testInstructionOk(long instrId, const char* params){ testInstructionRuns++; return INSTRUCTION_OK; }
+int testInstructionFailed(long instrId, const char* params){ testInstructionRuns++; return INSTRUCTION_FAILED; }
+
+HIVE_TEST(commandHashIsFnv1a){
+  HIVE_CHECK_EQ(2166136261UL, hiveCommandHash(""));
+  HIVE_CHECK_EQ(0xE40C292CUL, hiveCommandHash("a"));
+  HIVE_CHECK_EQ(hiveCommandHash("LEDDANCE"), (HiveCommandKey<hiveCommandHash("LEDDANCE")>::value));
+}
+
+HIVE_TEST(registryFindsEveryCommandUpToCapacity){
+  testClearInstructionRegistry();
+  static char commands[INSTRUCTION_REGISTRY_SIZE / 2 + 1][8];
+  for(int i=0;i<INSTRUCTION_REGISTRY_SIZE / 2;i++){
+    snprintf(commands[i], sizeof(commands[i]), "CMD%d", i);
+    HIVE_CHECK(registerInstruction(hiveCommandHash(commands[i]), commands[i], testInstructionOk));
+  }
+  snprintf(commands[INSTRUCTION_REGISTRY_SIZE / 2], 8, "FULL");
+  HIVE_CHECK(!registerInstruction(hiveCommandHash("FULL"), commands[INSTRUCTION_REGISTRY_SIZE / 2], testInstructionOk));
+  //Slots collide at this fill, every one is still found past the probe.
+  for(int i=0;i<INSTRUCTION_REGISTRY_SIZE / 2;i++){
+    HIVE_CHECK(findInstructionHandler(commands[i]) == testInstructionOk);
+  }
+  HIVE_CHECK(findInstructionHandler("FULL") == NULL);
+  HIVE_CHECK(findInstructionHandler("CMD") == NULL);
+  HIVE_CHECK(findInstructionHandler("") == NULL);
+}
+
+HIVE_TEST(instructionParams){
+  const char* params = "id=4,temp=22,mode=COOL";
+  HIVE_CHECK_EQ(4, instructionParamLong(params, "id", -1));
+  HIVE_CHECK_EQ(22, instructionParamLong(params, "temp", -1));
+  HIVE_CHECK_EQ(-1, instructionParamLong(params, "te", -1));
+  HIVE_CHECK_EQ(-1, instructionParamLong(params, "fan", -1));
+  HIVE_CHECK_STR("COOL", findInstructionParam(params, "mode"));
+  HIVE_CHECK(findInstructionParam("", "id") == NULL);
+}
+
+HIVE_TEST(dispatchAcksEachResultOnce){
+  testClearInstructionRegistry();
+  setup();
+  REGISTER_INSTRUCTION("TESTOK", testInstructionOk);
+  REGISTER_INSTRUCTION("TESTFAIL", testInstructionFailed);
+  hiveRunFor(3000);
+  HIVE_CHECK_EQ(1, hostBroker.connects);
+
+  hiveDeliverToBot("\"dataType\":\"ExecuteInstruction\",\"instructions\":["
+    "{\"instrId\":41,\"command\":\"TESTOK\",\"execute\":\"true\"},"
+    "{\"instrId\":42,\"command\":\"TESTFAIL\",\"execute\":\"true\"},"
+    "{\"instrId\":43,\"command\":\"NOSUCHCOMMAND\",\"execute\":\"true\"}]");
+  hiveRunFor(1000);
+  HIVE_CHECK_EQ(2, testInstructionRuns);
+  HIVE_CHECK(hiveAckedInstrIds("InstructionCompleted") == std::vector<long>({41}));
+  HIVE_CHECK(hiveAckedInstrIds("InstructionFailed") == std::vector<long>({42}));
+
+  //A replay of an executed instruction is acked again, not run again. A failed one is retried.
+  hiveDeliverToBot("\"dataType\":\"ExecuteInstruction\",\"instructions\":["
+    "{\"instrId\":41,\"command\":\"TESTOK\",\"execute\":\"true\"},"
+    "{\"instrId\":42,\"command\":\"TESTFAIL\",\"execute\":\"true\"}]");
+  hiveRunFor(1000);
+  HIVE_CHECK_EQ(3, testInstructionRuns);
+  HIVE_CHECK(hiveAckedInstrIds("InstructionCompleted") == std::vector<long>({41, 41}));
+  HIVE_CHECK(hiveAckedInstrIds("InstructionFailed") == std::vector<long>({42, 42}));
+}
+
+//Next lookup loads the cache again, from RTC memory or flash as after a wake or a power on.
+void testReloadInstructionCache(){
+  memset(&instructionCache, 0xEE, sizeof(instructionCache));
+  _instructionCacheLoaded = false;
+  _instructionCacheDirty = false;
+}
+
+HIVE_TEST(executedCacheEvictsOldest){
+  testReloadInstructionCache();
+  for(long instrId=1; instrId<=INSTRUCTION_CACHE_SIZE + 1; instrId++) markInstructionExecuted(instrId);
+  HIVE_CHECK(!isInstructionExecuted(1));
+  for(long instrId=2; instrId<=INSTRUCTION_CACHE_SIZE + 1; instrId++) HIVE_CHECK(isInstructionExecuted(instrId));
+  markInstructionExecuted(0); //No instrId, nothing to match a replay on
+  HIVE_CHECK(!isInstructionExecuted(0));
+  HIVE_CHECK(isInstructionExecuted(2));
+}
+
+HIVE_TEST(executedCacheSurvivesDeepSleepAndPowerLoss){
+  testReloadInstructionCache();
+  markInstructionExecuted(101);
+  markInstructionExecuted(102);
+  flushInstructionCache(); //As before every DeepSleep
+
+  hostReset(true); //DeepSleep, RTC memory kept
+  testReloadInstructionCache();
+  HIVE_CHECK(isInstructionExecuted(101));
+  HIVE_CHECK(isInstructionExecuted(102));
+
+  hostReset(true);
+  memset(ESP.rtcMemory, 0, sizeof(ESP.rtcMemory)); //Power loss, only flash kept
+  testReloadInstructionCache();
+  HIVE_CHECK(isInstructionExecuted(101));
+  HIVE_CHECK(isInstructionExecuted(102));
+  HIVE_CHECK(!isInstructionExecuted(103));
+}
+
+HIVE_TEST(corruptExecutedCacheStartsEmpty){
+  testReloadInstructionCache();
+  markInstructionExecuted(201);
+  flushInstructionCache();
+  hostReset(true);
+  ESP.rtcMemory[RTC_INSTRUCTION_CACHE_ADDRESS + 4] ^= 1;
+  auto& cacheFile = *SPIFFS.files[INSTRUCTION_CACHE_FILE];
+  cacheFile[cacheFile.size() - 1] ^= 1;
+  testReloadInstructionCache();
+  HIVE_CHECK(!isInstructionExecuted(201));
+  markInstructionExecuted(202);
+  HIVE_CHECK(isInstructionExecuted(202));
+}
+
+//A burst of instructions is one flash write once the oldest is INSTRUCTION_CACHE_FLUSH_MS old.
+//Power lost after it, the replay in the next CatchupPostBootup is acked and not run.
+HIVE_TEST(replayAfterPowerLossIsAckedNotRun){
+  testClearInstructionRegistry();
+  testReloadInstructionCache();
+  setup();
+  REGISTER_INSTRUCTION("TESTOK", testInstructionOk);
+  hiveRunFor(3000);
+  testInstructionRuns = 0;
+  hiveDeliverToBot("\"dataType\":\"ExecuteInstruction\",\"instructions\":["
+    "{\"instrId\":51,\"command\":\"TESTOK\",\"execute\":\"true\"},"
+    "{\"instrId\":52,\"command\":\"TESTOK\",\"execute\":\"true\"}]");
+  hiveRunFor(1000);
+  HIVE_CHECK_EQ(2, testInstructionRuns);
+  HIVE_CHECK(!SPIFFS.exists(INSTRUCTION_CACHE_FILE));
+  hiveRunFor(INSTRUCTION_CACHE_FLUSH_MS);
+  HIVE_CHECK(SPIFFS.exists(INSTRUCTION_CACHE_FILE));
+
+  hostReset(true);
+  memset(ESP.rtcMemory, 0, sizeof(ESP.rtcMemory)); //Power loss, only flash kept
+  ESP.resetInfo.reason = REASON_DEFAULT_RST;
+  _publishQueueMounted = false;
+  _publishQueueEmpty = true;
+  testClearInstructionRegistry();
+  testReloadInstructionCache();
+  setup();
+  REGISTER_INSTRUCTION("TESTOK", testInstructionOk);
+  hiveRunFor(3000);
+  hiveDeliverToBot("\"dataType\":\"CatchupPostBootup\",\"instructions\":["
+    "{\"instrId\":52,\"command\":\"TESTOK\",\"execute\":\"true\"},"
+    "{\"instrId\":53,\"command\":\"TESTOK\",\"execute\":\"true\"}]");
+  hiveRunFor(1000);
+  HIVE_CHECK_EQ(3, testInstructionRuns);
+  HIVE_CHECK(hiveAckedInstrIds("InstructionCompleted") == std::vector<long>({52, 53}));
+}
+
+//A REBOOT saves the flash copy before it sleeps, whatever the timer.
+HIVE_TEST(rebootFlushesExecutedCache){
+  testReloadInstructionCache();
+  setup();
+  hiveRunFor(3000);
+  callbackInstructionRecieved(61, "REBOOT", "");
+  HIVE_CHECK_EQ(1, ESP.deepSleeps);
+  HIVE_CHECK(SPIFFS.exists(INSTRUCTION_CACHE_FILE));
+  testReloadInstructionCache();
+  memset(ESP.rtcMemory, 0, sizeof(ESP.rtcMemory));
+  HIVE_CHECK(isInstructionExecuted(61));
+}
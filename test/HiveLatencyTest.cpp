@@ -0,0 +1,78 @@
+/*
+ * HiveLatency histograms: bucket edges, percentile ranks and halving at a full bucket.
+ */
+#include "HiveTest.h"
+#include "../HiveMicroClimateBotV3.ino"
+
+//Exact up to 3us, then 4 buckets per power of two.
+HIVE_TEST(bucketEdges){
+  for(uint32_t us=0;us<4;us++) HIVE_CHECK_EQ(us, _latencyBucket(us));
+  HIVE_CHECK_EQ(4, _latencyBucket(4));
+  HIVE_CHECK_EQ(7, _latencyBucket(7));
+  HIVE_CHECK_EQ(8, _latencyBucket(8));
+  HIVE_CHECK_EQ(8, _latencyBucket(9));
+  HIVE_CHECK_EQ(9, _latencyBucket(10));
+  HIVE_CHECK_EQ(7, _latencyBucketUpperUs(7));
+  HIVE_CHECK_EQ(9, _latencyBucketUpperUs(8));
+
+  //The last bucket holds the top quarter below 2^26us and everything from 2^26us up.
+  HIVE_CHECK_EQ(LATENCY_BUCKETS - 1, _latencyBucket((1UL << LATENCY_MAX_BITS) - 1));
+  HIVE_CHECK_EQ(LATENCY_BUCKETS - 2, _latencyBucket((7UL << (LATENCY_MAX_BITS - 3)) - 1));
+  HIVE_CHECK_EQ(LATENCY_BUCKETS - 1, _latencyBucket(1UL << LATENCY_MAX_BITS));
+  HIVE_CHECK_EQ(LATENCY_BUCKETS - 1, _latencyBucket(UINT32_MAX));
+  HIVE_CHECK_EQ((1UL << LATENCY_MAX_BITS) - 1, _latencyBucketUpperUs(LATENCY_BUCKETS - 1));
+}
+
+//Buckets tile the range: each upper bound is in its bucket, the next microsecond in the next one.
+HIVE_TEST(bucketsAreContiguousAndAtMostAQuarterWide){
+  uint32_t lowerUs = 0;
+  for(int bucket=0;bucket<LATENCY_BUCKETS;bucket++){
+    uint32_t upperUs = _latencyBucketUpperUs(bucket);
+    HIVE_CHECK_EQ(bucket, _latencyBucket(lowerUs));
+    HIVE_CHECK_EQ(bucket, _latencyBucket(upperUs));
+    if(bucket + 1 < LATENCY_BUCKETS) HIVE_CHECK_EQ(bucket + 1, _latencyBucket(upperUs + 1));
+    HIVE_CHECK((upperUs - lowerUs) * 4 <= (lowerUs > 4 ? lowerUs : 4));
+    lowerUs = upperUs + 1;
+  }
+}
+
+//The percentile is the upper bound of the bucket holding rank ceil(n * p / 100), capped at the max.
+HIVE_TEST(percentileRank){
+  resetLatencyHistograms();
+  HIVE_CHECK_EQ(0, latencyPercentileUs(LATENCY_LOOP, 50));
+  for(uint32_t us=1;us<=100;us++) latencyRecord(LATENCY_LOOP, us);
+  HIVE_CHECK_EQ(100, latencyHistograms[LATENCY_LOOP].count);
+  HIVE_CHECK_EQ(100, latencyHistograms[LATENCY_LOOP].maxUs);
+  HIVE_CHECK_EQ(55, latencyPercentileUs(LATENCY_LOOP, 50));  //50 is in 48..55
+  HIVE_CHECK_EQ(100, latencyPercentileUs(LATENCY_LOOP, 99)); //99 is in 96..111, capped
+  HIVE_CHECK_EQ(1, latencyPercentileUs(LATENCY_LOOP, 1));
+
+  //Rank rounds up: of three, p50 is the second.
+  resetLatencyHistograms();
+  latencyRecord(LATENCY_PUBLISH, 2);
+  latencyRecord(LATENCY_PUBLISH, 3);
+  latencyRecord(LATENCY_PUBLISH, 1000);
+  HIVE_CHECK_EQ(3, latencyPercentileUs(LATENCY_PUBLISH, 50));
+  HIVE_CHECK_EQ(3, latencyPercentileUs(LATENCY_PUBLISH, 66));
+  HIVE_CHECK_EQ(1000, latencyPercentileUs(LATENCY_PUBLISH, 67));
+  HIVE_CHECK_EQ(0, latencyPercentileUs(LATENCY_LOOP, 50));
+}
+
+//A bucket at UINT16_MAX halves them all before counting on, the count and max stay exact.
+HIVE_TEST(fullBucketHalvesTheHistogram){
+  resetLatencyHistograms();
+  for(long i=0;i<UINT16_MAX;i++) latencyRecord(LATENCY_INSTRUCTION, 5);
+  for(int i=0;i<11;i++) latencyRecord(LATENCY_INSTRUCTION, 5000);
+  LatencyHistogram& histogram = latencyHistograms[LATENCY_INSTRUCTION];
+  HIVE_CHECK_EQ(UINT16_MAX, histogram.buckets[_latencyBucket(5)]);
+  HIVE_CHECK_EQ(5, latencyPercentileUs(LATENCY_INSTRUCTION, 99));
+
+  latencyRecord(LATENCY_INSTRUCTION, 5);
+  HIVE_CHECK_EQ(UINT16_MAX / 2 + 1, histogram.buckets[_latencyBucket(5)]);
+  HIVE_CHECK_EQ(5, histogram.buckets[_latencyBucket(5000)]);
+  HIVE_CHECK_EQ(UINT16_MAX + 12, histogram.count);
+  HIVE_CHECK_EQ(5000, histogram.maxUs);
+  HIVE_CHECK_EQ(5, latencyPercentileUs(LATENCY_INSTRUCTION, 50));
+  HIVE_CHECK_EQ(5, latencyPercentileUs(LATENCY_INSTRUCTION, 99));
+  HIVE_CHECK_EQ(5000, latencyPercentileUs(LATENCY_INSTRUCTION, 100));
+}
@@ -0,0 +1,84 @@
+/*
+ * HiveLog: the ring between hiveLogWrite() and the UART, overflow, long lines and LOGTAIL.
+ */
+#include "HiveTest.h"
+#include "../HiveMicroClimateBotV3.ino"
+
+//Empty ring, counters at start, or near their wrap.
+void testResetHiveLog(uint32_t counters = 0){
+  _hiveLogWritten = counters;
+  _hiveLogDrained = counters;
+  hiveLogAsync = true;
+}
+
+HIVE_TEST(drainSendsOnlyWhatTheUartTakes){
+  testResetHiveLog();
+  HIVE_LOG_INFO("TEST", "value=%d", 42);
+  HIVE_CHECK(Serial.output.empty()); //Async, only queued
+  HIVE_CHECK(isHiveLogPending());
+  Serial.room = 10;
+  drainHiveLog();
+  HIVE_CHECK_STR("INFO : [TE", Serial.output);
+  Serial.room = 128;
+  drainHiveLog();
+  HIVE_CHECK_STR("INFO : [TEST] value=42\n", Serial.output);
+  HIVE_CHECK(!isHiveLogPending());
+}
+
+HIVE_TEST(syncUntilSetupIsDone){
+  testResetHiveLog();
+  hiveLogAsync = false;
+  HIVE_LOG_ERROR("TEST", "now");
+  HIVE_CHECK_STR("ERROR: [TEST] now\n", Serial.output);
+  HIVE_CHECK(!isHiveLogPending());
+}
+
+HIVE_TEST(fullRingDropsNewLinesAndReportsThem){
+  testResetHiveLog(0xFFFFFF00UL); //Counters wrap while the ring fills
+  Serial.room = 0;
+  uint32_t droppedBefore = hiveLogDroppedLines;
+  const int lineLength = 24; //"DEBUG: [TEST] line 0000\n"
+  int lines = 0;
+  while(hiveLogDroppedLines == droppedBefore){
+    HIVE_LOG_DEBUG("TEST", "line %04d", lines++);
+  }
+  int kept = lines - 1;
+  HIVE_CHECK_EQ(HIVE_LOG_BUFFER_SIZE / lineLength, kept);
+  HIVE_LOG_DEBUG("TEST", "line %04d", lines++);
+  HIVE_CHECK_EQ(2, hiveLogDroppedLines - droppedBefore);
+
+  //The UART catches up: every kept line whole and in order, then the drop is reported.
+  Serial.room = 1 << 16;
+  drainHiveLog();
+  HIVE_CHECK_EQ(kept * lineLength, Serial.output.size());
+  HIVE_CHECK_STR("DEBUG: [TEST] line 0000\n", Serial.output.substr(0, lineLength));
+  char last[32];
+  snprintf(last, sizeof(last), "DEBUG: [TEST] line %04d\n", kept - 1);
+  HIVE_CHECK_STR(last, Serial.output.substr(Serial.output.size() - lineLength));
+  Serial.output.clear();
+  drainHiveLog();
+  HIVE_CHECK_STR("WARN : [LOG] 2 lines dropped, UART behind.\n", Serial.output);
+}
+
+HIVE_TEST(longLinesAreCut){
+  testResetHiveLog();
+  Serial.room = 1024;
+  HIVE_LOG_DEBUG("TEST", "%s", std::string(300, 'x').c_str());
+  drainHiveLog();
+  HIVE_CHECK_EQ(HIVE_LOG_LINE_MAX, Serial.output.size());
+  HIVE_CHECK_STR("..\n", Serial.output.substr(Serial.output.size() - 3));
+}
+
+HIVE_TEST(tailHasWholeRecentLinesOnly){
+  testResetHiveLog(0xFFFFFFF0UL);
+  Serial.room = 1 << 16;
+  for(int i=0;i<200;i++){
+    HIVE_LOG_DEBUG("TEST", "line %04d", i);
+    drainHiveLog();
+  }
+  char tail[100];
+  size_t length = readHiveLogTail(tail, sizeof(tail));
+  HIVE_CHECK_EQ(strlen(tail), length);
+  //99 bytes fit four 24 byte lines, the partial line before them is skipped.
+  HIVE_CHECK_STR("DEBUG: [TEST] line 0196\nDEBUG: [TEST] line 0197\nDEBUG: [TEST] line 0198\nDEBUG: [TEST] line 0199\n", tail);
+}
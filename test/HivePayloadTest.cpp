@@ -0,0 +1,310 @@
+/*
+ * HivePayloadWriter, the same calls written as JSON and as MSGPACK. Each encoding is read back
+ * into one tree by a decoder of its own here, and the two trees must say the same thing:
+ * fixed point integers against their "23.40" text, DATATYPE_ codes against their names.
+ */
+#include "HiveTest.h"
+#include "../HiveMicroClimateBotV3.ino"
+#include "HiveBotSimulation.h"
+#include <climits>
+#include <functional>
+#include <vector>
+
+struct TestValue {
+  enum Kind { NUMBER, TEXT, BYTES, MAP, ARRAY } kind = NUMBER;
+  long number = 0;
+  std::string text;                               //TEXT, BYTES
+  std::vector<std::pair<int, TestValue>> members; //MAP, keyed by field id
+  std::vector<TestValue> items;                   //ARRAY
+};
+
+/* MSGPACK, the subset the writer produces. Anything else fails the test. */
+uint32_t testBigEndian(const uint8_t*& at, int bytes){
+  uint32_t value = 0;
+  while(bytes-- > 0) value = (value << 8) | *at++;
+  return value;
+}
+TestValue testUnpack(const uint8_t*& at, const uint8_t* end){
+  TestValue value;
+  HIVE_CHECK(at < end);
+  if(at >= end) return value;
+  uint8_t marker = *at++;
+  if(marker < 0x80){
+    value.number = marker;
+  }else if(marker >= 0xE0){
+    value.number = (int8_t)marker;
+  }else if(marker == 0xD0 || marker == 0xD1 || marker == 0xD2){
+    int bytes = marker == 0xD0 ? 1 : marker == 0xD1 ? 2 : 4;
+    uint32_t raw = testBigEndian(at, bytes);
+    value.number = bytes == 1 ? (long)(int8_t)raw : bytes == 2 ? (long)(int16_t)raw : (long)(int32_t)raw;
+  }else if((marker & 0xE0) == 0xA0 || marker == 0xD9 || marker == 0xDA || marker == 0xC4 || marker == 0xC5){
+    size_t length = (marker & 0xE0) == 0xA0 ? (marker & 0x1F)
+      : testBigEndian(at, marker == 0xD9 || marker == 0xC4 ? 1 : 2);
+    value.kind = marker == 0xC4 || marker == 0xC5 ? TestValue::BYTES : TestValue::TEXT;
+    HIVE_CHECK(at + length <= end);
+    value.text.assign((const char*)at, length);
+    at += length;
+  }else if(marker == 0xDE){
+    value.kind = TestValue::MAP;
+    for(uint32_t count = testBigEndian(at, 2); count > 0 && at < end; count--){
+      TestValue key = testUnpack(at, end);
+      HIVE_CHECK(key.kind == TestValue::NUMBER && key.number >= 0 && key.number < HF_FIELD_COUNT);
+      value.members.push_back({(int)key.number, testUnpack(at, end)});
+    }
+  }else if(marker == 0xDC){
+    value.kind = TestValue::ARRAY;
+    for(uint32_t count = testBigEndian(at, 2); count > 0 && at < end; count--){
+      value.items.push_back(testUnpack(at, end));
+    }
+  }else{
+    hiveTestFail(__FILE__, __LINE__, "known MSGPACK marker", std::to_string(marker));
+  }
+  return value;
+}
+//The whole buffer is one value, nothing left over.
+TestValue testUnpackAll(const std::string& packed){
+  const uint8_t* at = (const uint8_t*)packed.data();
+  const uint8_t* end = at + packed.size();
+  TestValue value = testUnpack(at, end);
+  HIVE_CHECK(at == end);
+  return value;
+}
+
+/* JSON, as the writer writes it: no spaces, \" \\ and \u00XX escapes, integers unquoted. */
+TestValue testParseJson(const char*& at){
+  TestValue value;
+  if(*at == '{' || *at == '['){
+    boolean isMap = *at++ == '{';
+    value.kind = isMap ? TestValue::MAP : TestValue::ARRAY;
+    while(*at != (isMap ? '}' : ']') && *at != '\0'){
+      if(isMap){
+        TestValue key = testParseJson(at);
+        int field = 0;
+        while(field < HF_FIELD_COUNT && key.text != hivePayloadFieldNames[field]) field++;
+        HIVE_CHECK(field < HF_FIELD_COUNT);
+        HIVE_CHECK(*at == ':');
+        at++;
+        value.members.push_back({field, testParseJson(at)});
+      }else{
+        value.items.push_back(testParseJson(at));
+      }
+      if(*at == ',') at++;
+    }
+    at++;
+  }else if(*at == '"'){
+    value.kind = TestValue::TEXT;
+    for(at++; *at != '"' && *at != '\0'; at++){
+      if(*at == '\\' && at[1] == 'u'){
+        value.text += (char)strtol(std::string(at + 2, 4).c_str(), NULL, 16);
+        at += 5;
+      }else{
+        if(*at == '\\') at++;
+        value.text += *at;
+      }
+    }
+    at++;
+  }else{
+    char* numberEnd;
+    value.number = strtol(at, &numberEnd, 10);
+    HIVE_CHECK(numberEnd != at);
+    at = numberEnd != at ? numberEnd : at + strlen(at); //Not JSON, stop here
+  }
+  return value;
+}
+
+std::string testBase64(const std::string& bytes){
+  char encoded[HIVE_PAYLOAD_BUFFER_SIZE * 2];
+  HivePayloadWriter writer(encoded, sizeof(encoded));
+  writer.addBytes(HF_IrState, (const uint8_t*)bytes.data(), bytes.size());
+  std::string text = writer.c_str(); //"IRState":"...."
+  return text.substr(strlen("\"IRState\":\""), text.size() - strlen("\"IRState\":\"") - 1);
+}
+//"23.40" is 2340, "-1" is -1. "nan", "ovf" and text past int32 (JSON goes to 4e9) are the int32 minimum.
+boolean testFixedMatches(const std::string& text, long number){
+  if(text == "nan" || text == "ovf") return number == (long)INT32_MIN;
+  std::string digits;
+  for(char c : text) if(c != '.') digits += c;
+  char* digitsEnd;
+  long long parsed = strtoll(digits.c_str(), &digitsEnd, 10);
+  if(digits.empty() || *digitsEnd != '\0') return false;
+  if(parsed >= 2000000000LL || parsed <= -2000000000LL) return number == (long)INT32_MIN;
+  return parsed == number;
+}
+const char* testDataTypeName(long code){
+  switch(code){
+    case DATATYPE_SENSOR_DATA: return "SensorData";
+    case DATATYPE_INSTRUCTION_COMPLETED: return "InstructionCompleted";
+    case DATATYPE_INSTRUCTION_EXEFAILED: return "InstructionFailed";
+    case DATATYPE_BOOTUP_NOTIFY: return "BootupHivebot";
+    default: return "HeartBeat";
+  }
+}
+//Same message, path names where it differs.
+std::string testCompare(const TestValue& packed, const TestValue& json, const std::string& path, int field = -1){
+  if(packed.kind == TestValue::NUMBER && json.kind == TestValue::TEXT){
+    if(field == HF_DataType) return json.text == testDataTypeName(packed.number) ? "" : path;
+    return testFixedMatches(json.text, packed.number) ? "" : path;
+  }
+  if(packed.kind == TestValue::BYTES && json.kind == TestValue::TEXT){
+    return testBase64(packed.text) == json.text ? "" : path;
+  }
+  if(packed.kind != json.kind) return path;
+  if(packed.kind == TestValue::NUMBER) return packed.number == json.number ? "" : path;
+  if(packed.kind == TestValue::TEXT) return packed.text == json.text ? "" : path;
+  if(packed.kind == TestValue::ARRAY){
+    if(packed.items.size() != json.items.size()) return path + "[size]";
+    for(size_t i=0;i<packed.items.size();i++){
+      std::string differs = testCompare(packed.items[i], json.items[i], path + "[" + std::to_string(i) + "]");
+      if(!differs.empty()) return differs;
+    }
+    return "";
+  }
+  if(packed.members.size() != json.members.size()) return path + "{size}";
+  for(size_t i=0;i<packed.members.size();i++){
+    int key = packed.members[i].first;
+    if(key != json.members[i].first) return path + "." + hivePayloadFieldNames[key];
+    std::string differs = testCompare(packed.members[i].second, json.members[i].second, path + "." + hivePayloadFieldNames[key], key);
+    if(!differs.empty()) return differs;
+  }
+  return "";
+}
+
+//Runs write against a JSON and a MSGPACK writer, both are read back and compared.
+struct TestEncodings {
+  std::string json;
+  std::string packed;
+};
+TestEncodings testWriteBoth(const std::function<void(HivePayloadWriter&)>& write, size_t capacity = HIVE_PAYLOAD_BUFFER_SIZE){
+  std::vector<char> buffer(capacity);
+  HivePayloadWriter writer(buffer.data(), capacity);
+  TestEncodings encodings;
+  write(writer);
+  HIVE_CHECK(!writer.overflowed());
+  encodings.json = std::string(writer.c_str(), writer.length());
+  writer.setBinary(true);
+  writer.reset();
+  write(writer);
+  HIVE_CHECK(!writer.overflowed());
+  encodings.packed = std::string(writer.c_str(), writer.length());
+  const char* at = encodings.json.c_str();
+  TestValue json = testParseJson(at);
+  HIVE_CHECK(*at == '\0');
+  HIVE_CHECK_STR("", testCompare(testUnpackAll(encodings.packed), json, "$"));
+  return encodings;
+}
+
+HIVE_TEST(everyValueKindDecodesToTheJsonMessage){
+  const uint8_t state[] = {0x00, 0xFF, 0x7F, 0x80, 0x01, 0x02, 0x03};
+  TestEncodings encodings = testWriteBoth([&](HivePayloadWriter& writer){
+    writer.beginObject();
+    writer.addSymbol(HF_DataType, DATATYPE_SENSOR_DATA, "SensorData");
+    writer.beginObject(HF_DataMap);
+    writer.addFixed(HF_Temperature, 23.4, 2);
+    writer.addFixed(HF_HumidityPercent, -0.05, 2);
+    writer.addFixed(HF_AcTemp, -1, 0);
+    writer.addString(HF_DHT22SensorStatus, "say \"hi\" \\ \t ok");
+    writer.addString(HF_IRemoteData, std::string(40, 'r').c_str()); //str8
+    writer.addBytes(HF_IrState, state, sizeof(state));
+    writer.endObject();
+    writer.addLong(HF_Seq, 5);         //fixint
+    writer.addLong(HF_InstrId, -20);   //negative fixint
+    writer.addLong(HF_BootWifiMs, -100);
+    writer.addLong(HF_BootMqttMs, 300);
+    writer.addLong(HF_LatencyMaxUs, 70000);
+    writer.addLong(HF_LatencyP99Us, -70000);
+    writer.addString(HF_HiveBotId, "bot");
+    writer.endObject();
+  });
+  HIVE_CHECK_EQ(0xDE, (uint8_t)encodings.packed[0]);
+  HIVE_CHECK_EQ(9, (uint8_t)encodings.packed[2]); //Count patched on close
+}
+
+//Counts go in the two bytes after the marker, past 255 entries and with containers nested in arrays.
+HIVE_TEST(countsArePatchedOnClose){
+  TestEncodings encodings = testWriteBoth([](HivePayloadWriter& writer){
+    writer.beginObject();
+    writer.beginArray(HF_Samples);
+    for(int i=0;i<300;i++){
+      writer.beginObject();
+      writer.addLong(HF_SampleAgeSecs, i);
+      if(i % 100 == 0){
+        writer.beginArray(HF_IrFrames);
+        writer.endArray();
+      }
+      writer.endObject();
+    }
+    writer.endArray();
+    writer.endObject();
+  }, 8192);
+  const uint8_t* packed = (const uint8_t*)encodings.packed.data();
+  HIVE_CHECK_EQ(0xDE, packed[0]);
+  HIVE_CHECK_EQ(1, (packed[1] << 8) | packed[2]);
+  HIVE_CHECK_EQ(HF_Samples, packed[3]);
+  HIVE_CHECK_EQ(0xDC, packed[4]);
+  HIVE_CHECK_EQ(300, (packed[5] << 8) | packed[6]);
+  const TestValue& samples = testUnpackAll(encodings.packed).members[0].second;
+  HIVE_CHECK_EQ(300, samples.items.size());
+  HIVE_CHECK_EQ(2, samples.items[200].members.size());
+  HIVE_CHECK_EQ(1, samples.items[201].members.size());
+}
+
+//NaN and values past int32 have no fixed point integer, both go out as INT32_MIN (d2 80 00 00 00).
+HIVE_TEST(nanAndOutOfRangeAreInt32Min){
+  const uint8_t int32Min[] = {0xD2, 0x80, 0x00, 0x00, 0x00};
+  TestEncodings encodings = testWriteBoth([](HivePayloadWriter& writer){
+    writer.beginObject();
+    writer.addFixed(HF_Temperature, NAN, 2);
+    writer.addFixed(HF_HumidityPercent, 3.0e7, 2);
+    writer.addFixed(HF_EnergyMahPerHour, -3.0e7, 2);
+    writer.addFixed(HF_ThermostatSetpoint, 21474836.0, 2);
+    writer.endObject();
+  });
+  HIVE_CHECK(encodings.json.find("\"Temperature\":\"nan\"") != std::string::npos);
+  HIVE_CHECK(encodings.json.find("\"HumidityPercent\":\"ovf\"") == std::string::npos); //Still fits unsigned in JSON
+  TestValue packed = testUnpackAll(encodings.packed);
+  for(auto& member : packed.members) HIVE_CHECK_EQ((long)INT32_MIN, member.second.number);
+  HIVE_CHECK(memcmp(encodings.packed.data() + 4, int32Min, sizeof(int32Min)) == 0);
+}
+
+//What the bot sends, in both encodings, and the bytes each one takes.
+HIVE_TEST(botPayloadsDecodeAndShrink){
+  setup();
+  hiveRunFor(3000);
+  dht22_temp_f = 23.4;
+  dht22_humidity = 51.25;
+  struct { const char* name; std::function<void()> publish; } messages[] = {
+    {"SensorData", [](){
+      HivePayloadWriter& dataMap = beginHivePayload(DATATYPE_SENSOR_DATA);
+      dataMap.addFixed(HF_Temperature, dht22_temp_f, 2);
+      dataMap.addFixed(HF_HumidityPercent, dht22_humidity, 2);
+      publishHivePayload();
+    }},
+    {"AcProfile", [](){ publishAirconProfile(); }},
+    {"InstructionCompleted", [](){ publishInstructionResult(DATATYPE_INSTRUCTION_COMPLETED, 123456, "IRAC_ONN_PROFILE_A"); }},
+    {"BootupHivebot", [](){ publishToHive(DATATYPE_BOOTUP_NOTIFY); }},
+    {"HeartBeat", [](){ publishToHive(DATATYPE_NOTHING_SPECIAL_BUT_LET_THEM_KNOW_I_AM_ALIVE); }},
+  };
+  for(auto& message : messages){
+    setHivePayloadBinary(false);
+    message.publish();
+    std::string json = hostBroker.published.back().payload;
+    setHivePayloadBinary(true);
+    message.publish();
+    HIVE_CHECK_STR(mqtt_controller_notify_msgpack_topic, hostBroker.published.back().topic);
+    std::string packed = hostBroker.published.back().payload;
+    HIVE_CHECK(!packed.empty() && packed[0] != '{');
+
+    //One seq apart, the rest is the same message.
+    TestValue packedValue = testUnpackAll(packed);
+    const char* at = json.c_str();
+    TestValue jsonValue = testParseJson(at);
+    for(auto& member : packedValue.members){
+      if(member.first == HF_Seq) member.second.number--;
+    }
+    HIVE_CHECK_STR("", testCompare(packedValue, jsonValue, message.name));
+    printf("  %-20s JSON %3u bytes, MSGPACK %3u bytes (%u%%)\n", message.name,
+      (unsigned)json.size(), (unsigned)packed.size(), (unsigned)(packed.size() * 100 / json.size()));
+    HIVE_CHECK(packed.size() < json.size());
+  }
+  setHivePayloadBinary(false);
+}
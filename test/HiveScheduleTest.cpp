@@ -0,0 +1,177 @@
+/*
+ * HiveSchedule: the timer wheel against a fake wall clock that follows millis().
+ */
+#include "HiveTest.h"
+#include "../HiveMicroClimateBotV3.ino"
+#include "HiveBotSimulation.h"
+
+#define TEST_WALL_CLOCK_AT 1760684400UL
+boolean testWallClockSynced = true;
+uint32_t testWallClockSleptSecs = 0; //millis() starts again on every wake
+uint32_t testWallClock(){
+  return testWallClockSynced ? TEST_WALL_CLOCK_AT + testWallClockSleptSecs + millis() / 1000 : 0;
+}
+
+//instrId and wall time of every run of the TESTRUN instruction.
+std::vector<std::pair<long, uint32_t>> testScheduledRuns;
+int testInstructionRun(long instrId, const char* params){
+  testScheduledRuns.push_back(std::make_pair(instrId, testWallClock()));
+  return INSTRUCTION_OK;
+}
+
+//Connected bot on the fake wall clock, schedule empty.
+void testSetupScheduledBot(){
+  setup();
+  REGISTER_INSTRUCTION("TESTRUN", testInstructionRun);
+  hiveWallClock = testWallClock;
+  testWallClockSynced = true;
+  testWallClockSleptSecs = 0;
+  testScheduledRuns.clear();
+  hiveRunFor(3000);
+}
+
+//One ExecuteInstruction message with a TESTRUN entry per {instrId, dueAt}.
+void testSchedule(std::vector<std::pair<long, uint32_t>> entries){
+  std::string instructions;
+  for(auto& entry : entries){
+    if(!instructions.empty()) instructions += ",";
+    instructions += "{\"instrId\":" + std::to_string(entry.first) + ",\"command\":\"TESTRUN\",\"schedule\":\""
+      + std::to_string(entry.second) + "\",\"execute\":\"false\"}";
+  }
+  hiveDeliverToBot("\"dataType\":\"ExecuteInstruction\",\"instructions\":[" + instructions + "]");
+}
+void testSchedule(long instrId, uint32_t dueAt){ testSchedule({{instrId, dueAt}}); }
+
+HIVE_TEST(entriesFireAtTheirSecondAcrossWheelTurns){
+  testSetupScheduledBot();
+  uint32_t now = testWallClock();
+  //Same slot a turn apart, neighbours, and out of order.
+  uint32_t dueAts[] = {now + 5, now + 5 + SCHEDULE_WHEEL_SLOTS, now + 6, now + 3 * SCHEDULE_WHEEL_SLOTS + 1, now + 4};
+  testSchedule({{1, dueAts[0]}, {2, dueAts[1]}, {3, dueAts[2]}, {4, dueAts[3]}, {5, dueAts[4]}});
+  hiveRunFor(1000);
+  HIVE_CHECK_EQ(5, scheduledInstructionCount);
+  hiveRunFor((4 * SCHEDULE_WHEEL_SLOTS) * 1000UL);
+
+  HIVE_CHECK_EQ(0, scheduledInstructionCount);
+  std::vector<long> order;
+  for(auto& run : testScheduledRuns){
+    order.push_back(run.first);
+    //Never early, at most one loop idle late.
+    HIVE_CHECK(run.second >= dueAts[run.first - 1]);
+    HIVE_CHECK(run.second <= dueAts[run.first - 1] + 1);
+  }
+  HIVE_CHECK(order == std::vector<long>({5, 1, 3, 2, 4}));
+  HIVE_CHECK(hiveAckedInstrIds("InstructionCompleted") == std::vector<long>({5, 1, 3, 2, 4}));
+}
+
+HIVE_TEST(dueOrLateEntriesRunOnceOrFail){
+  testSetupScheduledBot();
+  uint32_t now = testWallClock();
+  testSchedule({{11, now - 10},                           //Due, runs on the next pass
+                {12, now - SCHEDULE_MAX_LATE_SECS - 10},  //Missed, reported failed
+                {11, now - 10}});                         //Sent again before it ran
+  hiveRunFor(2000);
+  HIVE_CHECK_EQ(1, testScheduledRuns.size());
+  HIVE_CHECK(hiveAckedInstrIds("InstructionCompleted") == std::vector<long>({11}));
+  HIVE_CHECK(hiveAckedInstrIds("InstructionFailed") == std::vector<long>({12}));
+}
+
+//An instruction that already ran is acked completed again, never run again or reported missed.
+HIVE_TEST(executedEntriesAreAckedNotRunOrFailed){
+  testSetupScheduledBot();
+  uint32_t now = testWallClock();
+  testSchedule(21, now + 5);
+  hiveRunFor(10 * 1000UL);
+  HIVE_CHECK_EQ(1, testScheduledRuns.size());
+
+  //CatchupPostBootup replays it, long after it was due.
+  hiveRunFor((SCHEDULE_MAX_LATE_SECS + 60) * 1000UL);
+  testSchedule(21, now + 5);
+  hiveRunFor(2000);
+  HIVE_CHECK_EQ(0, scheduledInstructionCount);
+
+  //Scheduled, then run through ExecuteInstruction before it is due.
+  now = testWallClock();
+  testSchedule(22, now + 2 * SCHEDULE_MAX_LATE_SECS);
+  hiveDeliverToBot("\"dataType\":\"ExecuteInstruction\",\"instructions\":[{\"instrId\":22,\"command\":\"TESTRUN\",\"execute\":\"true\"}]");
+  hiveRunFor((3 * SCHEDULE_MAX_LATE_SECS) * 1000UL);
+
+  HIVE_CHECK_EQ(2, testScheduledRuns.size());
+  HIVE_CHECK(hiveAckedInstrIds("InstructionCompleted") == std::vector<long>({21, 21, 22, 22}));
+  HIVE_CHECK(hiveAckedInstrIds("InstructionFailed").empty());
+}
+
+HIVE_TEST(nothingRunsWithoutWallTime){
+  testSetupScheduledBot();
+  testWallClockSynced = false;
+  HIVE_CHECK(scheduleInstruction(31, "TESTRUN", "", TEST_WALL_CLOCK_AT + 10));
+  hiveRunFor(60 * 1000UL);
+  HIVE_CHECK(testScheduledRuns.empty());
+  testWallClockSynced = true;
+  hiveRunFor(2000);
+  HIVE_CHECK_EQ(1, testScheduledRuns.size());
+}
+
+HIVE_TEST(scheduleIsBounded){
+  testSetupScheduledBot();
+  uint32_t dueAt = testWallClock() + 3600;
+  for(long instrId=1; instrId<=SCHEDULE_MAX_ENTRIES; instrId++){
+    HIVE_CHECK(scheduleInstruction(instrId + 100, "TESTRUN", "", dueAt));
+  }
+  HIVE_CHECK(!scheduleInstruction(200, "TESTRUN", "", dueAt));
+  HIVE_CHECK(!scheduleInstruction(201, std::string(SCHEDULE_COMMAND_MAX, 'X').c_str(), "", dueAt));
+  HIVE_CHECK(!scheduleInstruction(0, "TESTRUN", "", dueAt));
+  HIVE_CHECK(scheduleInstruction(101, "TESTRUN", "", dueAt)); //Already there
+  HIVE_CHECK_EQ(SCHEDULE_MAX_ENTRIES, scheduledInstructionCount);
+}
+
+//Only a schedule that is a wall time is taken, anything else without execute "true" is ignored as before.
+HIVE_TEST(scheduleBelowClockValidIsIgnored){
+  testSetupScheduledBot();
+  hiveDeliverToBot("\"dataType\":\"ExecuteInstruction\",\"instructions\":["
+    "{\"instrId\":51,\"command\":\"TESTRUN\",\"execute\":\"false\"},"
+    "{\"instrId\":52,\"command\":\"TESTRUN\",\"schedule\":\"1\",\"execute\":\"false\"},"
+    "{\"instrId\":53,\"command\":\"TESTRUN\",\"schedule\":" + std::to_string(SCHEDULE_CLOCK_VALID - 1) + "}]");
+  hiveRunFor(2000);
+  HIVE_CHECK_EQ(0, scheduledInstructionCount);
+  HIVE_CHECK(testScheduledRuns.empty());
+  HIVE_CHECK(hiveAckedInstrIds("InstructionCompleted").empty());
+  HIVE_CHECK(hiveAckedInstrIds("InstructionFailed").empty());
+
+  testSchedule(54, testWallClock() + 2);
+  hiveRunFor(4000);
+  HIVE_CHECK(hiveAckedInstrIds("InstructionCompleted") == std::vector<long>({54}));
+}
+
+//DeepSleep wakes by the next entry with the radio on, the entries come back from flash once connected.
+HIVE_TEST(pendingEntriesSurviveDeepSleep){
+  testSetupScheduledBot();
+  uint32_t now = testWallClock();
+  testSchedule({{61, now + 100}, {62, now + 100 + 2 * DEEPSLEEP_SECS}});
+  hiveRunFor(1000);
+  sampleStoreDeepSleep(DEEPSLEEP_SECS, false);
+  HIVE_CHECK_EQ(1, ESP.deepSleeps);
+  HIVE_CHECK(ESP.lastDeepSleepUs <= 100 * 1000000ULL);
+  HIVE_CHECK(ESP.lastDeepSleepUs >= 98 * 1000000ULL);
+  HIVE_CHECK(ESP.lastDeepSleepMode == WAKE_RF_DEFAULT);
+  HIVE_CHECK(SPIFFS.exists(SCHEDULE_FILE));
+  uint32_t wakeAt = testWallClock() + ESP.lastDeepSleepUs / 1000000;
+
+  hostReset(true); //RTC memory and flash kept
+  _publishQueueMounted = false;
+  _publishQueueEmpty = true;
+  testWallClockSleptSecs = wakeAt - TEST_WALL_CLOCK_AT;
+  setup();
+  HIVE_CHECK_EQ(0, scheduledInstructionCount);
+  hiveRunFor(5000);
+  HIVE_CHECK_EQ(1, testScheduledRuns.size());
+  HIVE_CHECK_EQ(1, scheduledInstructionCount);
+  hiveRunFor(3 * DEEPSLEEP_SECS * 1000UL);
+  HIVE_CHECK(hiveAckedInstrIds("InstructionCompleted") == std::vector<long>({61, 62}));
+  HIVE_CHECK(testScheduledRuns.back().second >= now + 100 + 2 * DEEPSLEEP_SECS);
+
+  //Nothing left, the next sleep is the full one and the flash copy goes.
+  sampleStoreDeepSleep(DEEPSLEEP_SECS, false);
+  HIVE_CHECK_EQ(DEEPSLEEP_SECS * 1000000ULL, ESP.lastDeepSleepUs);
+  HIVE_CHECK(!SPIFFS.exists(SCHEDULE_FILE));
+}
@@ -0,0 +1,34 @@
+/*
+ * HiveTest, the smallest test runner that does the job. Each test file is its own executable:
+ * it includes this, then the sketch, and defines HIVE_TEST cases. HiveTestMain.cpp runs them
+ * in file order, with hostReset() before each.
+ *   HIVE_TEST(schedulerRunsDueTasks){ ... HIVE_CHECK_EQ(2, ranTasks); }
+ * The sketch keeps its state in globals, a test resets the modules it drives.
+ */
+#pragma once
+#include <Arduino.h>
+
+typedef void (*HiveTestFunction)();
+int hiveTestRegister(const char* name, HiveTestFunction function);
+void hiveTestFail(const char* file, int line, const char* expression, const std::string& detail = "");
+
+#define HIVE_TEST(name) \
+  static void name(); \
+  static int name##Registered = hiveTestRegister(#name, name); \
+  static void name()
+
+#define HIVE_CHECK(condition) do { \
+    if(!(condition)) hiveTestFail(__FILE__, __LINE__, #condition); \
+  } while(0)
+
+#define HIVE_CHECK_EQ(expected, actual) do { \
+    long long _expected = (long long)(expected), _actual = (long long)(actual); \
+    if(_expected != _actual) hiveTestFail(__FILE__, __LINE__, #expected " == " #actual, \
+      "expected " + std::to_string(_expected) + ", got " + std::to_string(_actual)); \
+  } while(0)
+
+#define HIVE_CHECK_STR(expected, actual) do { \
+    std::string _expected(expected), _actual(actual); \
+    if(_expected != _actual) hiveTestFail(__FILE__, __LINE__, #expected " == " #actual, \
+      "expected \"" + _expected + "\", got \"" + _actual + "\""); \
+  } while(0)
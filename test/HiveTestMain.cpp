@@ -0,0 +1,45 @@
+#include "HiveTest.h"
+#include <vector>
+
+struct HiveTestCase {
+  const char* name;
+  HiveTestFunction function;
+};
+
+static std::vector<HiveTestCase>& hiveTests(){
+  static std::vector<HiveTestCase> tests;
+  return tests;
+}
+static int hiveTestFailures = 0;
+
+int hiveTestRegister(const char* name, HiveTestFunction function){
+  hiveTests().push_back(HiveTestCase{name, function});
+  return (int)hiveTests().size();
+}
+
+void hiveTestFail(const char* file, int line, const char* expression, const std::string& detail){
+  hiveTestFailures++;
+  fprintf(stderr, "%s:%d: FAILED %s %s\n", file, line, expression, detail.c_str());
+}
+
+//Runs every test, or the ones named on the command line.
+int main(int argc, char** argv){
+  int failedTests = 0;
+  int ranTests = 0;
+  for(auto& test : hiveTests()){
+    if(argc > 1){
+      boolean named = false;
+      for(int i=1;i<argc;i++) named = named || strcmp(argv[i], test.name) == 0;
+      if(!named) continue;
+    }
+    hostReset();
+    int failuresBefore = hiveTestFailures;
+    test.function();
+    ranTests++;
+    boolean passed = hiveTestFailures == failuresBefore;
+    if(!passed) failedTests++;
+    printf("%s %s\n", passed ? "[ OK ]" : "[FAIL]", test.name);
+  }
+  printf("%d tests, %d failed\n", ranTests, failedTests);
+  return failedTests == 0 && ranTests > 0 ? 0 : 1;
+}
@@ -0,0 +1,130 @@
+/*
+ * EventTimer and EventScheduler: deadline order, millis() wraparound, and the loop's idle
+ * while the broker is away.
+ */
+#include "HiveTest.h"
+#include "../HiveMicroClimateBotV3.ino"
+#include "HiveBotSimulation.h"
+#include <climits>
+
+std::string testRunOrder;
+void testTaskA(){ testRunOrder += "A"; }
+void testTaskB(){ testRunOrder += "B"; }
+void testTaskC(){ testRunOrder += "C"; }
+
+HIVE_TEST(schedulerRunsDueTasksInDeadlineOrder){
+  testRunOrder = "";
+  EventTimer timerA("A", 1000, true, true), timerB("B", 500, true, true), timerC("C", 3000, true, true);
+  EventScheduler scheduler;
+  HIVE_CHECK(scheduler.addTask(&timerC, testTaskC));
+  HIVE_CHECK(scheduler.addTask(&timerA, testTaskA));
+  HIVE_CHECK(scheduler.addTask(&timerB, testTaskB));
+
+  hostAdvanceMs(1000);
+  //A and B are both due, they keep the order they were added in, C is not due yet.
+  HIVE_CHECK_EQ(2, scheduler.runDueTasks());
+  HIVE_CHECK_STR("AB", testRunOrder);
+  HIVE_CHECK_EQ(500, scheduler.msUntilNextDue());
+  HIVE_CHECK_EQ(500, scheduler.sleepUntilNextDue(1000));
+  HIVE_CHECK_EQ(1, scheduler.runDueTasks());
+  HIVE_CHECK_STR("ABB", testRunOrder);
+
+  hostAdvanceMs(1500);
+  HIVE_CHECK_EQ(3, scheduler.runDueTasks());
+  HIVE_CHECK_STR("ABBCAB", testRunOrder);
+}
+
+HIVE_TEST(schedulerSkipsTaskDisabledEarlierInThePass){
+  testRunOrder = "";
+  EventTimer timerA("A", 100, true, true), timerB("B", 100, true, true);
+  EventScheduler scheduler;
+  scheduler.addTask(&timerA, testTaskA);
+  scheduler.addTask(&timerB, testTaskB);
+  hostAdvanceMs(100);
+  timerB.enabled(false);
+  HIVE_CHECK_EQ(1, scheduler.runDueTasks());
+  HIVE_CHECK_STR("A", testRunOrder);
+}
+
+HIVE_TEST(schedulerIdleIsCapped){
+  EventTimer timerA("A", 60000, false, false);
+  EventScheduler scheduler;
+  scheduler.addTask(&timerA, testTaskA);
+  HIVE_CHECK_EQ(EVENT_TIMER_NEVER_DUE, scheduler.msUntilNextDue());
+  HIVE_CHECK_EQ(1000, scheduler.sleepUntilNextDue(1000));
+  HIVE_CHECK_EQ(1000, millis());
+  HIVE_CHECK_EQ(1, scheduler.wakeupCounts());
+  //Nothing to wait for, no delay() at all.
+  HIVE_CHECK_EQ(0, scheduler.sleepFor(0, 1000));
+  HIVE_CHECK_EQ(1, hostClock.delayCalls);
+}
+
+HIVE_TEST(timerSurvivesMillisWraparound){
+  hostSetMillis(ULONG_MAX - 499);
+  EventTimer timer("Wrap", 1000, true, false); //Counts from now
+  HIVE_CHECK_EQ(1000, timer.msUntilDue());
+  hostAdvanceMs(999); //millis() is now 499, past the wrap
+  HIVE_CHECK(millis() < 1000);
+  HIVE_CHECK_EQ(1, timer.msUntilDue());
+  HIVE_CHECK(!timer.isDueForRun());
+  hostAdvanceMs(1);
+  HIVE_CHECK(timer.isDueForRun());
+  HIVE_CHECK_EQ(1000, timer.msUntilDue());
+}
+
+HIVE_TEST(schedulerOrdersAcrossMillisWraparound){
+  testRunOrder = "";
+  hostSetMillis(ULONG_MAX - 99);
+  EventTimer timerA("A", 300, true, false), timerB("B", 200, true, false);
+  EventScheduler scheduler;
+  scheduler.addTask(&timerA, testTaskA);
+  scheduler.addTask(&timerB, testTaskB);
+  HIVE_CHECK_EQ(200, scheduler.sleepUntilNextDue(1000));
+  HIVE_CHECK_EQ(1, scheduler.runDueTasks());
+  HIVE_CHECK_EQ(100, scheduler.sleepUntilNextDue(1000));
+  HIVE_CHECK_EQ(1, scheduler.runDueTasks());
+  HIVE_CHECK_STR("BA", testRunOrder);
+}
+
+//Overdue tasks are held back while offline, the loop idles to the next reconnect instead of spinning.
+HIVE_TEST(offlineLoopIdlesUntilReconnect){
+  hostBroker.up = false;
+  setup();
+  unsigned long passes = hiveRunFor(60 * 1000UL);
+  //One pass a second at most, a spinning loop is charged 1 ms a pass.
+  HIVE_CHECK(passes <= 62);
+  HIVE_CHECK(hostClock.delayedMs >= 59 * 1000UL);
+  HIVE_CHECK_EQ(0, hostBroker.connects);
+  HIVE_CHECK(hostBroker.connectAttempts >= 29);
+
+  hostBroker.up = true;
+  hiveRunFor(3000);
+  HIVE_CHECK_EQ(1, hostBroker.connects);
+  HIVE_CHECK_EQ(1, hivePublished("BootupHivebot").size());
+}
+
+//A connected hour, the baseline loop() woke every 100 ms, 36000 times an hour.
+HIVE_TEST(connectedHourWakeups){
+  setup();
+  hiveRunFor(10 * 1000UL);
+  HIVE_CHECK_EQ(1, hostBroker.connects);
+  callbackUpdateFunctions(",DHT22");
+  HIVE_CHECK_EQ(WIFI_LIGHT_SLEEP, WiFi.sleepMode);
+  long wakeups = hiveScheduler.wakeupCounts();
+  hiveRunFor(60 * 60 * 1000UL);
+  long irOffWakeups = hiveScheduler.wakeupCounts() - wakeups;
+
+  //IR listen polls every 25 ms, Modem Sleep keeps the CPU up for the capture interrupt.
+  callbackUpdateFunctions(",DHT22,IR_LISTEN");
+  HIVE_CHECK_EQ(WIFI_MODEM_SLEEP, WiFi.sleepMode);
+  wakeups = hiveScheduler.wakeupCounts();
+  hiveRunFor(60 * 60 * 1000UL);
+  long irOnWakeups = hiveScheduler.wakeupCounts() - wakeups;
+  printf("  wakeups/hour: baseline 36000, IR_LISTEN off %ld, on %ld\n", irOffWakeups, irOnWakeups);
+  HIVE_CHECK(irOffWakeups <= 3600 + 360);
+  HIVE_CHECK(irOnWakeups >= 3600 * 1000L / 25);
+  HIVE_CHECK(irOnWakeups <= 3600 * 1000L / 25 + irOffWakeups);
+
+  callbackUpdateFunctions(",DHT22");
+  HIVE_CHECK_EQ(WIFI_LIGHT_SLEEP, WiFi.sleepMode);
+}
@@ -0,0 +1,85 @@
+/*
+ * IR frame corpus for the receive path: one button press per brand over the modes and
+ * temperatures a remote sends most, plus UNKNOWN timings. The frames are synthesized, the
+ * A/C states come from the ir_*.h models of the IRremoteESP8266 v2.3 layouts and the timings
+ * follow the NEC and Kelvinator mark/space lengths. None was captured from a real remote.
+ */
+#pragma once
+#include <vector>
+
+struct IrCorpusFrame {
+  const char* group;
+  HostIrFrame frame;
+};
+
+inline std::vector<uint8_t> irCorpusBytes(const uint8_t* state, size_t length){
+  return std::vector<uint8_t>(state, state + length);
+}
+
+//mark, space, then one mark and space per bit, LSB first, in RAWTICK units.
+inline std::vector<uint16_t> irCorpusTimings(uint16_t headerMark, uint16_t headerSpace, uint16_t bitMark,
+                                              uint16_t oneSpace, uint16_t zeroSpace, const std::vector<uint8_t>& bytes){
+  std::vector<uint16_t> timings = {(uint16_t)(headerMark / RAWTICK), (uint16_t)(headerSpace / RAWTICK)};
+  for(uint8_t byte : bytes){
+    for(int bit=0;bit<8;bit++){
+      timings.push_back(bitMark / RAWTICK);
+      timings.push_back(((byte >> bit) & 1 ? oneSpace : zeroSpace) / RAWTICK);
+    }
+  }
+  timings.push_back(bitMark / RAWTICK);
+  return timings;
+}
+
+inline std::vector<IrCorpusFrame> irCorpus(){
+  std::vector<IrCorpusFrame> corpus;
+  const uint8_t temps[] = {17, 22, 24, 26, 30};
+  for(uint8_t temp : temps){
+    for(int heat=0;heat<2;heat++){
+      IRKelvinatorAC kelvinator(0);
+      kelvinator.on();
+      kelvinator.setMode(heat ? KELVINATOR_HEAT : KELVINATOR_COOL);
+      kelvinator.setTemp(temp);
+      corpus.push_back({"KELVINATOR", {KELVINATOR, 128, irCorpusBytes(kelvinator.getRaw(), KELVINATOR_STATE_LENGTH), {}, 0}});
+
+      IRDaikinESP daikin(0);
+      daikin.on();
+      daikin.setMode(heat ? DAIKIN_HEAT : DAIKIN_COOL);
+      daikin.setTemp(temp);
+      daikin.setFan(DAIKIN_FAN_AUTO);
+      corpus.push_back({"DAIKIN", {DAIKIN, DAIKIN_COMMAND_LENGTH * 8, irCorpusBytes(daikin.getRaw(), DAIKIN_COMMAND_LENGTH), {}, 0}});
+
+      IRFujitsuAC fujitsu(0);
+      fujitsu.setCmd(FUJITSU_AC_CMD_TURN_ON);
+      fujitsu.setMode(heat ? FUJITSU_AC_MODE_HEAT : FUJITSU_AC_MODE_COOL);
+      fujitsu.setTemp(temp);
+      corpus.push_back({"FUJITSU_AC", {FUJITSU_AC, (uint16_t)(fujitsu.getStateLength() * 8),
+        irCorpusBytes(fujitsu.getRaw(), fujitsu.getStateLength()), {}, 0}});
+
+      IRToshibaAC toshiba(0);
+      toshiba.on();
+      toshiba.setMode(heat ? TOSHIBA_AC_HEAT : TOSHIBA_AC_COOL);
+      toshiba.setTemp(temp);
+      toshiba.setFan(TOSHIBA_AC_FAN_AUTO);
+      corpus.push_back({"TOSHIBA_AC", {TOSHIBA_AC, TOSHIBA_AC_STATE_LENGTH * 8, irCorpusBytes(toshiba.getRaw(), TOSHIBA_AC_STATE_LENGTH), {}, 0}});
+
+      IRMideaAC midea(0);
+      midea.on();
+      midea.setMode(heat ? MIDEA_AC_HEAT : MIDEA_AC_COOL);
+      midea.setTemp(temp, true);
+      midea.setFan(MIDEA_AC_FAN_AUTO);
+      uint64_t value = midea.getRaw();
+      corpus.push_back({"MIDEA", {MIDEA, 48, irCorpusBytes((const uint8_t*)&value, 6), {}, 0}});
+    }
+  }
+  //Remotes the library has no decoder for here: a TV remote, and a Kelvinator packet cut by the
+  //receive timeout, both as IR_RAW sends them.
+  const uint8_t necCodes[][4] = {{0x04, 0xFB, 0x08, 0xF7}, {0x04, 0xFB, 0x02, 0xFD}, {0x20, 0xDF, 0x10, 0xEF}};
+  for(auto& code : necCodes){
+    corpus.push_back({"UNKNOWN", {UNKNOWN, 0, {}, irCorpusTimings(9000, 4500, 560, 1690, 560, irCorpusBytes(code, 4)), 0}});
+  }
+  IRKelvinatorAC kelvinator(0);
+  kelvinator.on();
+  corpus.push_back({"UNKNOWN", {UNKNOWN, 0, {}, irCorpusTimings(9010, 4505, 680, 1510, 510,
+    irCorpusBytes(kelvinator.getRaw(), 8)), 0}});
+  return corpus;
+}
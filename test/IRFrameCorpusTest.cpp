@@ -0,0 +1,106 @@
+/*
+ * The IRFrameCorpus.h frames through pollIRReceiver(), then written as an IRFrames entry three
+ * ways: describeIRFrame() text, and writeIRFrameRaw() as JSON and as MSGPACK. Bytes per entry
+ * and host time per entry are printed per group. The host toString() of the ir_*.h models is
+ * one short line where v2.3 lists every setting, so the text bytes here are a lower bound.
+ */
+#include "HiveTest.h"
+#include "../HiveMicroClimateBotV3.ino"
+#include "IRFrameCorpus.h"
+#include <chrono>
+#include <functional>
+#include <map>
+
+struct TestEntryCost {
+  size_t frames = 0;
+  size_t bytes[3] = {0, 0, 0};   //text, raw JSON, raw MSGPACK
+  double ns[3] = {0, 0, 0};
+};
+
+//Every corpus frame as the ring holds it.
+std::vector<std::pair<const char*, IrFrame>> testCorpusFrames(){
+  std::vector<std::pair<const char*, IrFrame>> frames;
+  irPublishRawFrames = true;
+  for(auto& entry : irCorpus()){
+    hostIr.frames.push_back(entry.frame);
+    clearIRFrames();
+    HIVE_CHECK(pollIRReceiver());
+    IrFrame frame;
+    HIVE_CHECK(popIRFrame(frame));
+    frames.push_back({entry.group, frame});
+  }
+  return frames;
+}
+
+size_t testWriteEntry(HivePayloadWriter& entry, int way, const IrFrame& frame){
+  entry.setBinary(way == 2);
+  entry.reset();
+  entry.beginObject();
+  if(way == 0) entry.addString(HF_IRemoteData, describeIRFrame(frame).c_str());
+  else writeIRFrameRaw(entry, frame);
+  entry.addLong(HF_IrRepeats, frame.repeats);
+  entry.endObject();
+  HIVE_CHECK(!entry.overflowed());
+  return entry.length();
+}
+
+HIVE_TEST(corpusEntryCostTextAgainstRaw){
+  std::vector<std::pair<const char*, IrFrame>> frames = testCorpusFrames();
+  HIVE_CHECK(frames.size() > 50);
+  char buffer[HIVE_PAYLOAD_BUFFER_SIZE];
+  HivePayloadWriter entry(buffer, sizeof(buffer));
+  std::map<std::string, TestEntryCost> costs;
+  const int runs = 200;
+  for(auto& frame : frames){
+    TestEntryCost& cost = costs[frame.first];
+    cost.frames++;
+    for(int way=0;way<3;way++){
+      if(way == 0 && frame.second.decodeType == UNKNOWN) continue; //Dropped as interference without IR_RAW
+      size_t bytes = testWriteEntry(entry, way, frame.second);
+      cost.bytes[way] += bytes;
+      std::chrono::steady_clock::time_point startAt = std::chrono::steady_clock::now();
+      for(int i=0;i<runs;i++) testWriteEntry(entry, way, frame.second);
+      cost.ns[way] += std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - startAt).count() / runs;
+    }
+    if(frame.second.decodeType != UNKNOWN){
+      HIVE_CHECK(testWriteEntry(entry, 1, frame.second) < testWriteEntry(entry, 0, frame.second));
+    }
+    HIVE_CHECK(testWriteEntry(entry, 2, frame.second) < testWriteEntry(entry, 1, frame.second));
+  }
+  printf("  %-15s  %17s  %17s  %17s\n", "IRFrames entry", "text", "raw JSON", "raw MSGPACK");
+  for(auto& group : costs){
+    TestEntryCost& cost = group.second;
+    printf("  %-10s x%-3lu", group.first.c_str(), (unsigned long)cost.frames);
+    for(int way=0;way<3;way++){
+      if(cost.bytes[way] == 0) printf("  %17s", "dropped");
+      else printf("  %5lu B %6.0f ns", (unsigned long)(cost.bytes[way] / cost.frames), cost.ns[way] / cost.frames);
+    }
+    printf("\n");
+  }
+}
+
+//Packed timings decode back to the capture, so HiveCentral gets the frame the bot saw.
+HIVE_TEST(corpusTimingsRoundTrip){
+  std::vector<IrCorpusFrame> corpus = irCorpus();
+  std::vector<std::pair<const char*, IrFrame>> frames = testCorpusFrames();
+  for(size_t i=0;i<frames.size();i++){
+    const IrFrame& frame = frames[i].second;
+    if(frame.decodeType != UNKNOWN) continue;
+    const std::vector<uint16_t>& timings = corpus[i].frame.timings;
+    HIVE_CHECK_EQ(timings.size(), frame.rawlen);
+    std::vector<uint16_t> unpacked;
+    for(size_t at=0;at<frame.timingBytes;){
+      uint32_t zigzag = 0;
+      for(int shift=0;at<frame.timingBytes;shift+=7){
+        uint8_t byte = frame.timings[at++];
+        zigzag |= (uint32_t)(byte & 0x7F) << shift;
+        if(!(byte & 0x80)) break;
+      }
+      int32_t delta = (int32_t)(zigzag >> 1) ^ -(int32_t)(zigzag & 1);
+      size_t index = unpacked.size();
+      unpacked.push_back(delta + (index >= 2 ? unpacked[index - 2] : 0));
+    }
+    HIVE_CHECK(!unpacked.empty());
+    for(size_t t=0;t<unpacked.size();t++) HIVE_CHECK_EQ(timings[t], unpacked[t]);
+  }
+}
@@ -0,0 +1,234 @@
+/* Host runtime behind the stand-in headers, linked into every test. */
+#include "Arduino.h"
+#include <cstdlib>
+#include <new>
+#include "FS.h"
+#include "ESP8266WiFi.h"
+#include "PubSubClient.h"
+#include "DHT.h"
+#include "IRremoteESP8266.h"
+#include "ArduinoJson.h"
+
+HostClock hostClock;
+HostHeap hostHeap;
+HardwareSerial Serial;
+EspClass ESP;
+FS SPIFFS;
+WiFiClass WiFi;
+HostBroker hostBroker;
+HostDht hostDht;
+HostIr hostIr;
+
+void hostReset(boolean keepRtc){
+  hostClock = HostClock();
+  hostHeap = HostHeap();
+  Serial.output.clear();
+  Serial.room = 128;
+  if(!keepRtc) memset(ESP.rtcMemory, 0, sizeof(ESP.rtcMemory));
+  ESP.resetInfo.reason = keepRtc ? REASON_DEEP_SLEEP_AWAKE : REASON_DEFAULT_RST;
+  ESP.deepSleeps = 0;
+  ESP.restarts = 0;
+  if(!keepRtc) SPIFFS.files.clear();
+  SPIFFS.mountable = true;
+  SPIFFS.mounts = 0;
+  WiFi = WiFiClass();
+  hostBroker = HostBroker();
+  hostDht = HostDht();
+  hostIr = HostIr();
+}
+
+/* Heap */
+void* operator new(size_t size){
+  if(hostHeap.counting){
+    hostHeap.allocations++;
+    hostHeap.bytes += size;
+  }
+  void* allocated = malloc(size ? size : 1);
+  if(allocated == nullptr) throw std::bad_alloc();
+  return allocated;
+}
+void operator delete(void* allocated) noexcept { free(allocated); }
+
+/* JSON */
+JsonNode* JsonBuffer::node(JsonNode::Type type){
+  _nodes.emplace_back();
+  JsonNode* created = &_nodes.back();
+  created->type = type;
+  if(type == JsonNode::OBJECT){
+    _objects.emplace_back(created, this);
+    created->object = &_objects.back();
+  }else if(type == JsonNode::ARRAY){
+    _arrays.emplace_back(created);
+    created->array = &_arrays.back();
+  }
+  return created;
+}
+
+void JsonBuffer::clear(){
+  _nodes.clear();
+  _objects.clear();
+  _arrays.clear();
+}
+
+JsonObject& JsonBuffer::createObject(){
+  return *node(JsonNode::OBJECT)->object;
+}
+
+JsonObject& JsonBuffer::parseObject(const char* json){
+  if(json == nullptr) return JsonObject::invalid();
+  const char* at = json;
+  JsonNode* parsed = hostJsonParse(*this, at);
+  if(parsed == nullptr || parsed->type != JsonNode::OBJECT) return JsonObject::invalid();
+  return *parsed->object;
+}
+
+static void skipSpace(const char*& at){
+  while(*at == ' ' || *at == '\t' || *at == '\r' || *at == '\n') at++;
+}
+
+static boolean parseString(const char*& at, std::string& out){
+  if(*at != '"') return false;
+  at++;
+  while(*at != '"'){
+    if(*at == '\0') return false;
+    if(*at == '\\'){
+      at++;
+      switch(*at){
+        case 'n': out += '\n'; break;
+        case 't': out += '\t'; break;
+        case 'r': out += '\r'; break;
+        case 'b': out += '\b'; break;
+        case 'f': out += '\f'; break;
+        case 'u': {
+          char hex[5] = {0};
+          for(int i=0;i<4;i++){ if(!at[1 + i]) return false; hex[i] = at[1 + i]; }
+          out += (char)strtol(hex, nullptr, 16); //ASCII is all the bot gets
+          at += 4;
+          break;
+        }
+        case '\0': return false;
+        default: out += *at;
+      }
+      at++;
+      continue;
+    }
+    out += *at++;
+  }
+  at++;
+  return true;
+}
+
+JsonNode* hostJsonParse(JsonBuffer& buffer, const char*& at){
+  skipSpace(at);
+  if(*at == '{'){
+    JsonNode* object = buffer.node(JsonNode::OBJECT);
+    at++;
+    skipSpace(at);
+    if(*at == '}'){ at++; return object; }
+    while(true){
+      skipSpace(at);
+      std::string key;
+      if(!parseString(at, key)) return nullptr;
+      skipSpace(at);
+      if(*at++ != ':') return nullptr;
+      JsonNode* value = hostJsonParse(buffer, at);
+      if(value == nullptr) return nullptr;
+      object->members.push_back(std::make_pair(key, value));
+      skipSpace(at);
+      if(*at == ','){ at++; continue; }
+      if(*at++ != '}') return nullptr;
+      return object;
+    }
+  }
+  if(*at == '['){
+    JsonNode* array = buffer.node(JsonNode::ARRAY);
+    at++;
+    skipSpace(at);
+    if(*at == ']'){ at++; return array; }
+    while(true){
+      JsonNode* value = hostJsonParse(buffer, at);
+      if(value == nullptr) return nullptr;
+      array->items.push_back(value);
+      skipSpace(at);
+      if(*at == ','){ at++; continue; }
+      if(*at++ != ']') return nullptr;
+      return array;
+    }
+  }
+  if(*at == '"'){
+    JsonNode* text = buffer.node(JsonNode::STRING);
+    return parseString(at, text->text) ? text : nullptr;
+  }
+  if(strncmp(at, "true", 4) == 0 || strncmp(at, "false", 5) == 0){
+    JsonNode* flag = buffer.node(JsonNode::BOOLEAN);
+    flag->flag = *at == 't';
+    at += flag->flag ? 4 : 5;
+    return flag;
+  }
+  if(strncmp(at, "null", 4) == 0){
+    at += 4;
+    return buffer.node(JsonNode::NUL);
+  }
+  const char* start = at;
+  if(*at == '-' || *at == '+') at++;
+  while(isdigit(*at) || *at == '.' || *at == 'e' || *at == 'E' || *at == '-' || *at == '+') at++;
+  if(at == start) return nullptr;
+  JsonNode* number = buffer.node(JsonNode::NUMBER);
+  number->text.assign(start, at - start);
+  return number;
+}
+
+static void printString(const std::string& text, std::string& out){
+  out += '"';
+  for(char c : text){
+    if(c == '"' || c == '\\') out += '\\';
+    if(c == '\n'){ out += "\\n"; continue; }
+    out += c;
+  }
+  out += '"';
+}
+
+void hostJsonPrint(const JsonNode* node, std::string& out){
+  if(node == nullptr){ out += "null"; return; }
+  switch(node->type){
+    case JsonNode::UNDEFINED:
+    case JsonNode::NUL: out += "null"; break;
+    case JsonNode::BOOLEAN: out += node->flag ? "true" : "false"; break;
+    case JsonNode::NUMBER: out += node->text; break;
+    case JsonNode::STRING: printString(node->text, out); break;
+    case JsonNode::OBJECT:
+      out += '{';
+      for(size_t i=0;i<node->members.size();i++){
+        if(i > 0) out += ',';
+        printString(node->members[i].first, out);
+        out += ':';
+        hostJsonPrint(node->members[i].second, out);
+      }
+      out += '}';
+      break;
+    case JsonNode::ARRAY:
+      out += '[';
+      for(size_t i=0;i<node->items.size();i++){
+        if(i > 0) out += ',';
+        hostJsonPrint(node->items[i], out);
+      }
+      out += ']';
+      break;
+  }
+}
+
+size_t JsonObject::printTo(Print& out) const {
+  std::string json;
+  hostJsonPrint(_node, json);
+  return out.write(json.c_str());
+}
+
+size_t JsonObject::printTo(char* out, size_t size) const {
+  std::string json;
+  hostJsonPrint(_node, json);
+  if(size == 0) return 0;
+  size_t length = std::min(json.size(), size - 1);
+  memcpy(out, json.data(), length);
+  out[length] = '\0';
+  return length;
+}
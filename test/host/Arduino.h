@@ -0,0 +1,188 @@
+/*
+ * Host stand-in for the ESP8266 Arduino core, only what the sketch uses.
+ * Time is a fake clock: millis()/micros() only move when delay() is called or a test
+ * advances it, so hours of bot time run in milliseconds. See README.md, Building off-device.
+ */
+#pragma once
+#include <cstdint>
+#include <cstring>
+#include <cstdio>
+#include <cstdlib>
+#include <cctype>
+#include <cstdarg>
+#include <math.h>
+#include <string>
+#include <memory>
+#include <algorithm>
+
+typedef bool boolean;
+typedef uint8_t byte;
+
+#define D1 5
+#define D2 4
+#define D5 14
+#define D6 12
+#define D8 15
+#define OUTPUT 1
+#define INPUT 0
+#define PROGMEM
+#define F(x) x
+#define ICACHE_RAM_ATTR
+#define memcpy_P memcpy
+
+/* Fake clock, unsigned long like the core so elapsed time arithmetic is the sketch's own. */
+struct HostClock {
+  unsigned long ms;
+  unsigned long us;
+  unsigned long delayCalls;
+  unsigned long delayedMs;
+};
+extern HostClock hostClock;
+inline void hostAdvanceMs(unsigned long ms){ hostClock.ms += ms; hostClock.us += ms * 1000UL; }
+inline void hostSetMillis(unsigned long ms){ hostClock.ms = ms; hostClock.us = ms * 1000UL; }
+inline unsigned long millis(){ return hostClock.ms; }
+inline unsigned long micros(){ return hostClock.us; }
+inline void delay(unsigned long ms){ hostClock.delayCalls++; hostClock.delayedMs += ms; hostAdvanceMs(ms); }
+inline void delayMicroseconds(unsigned int us){ hostClock.us += us; }
+inline void yield(){}
+
+/* Heap use while counting is on, new and delete are replaced in Arduino.cpp. */
+struct HostHeap {
+  boolean counting;
+  unsigned long allocations;
+  unsigned long bytes;
+};
+extern HostHeap hostHeap;
+
+inline void pinMode(int, int){}
+inline void digitalWrite(int, int){}
+inline void analogWrite(int, int){}
+
+class String {
+  std::string _s;
+public:
+  String(){}
+  String(const char* c) : _s(c ? c : ""){}
+  String(const std::string& s) : _s(s){}
+  String(char c) : _s(1, c){}
+  String(int v) : _s(std::to_string(v)){}
+  String(unsigned int v) : _s(std::to_string(v)){}
+  String(long v) : _s(std::to_string(v)){}
+  String(unsigned long v) : _s(std::to_string(v)){}
+  String(double v, unsigned char decimals = 2){ char b[32]; snprintf(b, sizeof(b), "%.*f", decimals, v); _s = b; }
+  const char* c_str() const { return _s.c_str(); }
+  unsigned int length() const { return _s.size(); }
+  String& operator+=(const String& o){ _s += o._s; return *this; }
+  String& operator+=(const char* o){ _s += o; return *this; }
+  String& operator+=(char c){ _s += c; return *this; }
+  friend String operator+(const String& a, const String& b){ return String(a._s + b._s); }
+  friend String operator+(const String& a, const char* b){ return String(a._s + b); }
+  friend String operator+(const char* a, const String& b){ return String(a + b._s); }
+  bool operator==(const String& o) const { return _s == o._s; }
+  bool operator!=(const String& o) const { return _s != o._s; }
+  bool operator==(const char* o) const { return _s == o; }
+  bool operator!=(const char* o) const { return _s != o; }
+  bool equals(const String& o) const { return _s == o._s; }
+  int indexOf(const char* x) const { size_t p = _s.find(x); return p == std::string::npos ? -1 : (int)p; }
+  int indexOf(const String& x) const { return indexOf(x.c_str()); }
+  char operator[](unsigned int i) const { return _s[i]; }
+  String substring(unsigned int from, unsigned int to) const { return String(_s.substr(from, to - from)); }
+  String substring(unsigned int from) const { return String(_s.substr(from)); }
+  long toInt() const { return atol(_s.c_str()); }
+  float toFloat() const { return atof(_s.c_str()); }
+};
+
+class IPAddress {
+  uint32_t _address = 0;
+public:
+  IPAddress(){}
+  IPAddress(uint8_t a, uint8_t b, uint8_t c, uint8_t d) : _address(a | b << 8 | c << 16 | (uint32_t)d << 24){}
+  IPAddress(uint32_t address) : _address(address){}
+  operator uint32_t() const { return _address; }
+  String toString() const {
+    char b[16];
+    snprintf(b, sizeof(b), "%u.%u.%u.%u", _address & 0xFF, _address >> 8 & 0xFF, _address >> 16 & 0xFF, _address >> 24);
+    return String(b);
+  }
+};
+
+struct Print {
+  virtual ~Print(){}
+  virtual size_t write(uint8_t c) = 0;
+  virtual size_t write(const uint8_t* data, size_t length){ for(size_t i=0;i<length;i++) write(data[i]); return length; }
+  size_t write(const char* text){ return write((const uint8_t*)text, strlen(text)); }
+  size_t write(const char* text, size_t length){ return write((const uint8_t*)text, length); }
+  size_t print(const String& text){ return write(text.c_str()); }
+  size_t print(const char* text){ return write(text); }
+  size_t print(long value){ return print(String(value)); }
+  size_t println(){ return write("\r\n"); }
+  template<class T> size_t println(const T& value){ return print(value) + println(); }
+  int printf(const char* format, ...) __attribute__((format(printf, 2, 3))){
+    char b[256];
+    va_list args;
+    va_start(args, format);
+    int length = vsnprintf(b, sizeof(b), format, args);
+    va_end(args);
+    write(b);
+    return length;
+  }
+};
+
+//Keeps what was written, room per availableForWrite() is set by the test.
+struct HardwareSerial : Print {
+  std::string output;
+  int room = 128;
+  void begin(long){}
+  int availableForWrite(){ return room; }
+  void flush(){}
+  using Print::write;
+  size_t write(uint8_t c) override { output += (char)c; return 1; }
+};
+extern HardwareSerial Serial;
+
+struct rst_info { uint32_t reason; };
+enum rst_reason { REASON_DEFAULT_RST = 0, REASON_WDT_RST, REASON_EXCEPTION_RST, REASON_SOFT_WDT_RST,
+  REASON_SOFT_RESTART, REASON_DEEP_SLEEP_AWAKE, REASON_EXT_SYS_RST };
+enum RFMode { RF_DEFAULT = 0, RF_CAL = 1, RF_NO_CAL = 2, RF_DISABLED = 4 };
+#define WAKE_RF_DEFAULT  RF_DEFAULT
+#define WAKE_RF_DISABLED RF_DISABLED
+#define WAKE_NO_RFCAL    RF_NO_CAL
+
+/*
+ * RTC user memory is kept across hostReset(), as it is across DeepSleep.
+ * deepSleep() and restart() return on the host, they are only counted.
+ */
+#define HOST_RTC_BLOCKS 128
+struct EspClass {
+  uint32_t rtcMemory[HOST_RTC_BLOCKS];
+  rst_info resetInfo;
+  unsigned long deepSleeps = 0;
+  uint64_t lastDeepSleepUs = 0;
+  RFMode lastDeepSleepMode = RF_DEFAULT;
+  unsigned long restarts = 0;
+  void deepSleep(uint64_t us, RFMode mode = RF_DEFAULT){ deepSleeps++; lastDeepSleepUs = us; lastDeepSleepMode = mode; }
+  void restart(){ restarts++; }
+  bool rtcUserMemoryRead(uint32_t offset, uint32_t* data, size_t size){
+    if(offset * 4 + size > sizeof(rtcMemory)) return false;
+    memcpy(data, (const uint8_t*)rtcMemory + offset * 4, size);
+    return true;
+  }
+  bool rtcUserMemoryWrite(uint32_t offset, uint32_t* data, size_t size){
+    if(offset * 4 + size > sizeof(rtcMemory)) return false;
+    memcpy((uint8_t*)rtcMemory + offset * 4, data, size);
+    return true;
+  }
+  rst_info* getResetInfoPtr(){ return &resetInfo; }
+  uint32_t getFreeHeap(){ return 40000; }
+  uint32_t getChipId(){ return 0x00C0FFEE; }
+};
+extern EspClass ESP;
+
+inline void configTime(int, int, const char*, const char* = 0, const char* = 0){}
+
+/*
+ * Back to a cold boot: clock at zero, empty flash, broker up with nothing recorded.
+ * RTC memory is cleared too unless keepRtc, which is what a DeepSleep wake looks like.
+ * The sketch's own globals are not touched, tests reset the modules they drive.
+ */
+void hostReset(boolean keepRtc = false);
@@ -0,0 +1,142 @@
+/*
+ * Host stand-in for the part of ArduinoJson 5 the sketch uses: parseObject() into a tree,
+ * subscripts, as<T>() with numbers read from strings, createObject(), clear() and printTo().
+ * Nodes live in the buffer, references stay valid until it goes out of scope.
+ * A missing key gives an undefined variant: NULL / 0 / an object whose success() is false.
+ */
+#pragma once
+#include "Arduino.h"
+#include <deque>
+#include <vector>
+
+class JsonObject;
+class JsonArray;
+class JsonBuffer;
+
+struct JsonNode {
+  enum Type { UNDEFINED, NUL, BOOLEAN, NUMBER, STRING, OBJECT, ARRAY } type = UNDEFINED;
+  std::string text;                //STRING, NUMBER as written
+  boolean flag = false;
+  std::vector<std::pair<std::string, JsonNode*>> members;
+  std::vector<JsonNode*> items;
+  JsonObject* object = nullptr;    //Views handed out by reference
+  JsonArray* array = nullptr;
+};
+
+template<class T> struct JsonAsType { typedef T type; };
+template<> struct JsonAsType<JsonObject> { typedef JsonObject& type; };
+template<> struct JsonAsType<JsonArray> { typedef JsonArray& type; };
+
+class JsonVariant {
+  friend class JsonObject;
+  JsonNode* _node;
+  JsonObject* _owner;
+  std::string _key;
+public:
+  JsonVariant(JsonNode* node = nullptr, JsonObject* owner = nullptr, const std::string& key = "")
+    : _node(node), _owner(owner), _key(key){}
+  boolean success() const { return _node != nullptr && _node->type != JsonNode::UNDEFINED; }
+  operator const char*() const { return _node && _node->type == JsonNode::STRING ? _node->text.c_str() : nullptr; }
+  double number() const {
+    if(!_node) return 0;
+    if(_node->type == JsonNode::BOOLEAN) return _node->flag ? 1 : 0;
+    if(_node->type == JsonNode::NUMBER || _node->type == JsonNode::STRING) return strtod(_node->text.c_str(), nullptr);
+    return 0;
+  }
+  operator long() const { return (long)number(); }
+  operator int() const { return (int)number(); }
+  operator unsigned long() const {
+    //Whole numbers as integers, a 10 digit unix time does not fit a double's rounding anyway.
+    if(_node && (_node->type == JsonNode::NUMBER || _node->type == JsonNode::STRING)) return strtoul(_node->text.c_str(), nullptr, 10);
+    return (unsigned long)number();
+  }
+  operator float() const { return (float)number(); }
+  operator double() const { return number(); }
+  operator bool() const { return _node && (_node->type == JsonNode::BOOLEAN ? _node->flag : number() != 0); }
+  operator JsonObject&() const;
+  operator JsonArray&() const;
+  template<class T> typename JsonAsType<T>::type as() const { return *this; }
+  JsonVariant& operator=(const char* value);
+  JsonVariant& operator=(long value);
+};
+
+class JsonObject {
+  JsonNode* _node;
+  JsonBuffer* _buffer;
+public:
+  JsonObject(JsonNode* node = nullptr, JsonBuffer* buffer = nullptr) : _node(node), _buffer(buffer){}
+  static JsonObject& invalid(){ static JsonObject object; return object; }
+  boolean success() const { return _node != nullptr; }
+  JsonNode* member(const char* key) const {
+    if(!_node) return nullptr;
+    for(auto& member : _node->members){
+      if(member.first == key) return member.second;
+    }
+    return nullptr;
+  }
+  boolean containsKey(const char* key) const { return member(key) != nullptr; }
+  JsonVariant operator[](const char* key){ return JsonVariant(member(key), this, key); }
+  template<class T> typename JsonAsType<T>::type get(const char* key) const { return JsonVariant(member(key)).as<T>(); }
+  void set(const std::string& key, JsonNode* value){
+    if(!_node) return;
+    for(auto& member : _node->members){
+      if(member.first == key){ member.second = value; return; }
+    }
+    _node->members.push_back(std::make_pair(key, value));
+  }
+  JsonBuffer* buffer() const { return _buffer; }
+  size_t printTo(Print& out) const;
+  size_t printTo(char* out, size_t size) const;
+};
+
+class JsonArray {
+  JsonNode* _node;
+public:
+  JsonArray(JsonNode* node = nullptr) : _node(node){}
+  static JsonArray& invalid(){ static JsonArray array; return array; }
+  boolean success() const { return _node != nullptr; }
+  size_t size() const { return _node ? _node->items.size() : 0; }
+  JsonVariant operator[](size_t index) const { return JsonVariant(index < size() ? _node->items[index] : nullptr); }
+  template<class T> typename JsonAsType<T>::type get(size_t index) const { return (*this)[index].as<T>(); }
+};
+
+class JsonBuffer {
+  std::deque<JsonNode> _nodes;
+  std::deque<JsonObject> _objects;
+  std::deque<JsonArray> _arrays;
+public:
+  JsonNode* node(JsonNode::Type type);
+  JsonObject& parseObject(const char* json);
+  JsonObject& parseObject(const String& json){ return parseObject(json.c_str()); }
+  JsonObject& createObject();
+  void clear();
+};
+
+inline JsonVariant::operator JsonObject&() const {
+  return _node && _node->type == JsonNode::OBJECT ? *_node->object : JsonObject::invalid();
+}
+inline JsonVariant::operator JsonArray&() const {
+  return _node && _node->type == JsonNode::ARRAY ? *_node->array : JsonArray::invalid();
+}
+inline JsonVariant& JsonVariant::operator=(const char* value){
+  if(!_owner || !_owner->buffer()) return *this;
+  _node = _owner->buffer()->node(JsonNode::STRING);
+  _node->text = value ? value : "";
+  _owner->set(_key, _node);
+  return *this;
+}
+inline JsonVariant& JsonVariant::operator=(long value){
+  if(!_owner || !_owner->buffer()) return *this;
+  _node = _owner->buffer()->node(JsonNode::NUMBER);
+  _node->text = std::to_string(value);
+  _owner->set(_key, _node);
+  return *this;
+}
+
+//Nodes are on the heap, the pool only takes the room the real one takes, on the stack or in RAM.
+template<size_t CAPACITY> class StaticJsonBuffer : public JsonBuffer { uint8_t _pool[CAPACITY]; };
+template<size_t CAPACITY> class DynamicJsonBuffer : public JsonBuffer {};
+
+/* Parser and printer are in ArduinoJson.cpp. */
+JsonNode* hostJsonParse(JsonBuffer& buffer, const char*& at);
+void hostJsonPrint(const JsonNode* node, std::string& out);
@@ -0,0 +1,20 @@
+/* Host stand-in, reads hostDht. Tests usually point dht22Reader at their own reader instead. */
+#pragma once
+#include "Arduino.h"
+#define DHT22 22
+
+struct HostDht {
+  boolean ok = true;
+  float temperature = 24.0f;
+  float humidity = 55.0f;
+  unsigned long conversions = 0;
+};
+extern HostDht hostDht;
+
+struct DHT {
+  DHT(int, int){}
+  void begin(){}
+  bool read(bool = false){ hostDht.conversions++; return hostDht.ok; }
+  float readTemperature(bool = false, bool = false){ return hostDht.ok ? hostDht.temperature : NAN; }
+  float readHumidity(bool = false){ return hostDht.ok ? hostDht.humidity : NAN; }
+};
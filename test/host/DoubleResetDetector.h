@@ -0,0 +1,8 @@
+/* Host stand-in, never a double reset. */
+#pragma once
+struct DoubleResetDetector {
+  DoubleResetDetector(int, int){}
+  bool detectDoubleReset(){ return false; }
+  void stop(){}
+  void loop(){}
+};
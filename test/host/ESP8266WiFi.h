@@ -0,0 +1,46 @@
+/*
+ * Host stand-in, the station is associated unless a test says otherwise. begin() is the
+ * Fast Wake reconnect, it is counted and associates associateMs after the call.
+ */
+#pragma once
+#include "Arduino.h"
+
+enum WiFiSleepType { WIFI_NONE_SLEEP = 0, WIFI_LIGHT_SLEEP = 1, WIFI_MODEM_SLEEP = 2 };
+enum WiFiMode { WIFI_OFF = 0, WIFI_STA = 1, WIFI_AP = 2, WIFI_AP_STA = 3 };
+enum wl_status_t { WL_IDLE_STATUS = 0, WL_NO_SSID_AVAIL, WL_SCAN_COMPLETED, WL_CONNECTED, WL_CONNECT_FAILED,
+  WL_CONNECTION_LOST, WL_DISCONNECTED };
+
+struct WiFiClass {
+  wl_status_t connectedStatus = WL_CONNECTED;
+  WiFiSleepType sleepMode = WIFI_NONE_SLEEP;
+  unsigned long begins = 0;
+  int32_t beginChannel = 0;
+  unsigned long associateMs = 0;
+  unsigned long beganAtMs = 0;
+  IPAddress softAPIP(){ return IPAddress(192, 168, 4, 1); }
+  IPAddress localIP(){ return IPAddress(192, 168, 1, 50); }
+  IPAddress gatewayIP(){ return IPAddress(192, 168, 1, 1); }
+  IPAddress subnetMask(){ return IPAddress(255, 255, 255, 0); }
+  IPAddress dnsIP(uint8_t = 0){ return IPAddress(192, 168, 1, 1); }
+  String SSID(){ return String("hive"); }
+  String psk(){ return String("hivepsk"); }
+  uint8_t* BSSID(){ static uint8_t bssid[6] = {2, 0, 0, 0, 0, 1}; return bssid; }
+  int32_t channel(){ return 6; }
+  void disconnect(bool = false){}
+  bool setSleepMode(WiFiSleepType type, uint8_t = 0){ sleepMode = type; return true; }
+  bool mode(WiFiMode){ return true; }
+  bool config(IPAddress, IPAddress, IPAddress, IPAddress = IPAddress()){ return true; }
+  wl_status_t begin(const char*, const char* = nullptr, int32_t channel = 0, const uint8_t* = nullptr, bool = true){
+    begins++;
+    beginChannel = channel;
+    beganAtMs = millis();
+    return status();
+  }
+  wl_status_t status(){
+    if(begins > 0 && millis() - beganAtMs < associateMs) return WL_DISCONNECTED;
+    return connectedStatus;
+  }
+};
+extern WiFiClass WiFi;
+
+struct WiFiClient {};
@@ -0,0 +1,95 @@
+/*
+ * Host stand-in for SPIFFS, files live in memory until hostReset().
+ * SPIFFS has no directories, openDir(prefix) lists the files whose path starts with prefix.
+ */
+#pragma once
+#include "Arduino.h"
+#include <map>
+#include <vector>
+
+enum SeekMode { SeekSet = 0, SeekCur = 1, SeekEnd = 2 };
+
+typedef std::shared_ptr<std::vector<uint8_t>> HostFileData;
+
+struct File : Print {
+  HostFileData data;
+  std::string path;
+  size_t at = 0;
+  boolean writable = false;
+  File(){}
+  File(const std::string& filePath, HostFileData fileData, boolean canWrite, size_t position)
+    : data(fileData), path(filePath), at(position), writable(canWrite){}
+  operator bool() const { return (bool)data; }
+  size_t size(){ return data ? data->size() : 0; }
+  int available(){ return data ? (int)(data->size() - at) : 0; }
+  using Print::write;
+  size_t write(uint8_t c) override { return write(&c, 1); }
+  size_t write(const uint8_t* bytes, size_t length) override {
+    if(!data || !writable) return 0;
+    if(data->size() < at + length) data->resize(at + length);
+    memcpy(data->data() + at, bytes, length);
+    at += length;
+    return length;
+  }
+  size_t read(uint8_t* bytes, size_t length){
+    if(!data || at >= data->size()) return 0;
+    length = std::min(length, data->size() - at);
+    memcpy(bytes, data->data() + at, length);
+    at += length;
+    return length;
+  }
+  int read(){ uint8_t c; return read(&c, 1) == 1 ? c : -1; }
+  size_t readBytes(char* bytes, size_t length){ return read((uint8_t*)bytes, length); }
+  bool seek(uint32_t position, SeekMode mode = SeekSet){
+    if(!data) return false;
+    size_t target = mode == SeekSet ? position : mode == SeekCur ? at + position : data->size() + position;
+    if(target > data->size()) return false;
+    at = target;
+    return true;
+  }
+  size_t position() const { return at; }
+  const char* name() const { return path.c_str(); }
+  void flush(){}
+  void close(){ data.reset(); }
+};
+
+struct Dir {
+  std::vector<std::pair<std::string, size_t>> entries;
+  int at = -1;
+  bool next(){ return ++at < (int)entries.size(); }
+  String fileName(){ return String(entries[at].first); }
+  size_t fileSize(){ return entries[at].second; }
+};
+
+struct FS {
+  std::map<std::string, HostFileData> files;
+  boolean mountable = true;
+  unsigned long mounts = 0;  //begin() calls
+  bool begin(){ mounts++; return mountable; }
+  File open(const char* path, const char* mode){
+    std::string filePath(path);
+    auto found = files.find(filePath);
+    if(mode[0] == 'r'){
+      if(found == files.end()) return File();
+      return File(filePath, found->second, mode[1] == '+', 0);
+    }
+    if(mode[0] == 'w' || found == files.end()){
+      files[filePath] = std::make_shared<std::vector<uint8_t>>();
+    }
+    HostFileData data = files[filePath];
+    return File(filePath, data, true, mode[0] == 'a' ? data->size() : 0);
+  }
+  File open(const String& path, const char* mode){ return open(path.c_str(), mode); }
+  bool exists(const char* path){ return files.count(path) > 0; }
+  bool exists(const String& path){ return exists(path.c_str()); }
+  bool remove(const char* path){ return files.erase(path) > 0; }
+  bool remove(const String& path){ return remove(path.c_str()); }
+  Dir openDir(const char* prefix){
+    Dir dir;
+    for(auto& file : files){
+      if(file.first.compare(0, strlen(prefix), prefix) == 0) dir.entries.push_back(std::make_pair(file.first, file.second->size()));
+    }
+    return dir;
+  }
+};
+extern FS SPIFFS;
@@ -0,0 +1,47 @@
+#pragma once
+#include "IRremoteESP8266.h"
+
+#define MAX_TIMEOUT_MS 130
+#define RAWTICK 2
+
+struct decode_results {
+  decode_type_t decode_type;
+  union {
+    struct {
+      uint64_t value;
+      uint32_t address;
+      uint32_t command;
+    };
+    uint8_t state[STATE_SIZE_MAX];
+  };
+  uint16_t bits;
+  volatile uint16_t* rawbuf;
+  uint16_t rawlen;
+  bool overflow;
+  bool repeat;
+};
+
+//decode() hands out the frames queued in hostIr.frames, one per call, once their atMs has come.
+struct IRrecv {
+  uint16_t rawbuf[1024];
+  IRrecv(uint16_t, uint16_t = 100, uint8_t = 15, bool = false){}
+  void enableIRIn(){}
+  void disableIRIn(){}
+  void resume(){}
+  void setUnknownThreshold(uint16_t){}
+  bool decode(decode_results* results, void* = nullptr){
+    if(hostIr.frames.empty() || hostIr.frames.front().atMs > millis()) return false;
+    HostIrFrame frame = hostIr.frames.front();
+    hostIr.frames.pop_front();
+    memset(results, 0, sizeof(*results));
+    results->decode_type = frame.type;
+    results->bits = frame.bits;
+    memcpy(results->state, frame.state.data(), std::min(frame.state.size(), (size_t)STATE_SIZE_MAX));
+    rawbuf[0] = 0x7FFF;
+    size_t timings = std::min(frame.timings.size(), sizeof(rawbuf) / sizeof(rawbuf[0]) - 1);
+    for(size_t i=0;i<timings;i++) rawbuf[i + 1] = frame.timings[i];
+    results->rawbuf = rawbuf;
+    results->rawlen = timings + 1;
+    return true;
+  }
+};
@@ -0,0 +1,49 @@
+/*
+ * Host stand-in for IRremoteESP8266 (v2.3 API). Receive frames come from hostIr.frames,
+ * every send() is recorded in hostIr.sent. The A/C classes in ir_*.h model the library's
+ * state layout for the setters the aircon drivers call.
+ */
+#pragma once
+#include "Arduino.h"
+#include <deque>
+#include <vector>
+
+#define DECODE_AC         true
+#define DECODE_HASH       true
+#define DECODE_DAIKIN     true
+#define DECODE_FUJITSU_AC true
+#define DECODE_KELVINATOR true
+#define DECODE_TOSHIBA_AC true
+#define DECODE_MIDEA      true
+#define _IRREMOTEESP8266_VERSION_ "2.3.2"
+
+enum decode_type_t { UNKNOWN = -1, UNUSED = 0, RC5, RC6, NEC, SONY, COOLIX = 15, DAIKIN = 16, KELVINATOR = 18,
+  MITSUBISHI_AC = 20, TOSHIBA_AC = 32, FUJITSU_AC = 33, MIDEA = 34 };
+
+#define STATE_SIZE_MAX          53
+#define KELVINATOR_STATE_LENGTH 16
+#define DAIKIN_COMMAND_LENGTH   27
+#define TOSHIBA_AC_STATE_LENGTH 9
+#define FUJITSU_AC_STATE_LENGTH 16
+#define FUJITSU_AC_STATE_LENGTH_SHORT 7
+
+struct HostIrSend {
+  std::string remote;           //Class that sent it
+  std::vector<uint8_t> state;
+};
+struct HostIrFrame {
+  decode_type_t type;
+  uint16_t bits;
+  std::vector<uint8_t> state;
+  std::vector<uint16_t> timings; //rawbuf from index 1, in RAWTICK units
+  unsigned long atMs;            //Captured, decode() hands it over from then on
+};
+struct HostIr {
+  std::vector<HostIrSend> sent;
+  std::deque<HostIrFrame> frames;
+};
+extern HostIr hostIr;
+
+inline void hostIrRecordSend(const char* remote, const uint8_t* state, size_t length){
+  hostIr.sent.push_back(HostIrSend{remote, std::vector<uint8_t>(state, state + length)});
+}
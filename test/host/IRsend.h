@@ -0,0 +1,7 @@
+#pragma once
+#include "IRremoteESP8266.h"
+
+struct IRsend {
+  IRsend(uint16_t){}
+  void begin(){}
+};
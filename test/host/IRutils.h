@@ -0,0 +1,9 @@
+#pragma once
+#include "IRrecv.h"
+
+inline String typeToString(decode_type_t type, bool = false){ return String((long)type); }
+inline String resultToHumanReadableBasic(const decode_results* results){
+  return "Encoding  : " + typeToString(results->decode_type) + "\n";
+}
+inline String resultToTimingInfo(const decode_results*){ return String(); }
+inline String resultToSourceCode(const decode_results*){ return String(); }
@@ -0,0 +1,113 @@
+/*
+ * Host stand-in for PubSubClient, backed by a scripted broker (hostBroker).
+ * The bot's publishes are recorded, messages queued with hostBroker.deliver() reach the
+ * callback from loop(), one per call, laid out in the packet buffer the way the library does.
+ * onPublish lets a test play HiveCentral, answering what the bot sends.
+ */
+#pragma once
+#include "Arduino.h"
+#include "ESP8266WiFi.h"
+#include <deque>
+#include <functional>
+#include <vector>
+
+#ifndef MQTT_MAX_PACKET_SIZE
+#define MQTT_MAX_PACKET_SIZE 512 //As the bot is built, PubSubClient.h raised from 128
+#endif
+#define MQTT_KEEPALIVE 15
+
+struct HostMqttMessage {
+  std::string topic;
+  std::string payload;
+  unsigned long atMs; //Reaches the bot's socket, handed over by the first loop() from then on
+};
+
+struct HostBroker {
+  boolean up = true;             //Accepts connections
+  boolean connected = false;     //The bot's session
+  boolean publishOk = true;
+  unsigned long connectAttempts = 0;
+  unsigned long connects = 0;
+  unsigned long overruns = 0;    //Callbacks that wrote past the packet buffer
+  std::vector<std::string> subscriptions;
+  std::vector<HostMqttMessage> published;
+  std::deque<HostMqttMessage> inbound;
+  std::function<void(const HostMqttMessage&)> onPublish;
+
+  //Connection lost, up decides whether the next connect() gets through.
+  void drop(boolean stayUp = false){ connected = false; up = stayUp; }
+  void deliver(const std::string& topic, const std::string& payload, unsigned long atMs = 0){
+    inbound.push_back(HostMqttMessage{topic, payload, atMs});
+  }
+  boolean isSubscribed(const std::string& topic) const {
+    return std::find(subscriptions.begin(), subscriptions.end(), topic) != subscriptions.end();
+  }
+  //Published on topic since index from, in order.
+  std::vector<std::string> payloadsOn(const std::string& topic, size_t from = 0) const {
+    std::vector<std::string> payloads;
+    for(size_t i=from;i<published.size();i++){
+      if(published[i].topic == topic) payloads.push_back(published[i].payload);
+    }
+    return payloads;
+  }
+};
+extern HostBroker hostBroker;
+
+class PubSubClient {
+  typedef void (*Callback)(char*, uint8_t*, unsigned int);
+  Callback _callback;
+  uint8_t _buffer[MQTT_MAX_PACKET_SIZE + 1]; //+1 is the guard byte just past the library's buffer
+public:
+  PubSubClient(const char*, int, Callback callback, WiFiClient&) : _callback(callback){}
+  bool connected(){ return hostBroker.connected; }
+  bool connect(const char*, const char*, const char*){
+    hostBroker.connectAttempts++;
+    if(!hostBroker.up) return false;
+    hostBroker.connected = true;
+    hostBroker.connects++;
+    hostBroker.subscriptions.clear();
+    return true;
+  }
+  void disconnect(){ hostBroker.connected = false; }
+  bool subscribe(const char* topic, uint8_t = 0){
+    if(!hostBroker.connected) return false;
+    hostBroker.subscriptions.push_back(topic);
+    return true;
+  }
+  bool publish(const char* topic, const uint8_t* payload, unsigned int length){
+    if(!hostBroker.connected || !hostBroker.publishOk) return false;
+    if(5 + 2 + strlen(topic) + length > MQTT_MAX_PACKET_SIZE) return false;
+    boolean counting = hostHeap.counting; //What the broker keeps is not the bot's heap use
+    hostHeap.counting = false;
+    HostMqttMessage message{topic, std::string((const char*)payload, length)};
+    hostBroker.published.push_back(message);
+    if(hostBroker.onPublish) hostBroker.onPublish(message);
+    hostHeap.counting = counting;
+    return true;
+  }
+  bool publish(const char* topic, const char* payload){ return publish(topic, (const uint8_t*)payload, strlen(payload)); }
+  //QoS 0 PUBLISH: fixed header, remaining length, topic length, topic, payload. Too big is dropped.
+  bool loop(){
+    while(hostBroker.connected && !hostBroker.inbound.empty() && hostBroker.inbound.front().atMs <= millis()){
+      HostMqttMessage message = hostBroker.inbound.front();
+      hostBroker.inbound.pop_front();
+      if(!hostBroker.isSubscribed(message.topic)) continue;
+      size_t remaining = 2 + message.topic.size() + message.payload.size();
+      size_t header = 1 + (remaining < 128 ? 1 : 2) + 2;
+      if(header + message.topic.size() + message.payload.size() > MQTT_MAX_PACKET_SIZE) continue;
+      uint8_t* topic = _buffer + header;
+      memcpy(topic, message.topic.data(), message.topic.size());
+      uint8_t* payload = topic + message.topic.size();
+      memcpy(payload, message.payload.data(), message.payload.size());
+      //The library terminates the topic by moving it one byte down over the length, as here.
+      memmove(topic - 1, topic, message.topic.size());
+      topic[message.topic.size() - 1] = '\0';
+      _buffer[MQTT_MAX_PACKET_SIZE] = 0xA5;
+      _callback((char*)(topic - 1), payload, message.payload.size());
+      if(_buffer[MQTT_MAX_PACKET_SIZE] != 0xA5) hostBroker.overruns++;
+      break;
+    }
+    return hostBroker.connected;
+  }
+  int state(){ return hostBroker.connected ? 0 : -1; }
+};
@@ -0,0 +1,20 @@
+/* Host stand-in, autoConnect() connects with the values the parameters were created with. */
+#pragma once
+#include "Arduino.h"
+
+struct WiFiManagerParameter {
+  char value[64];
+  WiFiManagerParameter(const char*, const char*, const char* defaultValue, int length){
+    snprintf(value, sizeof(value) < (size_t)length + 1 ? sizeof(value) : length + 1, "%s", defaultValue ? defaultValue : "");
+  }
+  const char* getValue(){ return value; }
+};
+
+struct WiFiManager {
+  void setAPCallback(void (*)(WiFiManager*)){}
+  void setSaveConfigCallback(void (*)()){}
+  void setDebugOutput(bool){}
+  void addParameter(WiFiManagerParameter*){}
+  bool startConfigPortal(const char*, const char*){ return true; }
+  bool autoConnect(const char*, const char*){ return true; }
+};
@@ -0,0 +1,70 @@
+/* Host model of IRDaikinESP, the 27 byte state of IRremoteESP8266 v2.3 ir_Daikin.cpp. */
+#pragma once
+#include "IRsend.h"
+
+#define DAIKIN_AUTO  0b000
+#define DAIKIN_DRY   0b010
+#define DAIKIN_COOL  0b011
+#define DAIKIN_HEAT  0b100
+#define DAIKIN_FAN   0b110
+#define DAIKIN_FAN_MIN   1U
+#define DAIKIN_FAN_MAX   5U
+#define DAIKIN_FAN_AUTO  0b1010
+#define DAIKIN_FAN_QUIET 0b1011
+#define DAIKIN_MIN_TEMP 10U
+#define DAIKIN_MAX_TEMP 32U
+
+class IRDaikinESP {
+  uint8_t daikin[DAIKIN_COMMAND_LENGTH];
+  void checksum(){
+    uint8_t sum = 0;
+    for(int i=0;i<7;i++) sum += daikin[i];
+    daikin[7] = sum;
+    sum = 0;
+    for(int i=8;i<26;i++) sum += daikin[i];
+    daikin[26] = sum;
+  }
+public:
+  IRDaikinESP(uint16_t){ stateReset(); }
+  void stateReset(){
+    static const uint8_t reset[DAIKIN_COMMAND_LENGTH] = {
+      0x11, 0xDA, 0x27, 0xF0, 0x00, 0x00, 0x00, 0x20,
+      0x11, 0xDA, 0x27, 0x00, 0x00, 0x41, 0x1E, 0x00, 0xB0, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0xC0, 0x00, 0x00, 0xE3};
+    memcpy(daikin, reset, sizeof(daikin));
+  }
+  void begin(){}
+  void send(){ hostIrRecordSend("DAIKIN", getRaw(), DAIKIN_COMMAND_LENGTH); }
+  void on(){ daikin[13] |= 0x01; }
+  void off(){ daikin[13] &= ~0x01; }
+  bool getPower(){ return daikin[13] & 0x01; }
+  void setTemp(uint8_t temp){
+    temp = std::max((uint8_t)DAIKIN_MIN_TEMP, std::min((uint8_t)DAIKIN_MAX_TEMP, temp));
+    daikin[14] = temp * 2;
+  }
+  uint8_t getTemp(){ return daikin[14] / 2; }
+  void setFan(uint8_t fan){
+    uint8_t fanset;
+    if(fan == DAIKIN_FAN_QUIET || fan == DAIKIN_FAN_AUTO) fanset = fan;
+    else if(fan < DAIKIN_FAN_MIN || fan > DAIKIN_FAN_MAX) fanset = DAIKIN_FAN_AUTO;
+    else fanset = 2 + fan;
+    daikin[16] = (daikin[16] & 0x0F) | (fanset << 4);
+  }
+  uint8_t getFan(){ uint8_t fan = daikin[16] >> 4; return fan == DAIKIN_FAN_AUTO || fan == DAIKIN_FAN_QUIET ? fan : fan - 2; }
+  void setMode(uint8_t mode){
+    switch(mode){
+      case DAIKIN_COOL: case DAIKIN_HEAT: case DAIKIN_FAN: case DAIKIN_DRY: break;
+      default: mode = DAIKIN_AUTO;
+    }
+    daikin[13] = (mode << 4) | (daikin[13] & 0x8F);
+  }
+  uint8_t getMode(){ return (daikin[13] >> 4) & 0x07; }
+  void setSwingVertical(bool on){ daikin[16] = on ? daikin[16] | 0x0F : daikin[16] & 0xF0; }
+  void setSwingHorizontal(bool on){ daikin[17] = on ? daikin[17] | 0x0F : daikin[17] & 0xF0; }
+  uint8_t* getRaw(){ checksum(); return daikin; }
+  void setRaw(uint8_t* state){ memcpy(daikin, state, DAIKIN_COMMAND_LENGTH); }
+  String toString(){
+    char b[64];
+    snprintf(b, sizeof(b), "Power: %s, Mode: %u, Temp: %uC, Fan: %u", getPower() ? "On" : "Off", getMode(), getTemp(), getFan());
+    return String(b);
+  }
+};
@@ -0,0 +1,107 @@
+/* Host model of IRFujitsuAC (ARRAH2E), IRremoteESP8266 v2.3 ir_Fujitsu.cpp. Off is a 7 byte state. */
+#pragma once
+#include "IRsend.h"
+
+#define FUJITSU_AC_MODE_AUTO 0x00
+#define FUJITSU_AC_MODE_COOL 0x01
+#define FUJITSU_AC_MODE_DRY  0x02
+#define FUJITSU_AC_MODE_FAN  0x03
+#define FUJITSU_AC_MODE_HEAT 0x04
+#define FUJITSU_AC_CMD_STAY_ON    0x00
+#define FUJITSU_AC_CMD_TURN_ON    0x01
+#define FUJITSU_AC_CMD_TURN_OFF   0x02
+#define FUJITSU_AC_CMD_STEP_HORIZ 0x79
+#define FUJITSU_AC_CMD_STEP_VERT  0x6C
+#define FUJITSU_AC_FAN_AUTO  0x00
+#define FUJITSU_AC_FAN_HIGH  0x01
+#define FUJITSU_AC_FAN_MED   0x02
+#define FUJITSU_AC_FAN_LOW   0x03
+#define FUJITSU_AC_FAN_QUIET 0x04
+#define FUJITSU_AC_SWING_OFF  0x00
+#define FUJITSU_AC_SWING_BOTH 0x03
+#define FUJITSU_AC_MIN_TEMP 16U
+#define FUJITSU_AC_MAX_TEMP 30U
+
+class IRFujitsuAC {
+  uint8_t remote_state[FUJITSU_AC_STATE_LENGTH];
+  uint8_t _temp, _fanSpeed, _mode, _swingMode, _cmd;
+  void buildState(){
+    remote_state[0] = 0x14;
+    remote_state[1] = 0x63;
+    remote_state[2] = 0x00;
+    remote_state[3] = 0x10;
+    remote_state[4] = 0x10;
+    if(_cmd == FUJITSU_AC_CMD_TURN_OFF || _cmd == FUJITSU_AC_CMD_STEP_HORIZ || _cmd == FUJITSU_AC_CMD_STEP_VERT){
+      remote_state[5] = _cmd;
+      remote_state[6] = ~remote_state[5];
+      for(int i=7;i<FUJITSU_AC_STATE_LENGTH;i++) remote_state[i] = 0;
+      return;
+    }
+    remote_state[5] = 0xFE;
+    remote_state[6] = FUJITSU_AC_STATE_LENGTH - 7;
+    remote_state[7] = 0x30;
+    remote_state[8] = (_cmd == FUJITSU_AC_CMD_TURN_ON) | ((_temp - FUJITSU_AC_MIN_TEMP) << 4);
+    remote_state[9] = _mode;
+    remote_state[10] = _fanSpeed | _swingMode << 4;
+    remote_state[11] = 0;
+    remote_state[12] = 0;
+    remote_state[13] = 0;
+    remote_state[14] = 0x20;
+    uint8_t sum = 0;
+    for(int i=7;i<15;i++) sum += remote_state[i];
+    remote_state[15] = 0 - sum;
+  }
+public:
+  IRFujitsuAC(uint16_t){ stateReset(); }
+  void stateReset(){
+    _temp = 24;
+    _fanSpeed = FUJITSU_AC_FAN_HIGH;
+    _mode = FUJITSU_AC_MODE_COOL;
+    _swingMode = FUJITSU_AC_SWING_BOTH;
+    _cmd = FUJITSU_AC_CMD_TURN_ON;
+    buildState();
+  }
+  void begin(){}
+  void send(){ hostIrRecordSend("FUJITSU_AC", getRaw(), getStateLength()); }
+  void off(){ _cmd = FUJITSU_AC_CMD_TURN_OFF; }
+  void setCmd(uint8_t cmd){
+    switch(cmd){
+      case FUJITSU_AC_CMD_TURN_OFF: case FUJITSU_AC_CMD_TURN_ON: case FUJITSU_AC_CMD_STAY_ON:
+      case FUJITSU_AC_CMD_STEP_VERT: case FUJITSU_AC_CMD_STEP_HORIZ: _cmd = cmd; break;
+      default: _cmd = FUJITSU_AC_CMD_STAY_ON;
+    }
+  }
+  uint8_t getCmd(){ return _cmd; }
+  void setTemp(uint8_t temp){ _temp = std::max((uint8_t)FUJITSU_AC_MIN_TEMP, std::min((uint8_t)FUJITSU_AC_MAX_TEMP, temp)); }
+  uint8_t getTemp(){ return _temp; }
+  void setFanSpeed(uint8_t fan){ if(fan <= FUJITSU_AC_FAN_QUIET) _fanSpeed = fan; }
+  uint8_t getFanSpeed(){ return _fanSpeed; }
+  void setMode(uint8_t mode){ if(mode <= FUJITSU_AC_MODE_HEAT) _mode = mode; }
+  uint8_t getMode(){ return _mode; }
+  void setSwing(uint8_t swing){ if(swing <= FUJITSU_AC_SWING_BOTH) _swingMode = swing; }
+  uint8_t getStateLength(){
+    buildState();
+    return remote_state[5] == 0xFE ? FUJITSU_AC_STATE_LENGTH : FUJITSU_AC_STATE_LENGTH_SHORT;
+  }
+  uint8_t* getRaw(){ buildState(); return remote_state; }
+  bool setRaw(uint8_t* state, uint8_t length){
+    if(length != FUJITSU_AC_STATE_LENGTH && length != FUJITSU_AC_STATE_LENGTH_SHORT) return false;
+    memset(remote_state, 0, sizeof(remote_state));
+    memcpy(remote_state, state, length);
+    if(length == FUJITSU_AC_STATE_LENGTH_SHORT){
+      _cmd = remote_state[5];
+    }else{
+      _cmd = remote_state[8] & 0x01 ? FUJITSU_AC_CMD_TURN_ON : FUJITSU_AC_CMD_STAY_ON;
+      _temp = (remote_state[8] >> 4) + FUJITSU_AC_MIN_TEMP;
+      _mode = remote_state[9] & 0x07;
+      _fanSpeed = remote_state[10] & 0x07;
+      _swingMode = remote_state[10] >> 4;
+    }
+    return true;
+  }
+  String toString(){
+    char b[64];
+    snprintf(b, sizeof(b), "Cmd: %u, Mode: %u, Temp: %uC, Fan: %u", _cmd, _mode, _temp, _fanSpeed);
+    return String(b);
+  }
+};
@@ -0,0 +1,109 @@
+/* Host model of IRKelvinatorAC, state layout of IRremoteESP8266 v2.3 ir_Kelvinator.cpp. */
+#pragma once
+#include "IRsend.h"
+
+#define KELVINATOR_AUTO     0U
+#define KELVINATOR_COOL     1U
+#define KELVINATOR_DRY      2U
+#define KELVINATOR_FAN      3U
+#define KELVINATOR_HEAT     4U
+#define KELVINATOR_MIN_TEMP 16U
+#define KELVINATOR_MAX_TEMP 30U
+#define KELVINATOR_AUTO_TEMP 25U
+#define KELVINATOR_FAN_MAX  5U
+#define KELVINATOR_BASIC_FAN_MAX 3U
+#define KELVINATOR_POWER    8U
+#define KELVINATOR_VENT_SWING   0x40U
+#define KELVINATOR_VENT_SWING_V 0x01U
+#define KELVINATOR_VENT_SWING_H 0x10U
+#define KELVINATOR_TURBO    0x10U
+#define KELVINATOR_LIGHT    0x20U
+#define KELVINATOR_IONFILTER 0x40U
+#define KELVINATOR_XFAN     0x80U
+#define KELVINATOR_CHECKSUM_START 10U
+
+class IRKelvinatorAC {
+  uint8_t remote_state[KELVINATOR_STATE_LENGTH];
+  void fixup(){
+    if(getMode() != KELVINATOR_COOL && getMode() != KELVINATOR_DRY) setXFan(false);
+    //Per 8 byte block: low nibbles of bytes 0-3, high nibbles of 4-6, into the high nibble of byte 7.
+    for(uint8_t offset=0; offset<KELVINATOR_STATE_LENGTH; offset+=8){
+      uint8_t sum = KELVINATOR_CHECKSUM_START;
+      for(uint8_t i=0;i<4;i++) sum += remote_state[i + offset] & 0x0F;
+      for(uint8_t i=4;i<7;i++) sum += remote_state[i + offset] >> 4;
+      remote_state[7 + offset] = (sum & 0x0F) << 4 | (remote_state[7 + offset] & 0x0F);
+    }
+  }
+  void setBit2(uint8_t bit, bool on){
+    if(on) remote_state[2] |= bit; else remote_state[2] &= ~bit;
+    remote_state[10] = remote_state[2];
+  }
+public:
+  IRKelvinatorAC(uint16_t){ stateReset(); }
+  void stateReset(){
+    memset(remote_state, 0, sizeof(remote_state));
+    remote_state[3] = 0x50;
+    remote_state[11] = 0x70;
+  }
+  void begin(){}
+  void send(){ hostIrRecordSend("KELVINATOR", getRaw(), KELVINATOR_STATE_LENGTH); }
+  void on(){ remote_state[0] |= KELVINATOR_POWER; remote_state[8] = remote_state[0]; }
+  void off(){ remote_state[0] &= ~KELVINATOR_POWER; remote_state[8] = remote_state[0]; }
+  bool getPower(){ return remote_state[0] & KELVINATOR_POWER; }
+  void setTemp(uint8_t temp){
+    temp = std::max((uint8_t)KELVINATOR_MIN_TEMP, std::min((uint8_t)KELVINATOR_MAX_TEMP, temp));
+    remote_state[1] = (remote_state[1] & 0xF0) | (temp - KELVINATOR_MIN_TEMP);
+    remote_state[9] = remote_state[1];
+  }
+  uint8_t getTemp(){ return (remote_state[1] & 0x0F) + KELVINATOR_MIN_TEMP; }
+  void setFan(uint8_t speed){
+    uint8_t fan = std::min((uint8_t)KELVINATOR_FAN_MAX, speed);
+    if(fan == getFan()) return;
+    uint8_t fanBasic = std::min((uint8_t)KELVINATOR_BASIC_FAN_MAX, fan);
+    remote_state[0] = (remote_state[0] & 0xCF) | (fanBasic << 4);
+    remote_state[8] = remote_state[0];
+    remote_state[14] = (remote_state[14] & 0x8F) | (fan << 4);
+    setTurbo(false);
+  }
+  uint8_t getFan(){ return (remote_state[14] & 0x70) >> 4; }
+  void setMode(uint8_t mode){
+    if(mode > KELVINATOR_HEAT) mode = KELVINATOR_AUTO;
+    remote_state[0] = (remote_state[0] & 0xF8) | mode;
+    remote_state[8] = remote_state[0];
+    if(mode == KELVINATOR_AUTO || mode == KELVINATOR_DRY) setTemp(KELVINATOR_AUTO_TEMP); //Remote shows no temp in these
+  }
+  uint8_t getMode(){ return remote_state[0] & 0x07; }
+  bool getSwingVertical(){ return remote_state[4] & KELVINATOR_VENT_SWING_V; }
+  bool getSwingHorizontal(){ return remote_state[4] & KELVINATOR_VENT_SWING_H; }
+  void setSwingVertical(bool on){
+    if(on){
+      remote_state[0] |= KELVINATOR_VENT_SWING;
+      remote_state[4] |= KELVINATOR_VENT_SWING_V;
+    }else{
+      remote_state[4] &= ~KELVINATOR_VENT_SWING_V;
+      if(!getSwingHorizontal()) remote_state[0] &= ~KELVINATOR_VENT_SWING;
+    }
+    remote_state[8] = remote_state[0];
+  }
+  void setSwingHorizontal(bool on){
+    if(on){
+      remote_state[0] |= KELVINATOR_VENT_SWING;
+      remote_state[4] |= KELVINATOR_VENT_SWING_H;
+    }else{
+      remote_state[4] &= ~KELVINATOR_VENT_SWING_H;
+      if(!getSwingVertical()) remote_state[0] &= ~KELVINATOR_VENT_SWING;
+    }
+    remote_state[8] = remote_state[0];
+  }
+  void setXFan(bool on){ setBit2(KELVINATOR_XFAN, on); }
+  void setIonFilter(bool on){ setBit2(KELVINATOR_IONFILTER, on); }
+  void setLight(bool on){ setBit2(KELVINATOR_LIGHT, on); }
+  void setTurbo(bool on){ setBit2(KELVINATOR_TURBO, on); }
+  uint8_t* getRaw(){ fixup(); return remote_state; }
+  void setRaw(uint8_t* state){ memcpy(remote_state, state, KELVINATOR_STATE_LENGTH); }
+  String toString(){
+    char b[64];
+    snprintf(b, sizeof(b), "Power: %s, Mode: %u, Temp: %uC, Fan: %u", getPower() ? "On" : "Off", getMode(), getTemp(), getFan());
+    return String(b);
+  }
+};
@@ -0,0 +1,78 @@
+/* Host model of IRMideaAC, the 48 bit state of IRremoteESP8266 v2.3 ir_Midea.cpp. Temp is kept in Fahrenheit. */
+#pragma once
+#include "IRsend.h"
+
+#define MIDEA_AC_COOL 0
+#define MIDEA_AC_DRY  1
+#define MIDEA_AC_AUTO 2
+#define MIDEA_AC_HEAT 3
+#define MIDEA_AC_FAN  4
+#define MIDEA_AC_FAN_AUTO 0
+#define MIDEA_AC_FAN_LOW  1
+#define MIDEA_AC_FAN_MED  2
+#define MIDEA_AC_FAN_HI   3
+#define MIDEA_AC_POWER     (1ULL << 39)
+#define MIDEA_AC_MODE_MASK 0x0000000700000000ULL
+#define MIDEA_AC_FAN_MASK  0x0000001800000000ULL
+#define MIDEA_AC_TEMP_MASK 0x000000001F000000ULL
+#define MIDEA_AC_MIN_TEMP_F 62U
+#define MIDEA_AC_MAX_TEMP_F 86U
+#define MIDEA_AC_MIN_TEMP_C 17U
+#define MIDEA_AC_MAX_TEMP_C 30U
+
+class IRMideaAC {
+  uint64_t remote_state;
+  static uint8_t reverseBits(uint8_t value){
+    uint8_t reversed = 0;
+    for(int i=0;i<8;i++) if(value & (1 << i)) reversed |= 0x80 >> i;
+    return reversed;
+  }
+  void checksum(){
+    uint8_t sum = 0;
+    uint64_t state = remote_state;
+    for(int i=0;i<5;i++){
+      state >>= 8;
+      sum += reverseBits(state & 0xFF);
+    }
+    remote_state = (remote_state & ~0xFFULL) | reverseBits(256 - sum);
+  }
+public:
+  IRMideaAC(uint16_t){ stateReset(); }
+  void stateReset(){ remote_state = 0xA1826FFFFF62ULL; }
+  void begin(){}
+  void send(){
+    uint64_t raw = getRaw();
+    hostIrRecordSend("MIDEA", (const uint8_t*)&raw, sizeof(raw));
+  }
+  void on(){ remote_state |= MIDEA_AC_POWER; }
+  void off(){ remote_state &= ~MIDEA_AC_POWER; }
+  bool getPower(){ return remote_state & MIDEA_AC_POWER; }
+  void setTemp(uint8_t temp, bool useCelsius = false){
+    uint8_t minTemp = useCelsius ? MIDEA_AC_MIN_TEMP_C : MIDEA_AC_MIN_TEMP_F;
+    uint8_t maxTemp = useCelsius ? MIDEA_AC_MAX_TEMP_C : MIDEA_AC_MAX_TEMP_F;
+    temp = std::max(minTemp, std::min(maxTemp, temp));
+    if(useCelsius) temp = (uint8_t)(temp * 1.8 + 32.5); //Rounded to the nearest F
+    remote_state = (remote_state & ~MIDEA_AC_TEMP_MASK) | ((uint64_t)(temp - MIDEA_AC_MIN_TEMP_F) << 24);
+  }
+  uint8_t getTemp(bool useCelsius = false){
+    uint8_t fahrenheit = ((remote_state & MIDEA_AC_TEMP_MASK) >> 24) + MIDEA_AC_MIN_TEMP_F;
+    return useCelsius ? (uint8_t)lround((fahrenheit - 32) / 1.8) : fahrenheit;
+  }
+  void setFan(uint8_t fan){
+    if(fan > MIDEA_AC_FAN_HI) fan = MIDEA_AC_FAN_AUTO;
+    remote_state = (remote_state & ~MIDEA_AC_FAN_MASK) | ((uint64_t)fan << 35);
+  }
+  uint8_t getFan(){ return (remote_state & MIDEA_AC_FAN_MASK) >> 35; }
+  void setMode(uint8_t mode){
+    if(mode > MIDEA_AC_FAN) mode = MIDEA_AC_AUTO;
+    remote_state = (remote_state & ~MIDEA_AC_MODE_MASK) | ((uint64_t)mode << 32);
+  }
+  uint8_t getMode(){ return (remote_state & MIDEA_AC_MODE_MASK) >> 32; }
+  uint64_t getRaw(){ checksum(); return remote_state; }
+  void setRaw(uint64_t state){ remote_state = state; }
+  String toString(){
+    char b[64];
+    snprintf(b, sizeof(b), "Power: %s, Mode: %u, Temp: %uC, Fan: %u", getPower() ? "On" : "Off", getMode(), getTemp(true), getFan());
+    return String(b);
+  }
+};
@@ -0,0 +1,75 @@
+/* Host model of IRToshibaAC, IRremoteESP8266 v2.3 ir_Toshiba.cpp. */
+#pragma once
+#include "IRsend.h"
+
+#define TOSHIBA_AC_AUTO  0
+#define TOSHIBA_AC_COOL  1
+#define TOSHIBA_AC_DRY   2
+#define TOSHIBA_AC_HEAT  3
+#define TOSHIBA_AC_POWER 4
+#define TOSHIBA_AC_FAN_AUTO 0
+#define TOSHIBA_AC_FAN_MAX  5
+#define TOSHIBA_AC_MIN_TEMP 17U
+#define TOSHIBA_AC_MAX_TEMP 30U
+
+class IRToshibaAC {
+  uint8_t remote_state[TOSHIBA_AC_STATE_LENGTH];
+  uint8_t mode_state;
+  void checksum(){
+    uint8_t sum = 0;
+    for(int i=0;i<TOSHIBA_AC_STATE_LENGTH - 1;i++) sum ^= remote_state[i];
+    remote_state[TOSHIBA_AC_STATE_LENGTH - 1] = sum;
+  }
+public:
+  IRToshibaAC(uint16_t){ stateReset(); }
+  void stateReset(){
+    static const uint8_t reset[TOSHIBA_AC_STATE_LENGTH] = {0xF2, 0x0D, 0xFE, 0x01, 0x00, 0x00, 0x00, 0x00, 0x00};
+    memcpy(remote_state, reset, sizeof(remote_state));
+    mode_state = remote_state[6] & 0x03;
+    checksum();
+  }
+  void begin(){}
+  void send(){ hostIrRecordSend("TOSHIBA_AC", getRaw(), TOSHIBA_AC_STATE_LENGTH); }
+  void on(){
+    remote_state[6] &= ~TOSHIBA_AC_POWER;
+    setMode(mode_state);
+    checksum();
+  }
+  void off(){
+    remote_state[6] |= TOSHIBA_AC_POWER | 0x03;
+    checksum();
+  }
+  bool getPower(){ return (remote_state[6] & TOSHIBA_AC_POWER) == 0; }
+  void setTemp(uint8_t temp){
+    temp = std::max((uint8_t)TOSHIBA_AC_MIN_TEMP, std::min((uint8_t)TOSHIBA_AC_MAX_TEMP, temp));
+    remote_state[5] = (remote_state[5] & 0x0F) | ((temp - TOSHIBA_AC_MIN_TEMP) << 4);
+    checksum();
+  }
+  uint8_t getTemp(){ return (remote_state[5] >> 4) + TOSHIBA_AC_MIN_TEMP; }
+  void setFan(uint8_t speed){
+    uint8_t fan = std::min(speed, (uint8_t)TOSHIBA_AC_FAN_MAX);
+    if(fan > 0) fan++; //1 is not used, 2..6 are the speeds
+    remote_state[6] = (remote_state[6] & 0x1F) | (fan << 5);
+    checksum();
+  }
+  uint8_t getFan(){ uint8_t fan = remote_state[6] >> 5; return fan > 0 ? fan - 1 : 0; }
+  void setMode(uint8_t mode){
+    if(mode > TOSHIBA_AC_HEAT) mode = TOSHIBA_AC_AUTO;
+    mode_state = mode;
+    if(getPower()){
+      remote_state[6] = (remote_state[6] & 0xFC) | mode;
+      checksum();
+    }
+  }
+  uint8_t getMode(){ return getPower() ? remote_state[6] & 0x03 : mode_state; }
+  uint8_t* getRaw(){ checksum(); return remote_state; }
+  void setRaw(uint8_t* state){
+    memcpy(remote_state, state, TOSHIBA_AC_STATE_LENGTH);
+    mode_state = remote_state[6] & 0x03;
+  }
+  String toString(){
+    char b[64];
+    snprintf(b, sizeof(b), "Power: %s, Mode: %u, Temp: %uC, Fan: %u", getPower() ? "On" : "Off", getMode(), getTemp(), getFan());
+    return String(b);
+  }
+};